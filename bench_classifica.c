@@ -0,0 +1,286 @@
+// ============================================================================
+// Autore: de Dato A.
+// BENCHMARK – classifiche sotto lettura ("Mostra Punteggio")
+//
+// Misura se chi legge le classifiche rallenta chi aggiorna i punteggi, su un
+// server già avviato (porta 4242, protocollo v2):
+//  - riempimento: sessioni con nick tutti diversi portano ogni tabellone a
+//                 circa [righe] righe (server con -p: le righe salvate restano
+//                 dopo la disconnessione; senza -p il riempimento non tiene)
+//  - scrittori:   sessioni complete in ciclo (login, tutti i temi, FR_FINE),
+//                 ognuna modifica più volte ogni tabellone
+//  - lettori:     FR_CLASSIFICA in ciclo, leggendo ogni risposta: con i
+//                 tabelloni che cambiano di continuo ogni richiesta ricostruisce
+//                 le viste
+//  - bloccati:    FR_CLASSIFICA ogni millisecondo senza mai leggere le risposte
+// Prima solo scrittori, poi scrittori con lettori e bloccati: se le due
+// misure di sessioni/s e latenza della risposta restano vicine, le letture
+// non stanno tenendo il lock dei tabelloni.
+//
+// Uso: ./bench_classifica [-r righe] [-w scrittori] [-l lettori] [-b bloccati] [-t secondi]
+// ============================================================================
+
+#include "utility.h"
+#include "protocollo.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <getopt.h>
+
+#define MAX_FRAME      (64u << 20)      // limite di sicurezza per un frame ricevuto
+#define MAX_CAMPIONI   (1 << 16)        // latenze conservate per thread
+
+enum Ruolo { RUOLO_RIEMPI, RUOLO_SCRITTORE, RUOLO_LETTORE, RUOLO_BLOCCATO };
+
+struct Attore {
+    enum Ruolo      ruolo;
+    int             id;
+    pthread_t       tid;
+    struct ProtoBuf tx, rx;
+    unsigned long   fatte;              // sessioni (o classifiche lette)
+    unsigned long   errori;
+    uint32_t*       campioni;           // latenza delle risposte (us)
+    size_t          numCampioni;
+};
+
+static struct sockaddr_in g_srv;
+static atomic_int         g_stop = 0;
+static atomic_long        g_daRiempire = 0;
+
+static uint64_t adessoUs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static int inviaFrameDa(int sd, struct ProtoBuf* tx){
+    size_t off = 0;
+    int ok = !tx->errore;
+    while (ok && off < tx->len) {
+        ssize_t n = send(sd, tx->dati + off, tx->len - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) ok = 0;
+        else off += (size_t)n;
+    }
+    tx->len = 0; tx->errore = 0;
+    return ok ? 0 : -1;
+}
+
+// Un frame intero in rx (come il client): 0 ok, != 0 errore o chiusura
+static int riceviFrameIn(int sd, struct ProtoBuf* rx, uint8_t* tipo, struct ProtoLettore* r){
+    uint8_t intest[PROTO_MAX_INTEST];
+    size_t have = 2;
+    if (RecErr(recv(sd, intest, have, MSG_WAITALL), (int)have)) return -1;
+    while (intest[have-1] & 0x80) {
+        if (have == sizeof(intest)) return -1;
+        if (RecErr(recv(sd, intest + have, 1, MSG_WAITALL), 1)) return -1;
+        have++;
+    }
+    uint64_t carico;
+    int k = protoDecodificaNumero(intest + 1, have - 1, &carico);
+    if (k <= 0 || carico > MAX_FRAME) return -1;
+    rx->len = 0; rx->errore = 0;
+    if (protoRiserva(rx, have + carico) < 0) return -1;
+    memcpy(rx->dati, intest, have);
+    if (carico && RecErr(recv(sd, rx->dati + have, carico, MSG_WAITALL), (int)carico)) return -1;
+    rx->len = have + (size_t)carico;
+    *tipo = rx->dati[0];
+    protoApri(r, rx->dati, rx->len);
+    return r->errore ? -1 : 0;
+}
+
+static int attendi(struct Attore* a, int sd, uint8_t atteso, struct ProtoLettore* r){
+    uint8_t tipo;
+    return (riceviFrameIn(sd, &a->rx, &tipo, r) != 0 || tipo != atteso) ? -1 : 0;
+}
+
+// Connessione, saluto v2 e login: socket pronto al menu, -1 in caso di errore
+static int entra(struct Attore* a, const char* nick, int* nTemi){
+    struct ProtoLettore r;
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sd < 0) return -1;
+    uint16_t net;
+    if (connect(sd, (struct sockaddr*)&g_srv, sizeof(g_srv)) < 0 ||
+        RecErr(recv(sd, &net, sizeof(net), MSG_WAITALL), sizeof(net)) ||
+        ntohs(net) == PROTO_OCCUPATO) { close(sd); return -1; }
+
+    char saluto[MaxUsernameL] = {0};
+    memcpy(saluto, PROTO_SALUTO, 3);
+    saluto[3] = PROTO_V2;
+    if (send(sd, saluto, sizeof(saluto), MSG_NOSIGNAL) != sizeof(saluto) ||
+        attendi(a, sd, FR_BENVENUTO, &r)) { close(sd); return -1; }
+
+    protoFrameStringa(&a->tx, FR_LOGIN, nick, strlen(nick));
+    if (inviaFrameDa(sd, &a->tx) || attendi(a, sd, FR_ESITO_LOGIN, &r) ||
+        protoLeggiNumero(&r) != 1 || attendi(a, sd, FR_TEMI, &r)) { close(sd); return -1; }
+    *nTemi = (int)protoLeggiNumero(&r);
+    return sd;
+}
+
+// Sessione completa con risposte errate: ogni tema inserisce e aggiorna una riga
+static int sessione(struct Attore* a, const char* nick){
+    struct ProtoLettore r;
+    int nTemi;
+    int sd = entra(a, nick, &nTemi);
+    if (sd < 0) return -1;
+    for (int t = 0; t < nTemi; t++) {
+        protoFrameNumero(&a->tx, FR_TEMA, (uint64_t)t);
+        if (inviaFrameDa(sd, &a->tx) || attendi(a, sd, FR_DOMANDA, &r)) goto errore;
+        for (int q = 0; q < NumQuest; q++) {
+            uint64_t t0 = adessoUs();
+            protoFrameStringa(&a->tx, FR_RISPOSTA, "x", 1);
+            if (inviaFrameDa(sd, &a->tx) || attendi(a, sd, FR_ESITO, &r)) goto errore;
+            if (q + 1 < NumQuest && attendi(a, sd, FR_DOMANDA, &r)) goto errore;
+            if (a->campioni && a->numCampioni < MAX_CAMPIONI)
+                a->campioni[a->numCampioni++] = (uint32_t)(adessoUs() - t0);
+        }
+    }
+    protoFrameVuoto(&a->tx, FR_FINE);
+    inviaFrameDa(sd, &a->tx);
+    close(sd);
+    return 0;
+errore:
+    close(sd);
+    return -1;
+}
+
+// Chiede le classifiche in ciclo: leggendo ogni risposta, o mai (bloccato)
+static void leggi(struct Attore* a, int legge){
+    struct ProtoLettore r;
+    char nick[MaxUsernameL];
+    int nTemi;
+    snprintf(nick, sizeof(nick), "%s%d", legge ? "lt" : "lb", a->id);
+    int sd = entra(a, nick, &nTemi);
+    if (sd < 0) { a->errori++; return; }
+    if (!legge) fcntl(sd, F_SETFL, fcntl(sd, F_GETFL) | O_NONBLOCK);
+
+    while (!atomic_load(&g_stop)) {
+        protoFrameVuoto(&a->tx, FR_CLASSIFICA);
+        if (legge) {
+            if (inviaFrameDa(sd, &a->tx) || attendi(a, sd, FR_CLASSIFICHE, &r)) { a->errori++; break; }
+            a->fatte++;
+            continue;
+        }
+        ssize_t n = send(sd, a->tx.dati, a->tx.len, MSG_NOSIGNAL);
+        a->tx.len = 0;
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) { a->errori++; break; }
+        if (n < 0) usleep(10 * 1000);           // il server ha smesso di leggerci
+        else { a->fatte++; usleep(1000); }      // ritmo fisso: la CPU resta a server e scrittori
+    }
+    close(sd);
+}
+
+static void* threadAttore(void* arg){
+    struct Attore* a = (struct Attore*)arg;
+    char nick[MaxUsernameL];
+    switch (a->ruolo) {
+    case RUOLO_RIEMPI:
+        for (long k; (k = atomic_fetch_sub(&g_daRiempire, 1)) > 0; ) {
+            snprintf(nick, sizeof(nick), "bc%ld", k % 10000000);
+            if (sessione(a, nick) == 0) a->fatte++; else a->errori++;
+        }
+        break;
+    case RUOLO_SCRITTORE:
+        // pochi nick per thread: con -p ognuno resta una sola riga per tema
+        for (unsigned long k = 0; !atomic_load(&g_stop); k++) {
+            snprintf(nick, sizeof(nick), "sc%d_%lu", a->id, k % 16);
+            if (sessione(a, nick) == 0) a->fatte++; else a->errori++;
+        }
+        break;
+    case RUOLO_LETTORE:  leggi(a, 1); break;
+    case RUOLO_BLOCCATO: leggi(a, 0); break;
+    }
+    return NULL;
+}
+
+static int confronta(const void* x, const void* y){
+    uint32_t a = *(const uint32_t*)x, b = *(const uint32_t*)y;
+    return (a > b) - (a < b);
+}
+
+// Avvia n attori per ogni ruolo indicato, attende secondi (0 = la fine del
+// lavoro) e stampa il risultato degli scrittori
+static int prova(const char* nome, int scrittori, int lettori, int bloccati, int secondi){
+    int n = scrittori + lettori + bloccati;
+    struct Attore* att = (struct Attore*)calloc(n, sizeof(*att));
+    if (!att) return -1;
+    atomic_store(&g_stop, 0);
+    uint64_t t0 = adessoUs();
+    for (int i = 0; i < n; i++) {
+        att[i].id    = i;
+        att[i].ruolo = (i < scrittori) ? (secondi ? RUOLO_SCRITTORE : RUOLO_RIEMPI)
+                     : (i < scrittori + lettori) ? RUOLO_LETTORE : RUOLO_BLOCCATO;
+        if (att[i].ruolo == RUOLO_SCRITTORE)
+            att[i].campioni = (uint32_t*)malloc(MAX_CAMPIONI * sizeof(uint32_t));
+        if (pthread_create(&att[i].tid, NULL, threadAttore, &att[i]) != 0) { n = i; break; }
+    }
+    if (secondi) {
+        sleep((unsigned int)secondi);
+        atomic_store(&g_stop, 1);
+    }
+    for (int i = 0; i < n; i++) pthread_join(att[i].tid, NULL);
+    double dt = (double)(adessoUs() - t0) / 1e6;
+
+    unsigned long sessioni = 0, letture = 0, errori = 0;
+    size_t num = 0;
+    uint32_t* tutti = (uint32_t*)malloc((size_t)(scrittori ? scrittori : 1) * MAX_CAMPIONI * sizeof(uint32_t));
+    for (int i = 0; i < n; i++) {
+        errori += att[i].errori;
+        if (att[i].ruolo == RUOLO_LETTORE) letture += att[i].fatte;
+        else if (att[i].ruolo != RUOLO_BLOCCATO) sessioni += att[i].fatte;
+        if (tutti && att[i].campioni) {
+            memcpy(tutti + num, att[i].campioni, att[i].numCampioni * sizeof(uint32_t));
+            num += att[i].numCampioni;
+        }
+    }
+    printf("  %-26s %8.1f sessioni/s", nome, (double)sessioni / dt);
+    if (num) {
+        qsort(tutti, num, sizeof(*tutti), confronta);
+        printf("   risposta p50 %5u us  p99 %6u us", tutti[num / 2], tutti[num * 99 / 100]);
+    }
+    if (lettori) printf("   %.1f classifiche/s", (double)letture / dt);
+    if (errori)  printf("   errori: %lu", errori);
+    printf("\n");
+
+    free(tutti);
+    for (int i = 0; i < n; i++) { free(att[i].campioni); free(att[i].tx.dati); free(att[i].rx.dati); }
+    free(att);
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    long righe = 20000;
+    int scrittori = 4, lettori = 8, bloccati = 8, secondi = 5;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:w:l:b:t:")) != -1) {
+        switch (opt) {
+        case 'r': righe     = atol(optarg); break;
+        case 'w': scrittori = atoi(optarg); break;
+        case 'l': lettori   = atoi(optarg); break;
+        case 'b': bloccati  = atoi(optarg); break;
+        case 't': secondi   = atoi(optarg); break;
+        default:
+            printf("Uso: %s [-r righe] [-w scrittori] [-l lettori] [-b bloccati] [-t secondi]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (scrittori <= 0 || secondi <= 0) return 1;
+
+    memset(&g_srv, 0, sizeof(g_srv));
+    g_srv.sin_family = AF_INET;
+    g_srv.sin_port   = htons(4242);
+    inet_pton(AF_INET, IPADDR, &g_srv.sin_addr);
+
+    printf("Riempimento: %ld righe per tema\n", righe);
+    atomic_store(&g_daRiempire, righe);
+    prova("riempimento", 16, 0, 0, 0);
+
+    printf("\nScrittori: %d, per %d s\n", scrittori, secondi);
+    prova("solo scrittori", scrittori, 0, 0, secondi);
+    char nome[64];
+    snprintf(nome, sizeof(nome), "+ %d lettori, %d bloccati", lettori, bloccati);
+    prova(nome, scrittori, lettori, bloccati, secondi);
+    return 0;
+}
@@ -0,0 +1,114 @@
+// ============================================================================
+// Autore: de Dato A.
+// BENCHMARK – normalizza() (normalizza.h)
+//
+// Confronta il throughput (MB/s) di tre versioni su risposte realistiche:
+//  - byte:     il vecchio ciclo (isspace/tolower/isalnum, scarta i non-ASCII)
+//  - tabella:  normalizzaScalare(), solo lookup table (con piegatura UTF-8)
+//  - sse2:     normalizza(), fast path vettoriale sui tratti ASCII
+// Prima di misurare verifica che tabella e sse2 diano lo stesso risultato.
+//
+// Uso: ./bench_normalizza [ripetizioni]
+// ============================================================================
+
+#include "normalizza.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+
+// Il normalizzatore precedente, per confronto
+static void normalizzaByte(const char* in, char* out, size_t cap){
+    size_t k = 0;
+    for (const unsigned char* p = (const unsigned char*)in; *p && k + 1 < cap; ++p) {
+        unsigned char c = *p;
+        if (isspace(c)) continue;
+        if (c & 0x80) continue;
+        c = (unsigned char)tolower(c);
+        if (isalnum(c)) out[k++] = (char)c;
+    }
+    out[k] = '\0';
+}
+
+static const char* brevi[] = {
+    "Inception", "Leonardo DiCaprio", "Jurassic Park", "Pulp Fiction",
+    "Perché sì", "Città del Vaticano", "L’isola che non c’è",
+    "Super Mario Bros. 3", "Il Signore degli Anelli: il ritorno del re",
+    "TCP/IP", "Linus Torvalds", "Straße", "Crème brûlée", "Nintendo Entertainment System",
+};
+
+// Testi lunghi (dimensione di una domanda): qui conta il fast path
+static const char* lunghi[] = {
+    "Quale film del 1994 vede protagonisti John Travolta e Samuel L. Jackson nei panni di due sicari?",
+    "Qual è il film di Christopher Nolan che esplora sogni condivisi e livelli di realtà sovrapposti?",
+    "In quale anno Linus Torvalds pubblicò la prima versione del kernel Linux su comp.os.minix?",
+    "Quale protocollo del livello di trasporto garantisce consegna affidabile e ordinata dei segmenti?",
+};
+
+static double secondi(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void misura(const char* nome, void (*f)(const char*, char*, size_t),
+                   const char** campioni, size_t num, long rip){
+    char out[512];
+    size_t byte = 0;
+    unsigned long somma = 0;                        // impedisce di eliminare il lavoro
+    double t0 = secondi();
+    for (long r = 0; r < rip; r++) {
+        for (size_t i = 0; i < num; i++) {
+            f(campioni[i], out, sizeof(out));
+            somma += (unsigned char)out[0];
+            byte += strlen(campioni[i]);
+        }
+    }
+    double dt = secondi() - t0;
+    printf("  %-8s %8.1f MB/s  %6.1f ns/testo  (%lu)\n", nome, (double)byte / dt / 1e6,
+           dt * 1e9 / ((double)rip * num), somma);
+}
+
+// Verifica: fast path e versione tabellare coincidono, anche sul posto
+static int verifica(void){
+    char in[128], a[128], b[128];
+    srand(1);
+    for (int it = 0; it < 200000; it++) {
+        size_t len = (size_t)(rand() % 100);
+        for (size_t i = 0; i < len; i++) {
+            int r = rand() % 10;
+            in[i] = (char)(r < 6 ? 32 + rand() % 95 : r < 8 ? 0xC3 : 0x80 + rand() % 64);
+        }
+        in[len] = '\0';
+        size_t cap = 1 + (size_t)(rand() % 128);
+        normalizzaScalare(in, a, cap);
+        normalizza(in, b, cap);
+        if (strcmp(a, b)) { printf("DIFFERENZA su \"%s\": \"%s\" vs \"%s\"\n", in, a, b); return -1; }
+        normalizzaScalare(in, a, sizeof(a));
+        normalizza(in, in, sizeof(in));
+        if (strcmp(in, a)) { printf("DIFFERENZA sul posto\n"); return -1; }
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    long rip = (argc > 1) ? atol(argv[1]) : 200000;
+    if (verifica() < 0) return 1;
+
+    char out[64];
+    printf("Esempi:\n");
+    size_t nb = sizeof(brevi) / sizeof(brevi[0]), nl = sizeof(lunghi) / sizeof(lunghi[0]);
+    for (size_t i = 0; i < nb; i++) {
+        normalizza(brevi[i], out, sizeof(out));
+        printf("  %-45s -> %s\n", brevi[i], out);
+    }
+    printf("\nRisposte brevi (%ld ripetizioni x %zu):\n", rip, nb);
+    misura("byte",    normalizzaByte,    brevi, nb, rip);
+    misura("tabella", normalizzaScalare, brevi, nb, rip);
+    misura("sse2",    normalizza,        brevi, nb, rip);
+    printf("\nTesti lunghi (%ld ripetizioni x %zu):\n", rip, nl);
+    misura("byte",    normalizzaByte,    lunghi, nl, rip);
+    misura("tabella", normalizzaScalare, lunghi, nl, rip);
+    misura("sse2",    normalizza,        lunghi, nl, rip);
+    return 0;
+}
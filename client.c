@@ -6,16 +6,29 @@
 //  - Menu principale con nickname preservato tra sessioni (Invio = conferma)
 //  - Selezione temi dei quiz con numero corrispondente (n)
 //  - Comando "Mostra Punteggio", classifica player OnLine
+//  - Comando "Classifica Live": classifiche aggiornate in tempo reale (solo
+//    variazioni dal server), Invio per tornare ai temi
+//  - Comando "Stanza <n>": partita dal vivo con gli altri giocatori nella
+//    stanza del tema n (stesse domande nello stesso istante)
 //  - Quiz a domande con input robusto e invio in buffer azzerato
 //  - Rilevamento immediato shutdown server (select su stdin+socket)
 //  - Persistenza in-memoria (per nickname) dei temi già svolti anche se torni al menu
+//  - Protocollo v2 (frame tipizzati, vedi protocollo.h) negoziato alla connessione
+//  - Modalità bot (flag -b): generatore di carico senza interfaccia, con
+//    throughput e latenze p50/p99/p999 per passo del protocollo
 //
 // ============================================================================
 
 #include "utility.h"
+#include "protocollo.h"   // frame v2
 #include <sys/select.h>   // select() per gestione I/O reattiva
 #include <errno.h>        // errno per select
 #include <ctype.h>        // isspace (per trim locale)
+#include <pthread.h>      // thread dei bot (generatore di carico)
+#include <dirent.h>       // lettura di qa/ per le risposte dei bot
+#include <time.h>         // clock_gettime per le latenze
+#include <stdatomic.h>    // arresto dei bot
+#include <getopt.h>       // flag della modalità bot
 
 // ---------------------------- Colorazione ANSI --------------------------------
 #define COL_OK    "\x1b[32m"
@@ -24,14 +37,11 @@
 #define COL_BOLD  "\x1b[1m"
 #define COL_RST   "\x1b[0m"
 
-// ---------------------------- Protocollo (client->server) ---------------------
-// NB: lato server l’handler decodifica così:
-//  0 = end session, 
-//  1 = show score, 
-//  >=3 tema scelto (temaIdx = cmd - 3)
-#define CMD_END         0
-#define CMD_SHOW        1
-#define CMD_THEME_BASE  3   // manda: CMD_THEME_BASE + (idTema - 1)
+// ---------------------------- Protocollo (client<->server) ---------------------
+// Il client parla v2: dopo il numero di temi invia il saluto e da lì in poi
+// scambia solo frame tipizzati (FR_LOGIN, FR_TEMA, FR_RISPOSTA, ...).
+// Il tema si seleziona con il suo indice da 0 (id mostrato - 1).
+#define MAX_FRAME_SERVER  (64u << 20)   // limite di sicurezza per un frame ricevuto
 
 // ---------------------------- Strutture dati client ---------------------------
 
@@ -64,6 +74,10 @@ static char g_last_nick[MaxUsernameL] = ""; // nickname riutilizzato (Invio per
 // archivio profili in-memoria
 static struct Profilo* g_profili = NULL;
 
+// buffer dei frame v2 (riusati per tutta la vita del client)
+static struct ProtoBuf g_tx;
+static struct ProtoBuf g_rx;
+
 // ---------------------------- Utility UI --------------------------------------
 static inline void riga() { StampaNumPiu(); }
 static void titolo(const char* s)   { printf(COL_BOLD "%s" COL_RST "\n", s); }
@@ -226,6 +240,10 @@ static void stampaTemi(struct Tema* l){
     nota_dim("\n Suggerimenti:");
     nota_dim(" - Digita " COL_BOLD "Mostra Punteggio" COL_RST COL_DIM
          " per la Classifica Globale dei Giocatori On Line.");
+    nota_dim(" - Digita " COL_BOLD "Classifica Live" COL_RST COL_DIM
+         " per seguirla in tempo reale (Invio per uscire).");
+    nota_dim(" - Digita " COL_BOLD "Stanza <n>" COL_RST COL_DIM
+         " per giocare il tema n in diretta con gli altri (Fine Quiz per uscire).");
     nota_dim(" - Digita " COL_BOLD "0" COL_RST COL_DIM
          " per tornare al menu principale.");
     nota_dim("(Nota: se torni al menù principale, non potrai comunque rifare i quiz già sostenuti su questo profilo, e sarai rimosso dalla Classifica Globale.)\n");
@@ -246,54 +264,461 @@ static void serverSpento_print(){
     printf("Premi " COL_BOLD "2" COL_RST " per uscire.\n\n");
 }
 
+// ---------------------------- Frame v2 ----------------------------------------
+// Invia (e svuota) i frame composti in tx
+static int inviaFrameDa(int sd, struct ProtoBuf* tx){
+    size_t off = 0;
+    int ok = !tx->errore;
+    while (ok && off < tx->len) {
+        ssize_t n = send(sd, tx->dati + off, tx->len - off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) ok = 0;
+        else off += (size_t)n;
+    }
+    tx->len = 0; tx->errore = 0;
+    return ok ? 0 : -1;
+}
+
+static int inviaFrame(int sd){ return inviaFrameDa(sd, &g_tx); }
+
+static int inviaVuoto(int sd, uint8_t tipo){
+    protoFrameVuoto(&g_tx, tipo);
+    return inviaFrame(sd);
+}
+
+// Riceve un frame intero in rx: intestazione (tipo + varint), poi payload.
+// Ritorni come RecErr: 0 ok, 1 connessione chiusa, -1 errore/frame non valido.
+static int riceviFrameIn(int sd, struct ProtoBuf* rx, uint8_t* tipo, struct ProtoLettore* r){
+    uint8_t intest[PROTO_MAX_INTEST];
+    size_t have = 2;
+    int ret = recv(sd, intest, have, MSG_WAITALL);
+    ret = RecErr(ret, (int)have);
+    if (ret) return ret;
+    while (intest[have-1] & 0x80) {                 // varint della lunghezza non finito
+        if (have == sizeof(intest)) return -1;
+        ret = recv(sd, intest + have, 1, MSG_WAITALL);
+        ret = RecErr(ret, 1);
+        if (ret) return ret;
+        have++;
+    }
+
+    uint64_t carico;
+    int k = protoDecodificaNumero(intest + 1, have - 1, &carico);
+    if (k <= 0 || carico > MAX_FRAME_SERVER) return -1;
+    rx->len = 0; rx->errore = 0;
+    if (protoRiserva(rx, have + carico) < 0) return -1;
+    memcpy(rx->dati, intest, have);
+    if (carico) {
+        ret = recv(sd, rx->dati + have, carico, MSG_WAITALL);
+        ret = RecErr(ret, (int)carico);
+        if (ret) return ret;
+    }
+    rx->len = have + (size_t)carico;
+
+    *tipo = rx->dati[0];
+    protoApri(r, rx->dati, rx->len);
+    return r->errore ? -1 : 0;
+}
+
+static int riceviFrame(int sd, uint8_t* tipo, struct ProtoLettore* r){
+    return riceviFrameIn(sd, &g_rx, tipo, r);
+}
+
+// Riceve un frame del tipo atteso; stampa l'errore e ritorna != 0 altrimenti
+static int attendiFrame(int sd, uint8_t atteso, struct ProtoLettore* r, const char* cosa){
+    uint8_t tipo;
+    int ret = riceviFrame(sd, &tipo, r);
+    if (ret == 0 && tipo != atteso) ret = -1;
+    if (ret){
+        if (ret < 0) fprintf(stderr, "recv %s: frame non valido\n", cosa);
+        serverSpento_print();
+    }
+    return ret;
+}
+
 // ---------------------------- Show-score (classifiche online) -----------------
-// Riceve dal server (per ogni tema): nome tema, numero record, coppie (nick, punteggio).
-// Formatta in modo vicino a quello del server.
-static int riceviClassifiche(int sd, int nTemi, char* buf){
-    uint16_t net; int ret, n;
+// Un solo frame FR_CLASSIFICHE: per ogni tema nome, numero record e coppie
+// (nick, punteggio). Formatta in modo vicino a quello del server.
+static int riceviClassifiche(int sd){
+    struct ProtoLettore r;
+    if (attendiFrame(sd, FR_CLASSIFICHE, &r, "classifiche")) return -1;
 
     titolo("Classifica Online");
     riga();
-    for (int i=0; i<nTemi; i++) {
-        // nome tema
-        ret = recv(sd, buf, MaxReadL, MSG_WAITALL);
-        ret = RecErr(ret, MaxReadL);
-        if (ret){ if (ret<0) perror("recv tema"); serverSpento_print(); return -1; }
-        printf("[%s]\n", buf);
-
-        // numero giocatori
-        ret = recv(sd, &net, sizeof(net), MSG_WAITALL);
-        ret = RecErr(ret, sizeof(net));
-        if (ret){ if (ret<0) perror("recv num"); serverSpento_print(); return -1; }
-        n = ntohs(net);
+    uint64_t nTemi = protoLeggiNumero(&r);
+    for (uint64_t i=0; i<nTemi && !r.errore; i++) {
+        const char* s;
+        size_t len = protoLeggiStringa(&r, &s);
+        printf("[%.*s]\n", (int)len, s);
+
+        uint64_t n = protoLeggiNumero(&r);
+        for (uint64_t j=0; j<n && !r.errore; j++) {
+            len = protoLeggiStringa(&r, &s);
+            printf("  - %-16.*s : ", (int)len, s);
+            printf("%llu\n", (unsigned long long)protoLeggiNumero(&r));
+        }
+        printf("\n");
+    }
+    riga();
+    if (r.errore) { fprintf(stderr, "recv classifiche: frame non valido\n"); return -1; }
+    return 0;
+}
+
+// ---------------------------- Classifica Live ---------------------------------
+// FR_ISCRIVI 1: il server risponde FR_ISCRIZIONE 1 + FR_CLASSIFICHE (copia
+// locale di partenza), poi solo FR_DELTA con le variazioni da applicare.
+// Un nuovo FR_ISCRIZIONE 1 (es. dopo un riavvio del server) riparte da zero.
+// Invio: FR_ISCRIVI 0, si scartano i frame fino a FR_ISCRIZIONE 0.
+#define LIVE_RIGHE  10                  // righe mostrate per tema
+#define LIVE_HZ     10                  // ridisegni al secondo al massimo
+
+struct RigaLive {
+    char               nick[MaxUsernameL];
+    unsigned long long punti;
+};
+
+struct TemaLive {
+    char             nome[MaxReadL];
+    struct RigaLive* righe;
+    size_t           num, cap;
+};
 
-        // ogni record
-        for (int j=0; j<n; j++) {
-            ret = recv(sd, buf, MaxReadL, MSG_WAITALL);
-            ret = RecErr(ret, MaxReadL);
-            if (ret){ if (ret<0) perror("recv nick"); serverSpento_print(); return -1; }
-            printf("  - %-16s : ", buf);
+struct Live {
+    struct TemaLive* temi;
+    size_t           numTemi;
+    unsigned long long byte, delta;     // ricevuti da inizio diretta
+};
+
+static void liveLibera(struct Live* l){
+    for (size_t i=0; i<l->numTemi; i++) free(l->temi[i].righe);
+    free(l->temi);
+    l->temi = NULL; l->numTemi = 0;
+}
 
-            ret = recv(sd, &net, sizeof(net), MSG_WAITALL);
-            ret = RecErr(ret, sizeof(net));
-            if (ret){ if (ret<0) perror("recv score"); serverSpento_print(); return -1; }
-            printf("%d\n", ntohs(net));
+static void liveStringa(struct ProtoLettore* r, char* out, size_t cap){
+    const char* s;
+    size_t len = protoLeggiStringa(r, &s);
+    if (len >= cap) len = cap - 1;
+    memcpy(out, s, len); out[len] = '\0';
+}
+
+// Inserisce una riga libera in posizione pos (da 0); NULL se non c'è memoria
+static struct RigaLive* liveApri(struct TemaLive* t, size_t pos){
+    if (t->num == t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 64;
+        struct RigaLive* n = (struct RigaLive*)realloc(t->righe, cap * sizeof(*n));
+        if (!n) return NULL;
+        t->righe = n; t->cap = cap;
+    }
+    memmove(t->righe + pos + 1, t->righe + pos, (t->num - pos) * sizeof(*t->righe));
+    t->num++;
+    return &t->righe[pos];
+}
+
+static void liveChiudi(struct TemaLive* t, size_t pos){
+    memmove(t->righe + pos, t->righe + pos + 1, (t->num - pos - 1) * sizeof(*t->righe));
+    t->num--;
+}
+
+// Copia locale da FR_CLASSIFICHE
+static int liveIstantanea(struct Live* l, struct ProtoLettore* r){
+    liveLibera(l);
+    uint64_t nTemi = protoLeggiNumero(r);
+    if (r->errore || nTemi > 4096) return -1;
+    l->temi = (struct TemaLive*)calloc(nTemi ? nTemi : 1, sizeof(*l->temi));
+    if (!l->temi) return -1;
+    l->numTemi = nTemi;
+    for (size_t i=0; i<nTemi && !r->errore; i++) {
+        struct TemaLive* t = &l->temi[i];
+        liveStringa(r, t->nome, sizeof(t->nome));
+        uint64_t n = protoLeggiNumero(r);
+        for (uint64_t j=0; j<n && !r->errore; j++) {
+            struct RigaLive* x = liveApri(t, t->num);
+            if (!x) return -1;
+            liveStringa(r, x->nick, sizeof(x->nick));
+            x->punti = protoLeggiNumero(r);
         }
+    }
+    return r->errore ? -1 : 0;
+}
+
+// Applica un FR_DELTA; le posizioni fuori dalla copia locale sono un errore
+static int liveDelta(struct Live* l, struct ProtoLettore* r){
+    uint64_t k = protoLeggiNumero(r);
+    uint64_t n = protoLeggiNumero(r);
+    if (r->errore || k >= l->numTemi) return -1;
+    struct TemaLive* t = &l->temi[k];
+
+    for (uint64_t j=0; j<n && !r->errore; j++) {
+        uint64_t op = protoLeggiNumero(r);
+        uint64_t da = protoLeggiNumero(r);
+        struct RigaLive riga;
+        if (op == DELTA_INSERITO) {
+            if (da < 1 || da > t->num + 1) return -1;
+            struct RigaLive* x = liveApri(t, da - 1);
+            if (!x) return -1;
+            liveStringa(r, x->nick, sizeof(x->nick));
+            x->punti = protoLeggiNumero(r);
+        } else if (op == DELTA_SPOSTATO) {
+            uint64_t a = protoLeggiNumero(r);
+            if (da < 1 || da > t->num || a < 1 || a > t->num) return -1;
+            riga = t->righe[da - 1];
+            riga.punti = protoLeggiNumero(r);
+            liveChiudi(t, da - 1);
+            *liveApri(t, a - 1) = riga;             // spazio appena liberato
+        } else if (op == DELTA_RIMOSSO) {
+            if (da < 1 || da > t->num) return -1;
+            liveChiudi(t, da - 1);
+        } else {
+            return -1;
+        }
+    }
+    l->delta++;
+    return r->errore ? -1 : 0;
+}
+
+static void liveStampa(const struct Live* l){
+    printf("\x1b[H\x1b[2J");
+    titolo("Classifica Live");
+    riga();
+    for (size_t i=0; i<l->numTemi; i++) {
+        const struct TemaLive* t = &l->temi[i];
+        printf("[%s] " COL_DIM "%zu giocatori" COL_RST "\n", t->nome, t->num);
+        for (size_t j=0; j<t->num && j<LIVE_RIGHE; j++)
+            printf("  %2zu. %-16s : %llu\n", j+1, t->righe[j].nick, t->righe[j].punti);
         printf("\n");
     }
     riga();
-    return 0;
+    printf(COL_DIM "%llu aggiornamenti, %llu byte ricevuti" COL_RST "\n", l->delta, l->byte);
+    nota_dim("Premi Invio per tornare ai temi.");
+    fflush(stdout);
+}
+
+// Ritorna 0 a diretta chiusa, 1 se il server si è spento, -1 su errore
+static int classificaLive(int sd){
+    struct ProtoLettore r;
+    struct Live l = {0};
+    protoFrameNumero(&g_tx, FR_ISCRIVI, 1);
+    if (inviaFrame(sd) < 0) { perror("send iscrizione"); return 1; }
+
+    int esito = 0, attiva = 1, daStampare = 0, uscita = 0;
+    struct timespec ultima = {0};
+    while (!uscita) {
+        fd_set rfds; FD_ZERO(&rfds);
+        FD_SET(sd, &rfds);
+        if (attiva) FD_SET(STDIN_FILENO, &rfds);
+        struct timeval tv = { 0, 1000000 / LIVE_HZ };
+        int sel = select(sd + 1, &rfds, NULL, NULL, daStampare ? &tv : NULL);
+        if (sel < 0) {
+            if (errno == EINTR) continue;
+            perror("select"); esito = -1; break;
+        }
+
+        if (attiva && FD_ISSET(STDIN_FILENO, &rfds)) {
+            char buf[MaxReadL];
+            if (!fgets(buf, sizeof(buf), stdin)) { esito = -1; break; }
+            protoFrameNumero(&g_tx, FR_ISCRIVI, 0);
+            if (inviaFrame(sd) < 0) { esito = 1; break; }
+            attiva = 0;                             // si attende la conferma
+        }
+
+        if (FD_ISSET(sd, &rfds)) {
+            uint8_t tipo;
+            int ret = riceviFrame(sd, &tipo, &r);
+            if (ret) {
+                if (ret > 0) { g_server_spento = 1; serverSpento_print(); }
+                else fprintf(stderr, "recv classifica live: frame non valido\n");
+                esito = ret; break;
+            }
+            l.byte += g_rx.len;
+            if (tipo == FR_ISCRIZIONE) {
+                if (protoLeggiNumero(&r) == 0) uscita = 1;
+            } else if (tipo == FR_CLASSIFICHE) {
+                if (attiva && liveIstantanea(&l, &r) < 0) ret = -1;
+            } else if (tipo == FR_DELTA) {
+                if (attiva && liveDelta(&l, &r) < 0) ret = -1;
+            } else {
+                ret = -1;
+            }
+            if (ret) { fprintf(stderr, "recv classifica live: frame non valido\n"); esito = -1; break; }
+            daStampare = attiva && tipo != FR_ISCRIZIONE;
+        }
+
+        // al massimo LIVE_HZ ridisegni al secondo
+        struct timespec ora;
+        clock_gettime(CLOCK_MONOTONIC, &ora);
+        long ms = (ora.tv_sec - ultima.tv_sec) * 1000 + (ora.tv_nsec - ultima.tv_nsec) / 1000000;
+        if (daStampare && ms >= 1000 / LIVE_HZ) {
+            liveStampa(&l);
+            ultima = ora;
+            daStampare = 0;
+        }
+    }
+
+    if (esito == 0 && attiva)                       // chiusa dal server (client troppo lento)
+        printf(COL_ERR "Classifica live non disponibile o interrotta dal server." COL_RST "\n");
+    liveLibera(&l);
+    return esito;
+}
+
+// ---------------------------- Stanze multigiocatore ---------------------------
+// FR_STANZA con l'indice del tema: il server risponde con lo stato della
+// stanza, poi spinge a tutti i membri insieme domande (FR_STANZA_DOMANDA),
+// risultati di ogni turno e classifica finale (FR_STANZA_FINE, che chiude
+// sempre la stanza). Si risponde scrivendo mentre la domanda è aperta, una
+// volta per turno; "Fine Quiz" lascia la stanza (FR_ESCI_STANZA).
+static void stanzaRighe(struct ProtoLettore* r){
+    uint64_t n = protoLeggiNumero(r);
+    for (uint64_t i=0; i<n && !r->errore; i++) {
+        const char* s;
+        size_t len = protoLeggiStringa(r, &s);
+        printf("  %2llu. %-16.*s : %llu\n", (unsigned long long)i+1, (int)len, s,
+               (unsigned long long)protoLeggiNumero(r));
+    }
+}
+
+// Ritorna 0 a stanza chiusa, 1 se il server si è spento, -1 su errore
+static int giocaStanza(int sd, int idx, const char* nome){
+    struct ProtoLettore r;
+    protoFrameNumero(&g_tx, FR_STANZA, (uint64_t)idx);
+    if (inviaFrame(sd) < 0) { perror("send stanza"); return 1; }
+
+    printf("\n" COL_BOLD "Stanza: %s" COL_RST "\n", nome);
+    nota_dim("Le domande arrivano a tutti insieme: scrivi la risposta finché è aperta.");
+    nota_dim("Digita " COL_BOLD "Fine Quiz" COL_RST COL_DIM " per lasciare la stanza.");
+
+    uint64_t turno = 0, presenti = 0, fase = UINT64_MAX, ms = 0;
+    int aperta = 0, uscita = 0, esito = 0, inUscita = 0;
+    unsigned int punti = 0;
+    while (!uscita) {
+        fd_set rfds; FD_ZERO(&rfds);
+        FD_SET(sd, &rfds);
+        if (!inUscita) FD_SET(STDIN_FILENO, &rfds);
+        if (select(sd + 1, &rfds, NULL, NULL, NULL) < 0) {
+            if (errno == EINTR) continue;
+            perror("select"); esito = -1; break;
+        }
+
+        if (!inUscita && FD_ISSET(STDIN_FILENO, &rfds)) {
+            char buf[MaxRispostaL];
+            if (!fgets(buf, sizeof(buf), stdin)) { esito = -1; break; }
+            buf[strcspn(buf, "\n")] = '\0';
+            trim(buf);
+            if (!strcmp(buf, EndQuiz)) {
+                if (inviaVuoto(sd, FR_ESCI_STANZA) < 0) { esito = 1; break; }
+                inUscita = 1;                       // si attende FR_STANZA_FINE
+            } else if (buf[0] && aperta) {
+                protoFrameStringa(&g_tx, FR_RISPOSTA, buf, strlen(buf));
+                if (inviaFrame(sd) < 0) { esito = 1; break; }
+                aperta = 0;
+            } else if (buf[0]) {
+                nota_dim("Nessuna domanda aperta: attendi la prossima.");
+            }
+        }
+
+        if (FD_ISSET(sd, &rfds)) {
+            uint8_t tipo;
+            int ret = riceviFrame(sd, &tipo, &r);
+            if (ret) {
+                if (ret > 0) { g_server_spento = 1; serverSpento_print(); }
+                else fprintf(stderr, "recv stanza: frame non valido\n");
+                esito = ret; break;
+            }
+            if (tipo == FR_STANZA_STATO) {
+                uint64_t f = protoLeggiNumero(&r), p = protoLeggiNumero(&r), m = protoLeggiNumero(&r);
+                int conta = m || p < 2;             // senza conto alla rovescia: sta per partire
+                if (f == STANZA_IN_ATTESA && conta && (f != fase || p != presenti || m / 1000 != ms / 1000)) {
+                    printf(COL_DIM "In attesa: %llu giocatori", (unsigned long long)p);
+                    if (m) printf(", si parte tra %llu s", (unsigned long long)(m + 999) / 1000);
+                    else   printf(", ne servono almeno 2");
+                    printf(COL_RST "\n");
+                } else if (f != STANZA_IN_ATTESA && p != presenti) {
+                    printf(COL_DIM "(%llu giocatori nella stanza)" COL_RST "\n", (unsigned long long)p);
+                }
+                fase = f; presenti = p; ms = m;
+            } else if (tipo == FR_STANZA_DOMANDA) {
+                uint64_t t = protoLeggiNumero(&r), m = protoLeggiNumero(&r);
+                const char* d;
+                size_t len = protoLeggiStringa(&r, &d);
+                if (t != turno && !r.errore) {      // la stessa domanda può arrivare due volte all'ingresso
+                    turno = t; aperta = 1;
+                    riga();
+                    printf("Domanda %llu/%d " COL_DIM "(%llu s)" COL_RST ": %.*s\n",
+                           (unsigned long long)t, NumQuest, (unsigned long long)(m + 999) / 1000, (int)len, d);
+                    printf("Risposta: "); fflush(stdout);
+                }
+            } else if (tipo == FR_ESITO) {
+                uint64_t e = protoLeggiNumero(&r);
+                if (e == 0)      { printf(COL_OK  "CORRETTA" COL_RST "\n"); punti++; }
+                else if (e == 1) printf(COL_ERR "ERRATA" COL_RST "\n");
+                else             printf(COL_ERR "Fuori tempo: la domanda è già chiusa." COL_RST "\n");
+            } else if (tipo == FR_STANZA_RISULTATI) {
+                uint64_t t = protoLeggiNumero(&r);
+                const char* g;
+                size_t len = protoLeggiStringa(&r, &g);
+                uint64_t giuste = protoLeggiNumero(&r), date = protoLeggiNumero(&r);
+                aperta = 0;
+                printf("\n" COL_BOLD "Turno %llu" COL_RST ": risposta giusta " COL_BOLD "%.*s" COL_RST
+                       " (%llu giuste su %llu risposte)\n", (unsigned long long)t, (int)len, g,
+                       (unsigned long long)giuste, (unsigned long long)date);
+                stanzaRighe(&r);
+            } else if (tipo == FR_STANZA_FINE) {
+                if (protoLeggiNumero(&r) > 0) {
+                    protoApri(&r, g_rx.dati, g_rx.len);
+                    printf("\n");
+                    titolo("Classifica finale della stanza");
+                    riga();
+                    stanzaRighe(&r);
+                    riga();
+                    printf("Hai totalizzato " COL_BOLD "%u/%d" COL_RST "\n", punti, NumQuest);
+                } else if (inUscita) {
+                    nota_dim("Hai lasciato la stanza.");
+                } else {
+                    printf(COL_ERR "Stanze non disponibili su questo server." COL_RST "\n");
+                }
+                uscita = 1;
+            } else {
+                r.errore = 1;
+            }
+            if (r.errore) { fprintf(stderr, "recv stanza: frame non valido\n"); esito = -1; break; }
+        }
+    }
+    return esito;
 }
 
 // ---------------------------- Sessione quiz (protocollo completo) ------------
 static int sessioneQuiz(int sd){
     uint16_t net; int ret;
+    struct ProtoLettore r;
+
+    // (1) Numero temi (preambolo comune a v1 e v2); PROTO_OCCUPATO = in coda
+    while (1) {
+        ret = recv(sd, &net, sizeof(net), MSG_WAITALL);
+        ret = RecErr(ret, sizeof(net));
+        if (ret){ if (ret<0) perror("recv numTemi"); return 1; }
+        if (ntohs(net) != PROTO_OCCUPATO) break;
+
+        if (attendiFrame(sd, FR_OCCUPATO, &r, "occupato")) return 1;
+        unsigned long long pos = protoLeggiNumero(&r), ms = protoLeggiNumero(&r);
+        if (pos == 0) {
+            printf(COL_ERR "Server pieno, anche la coda di attesa: riprova più tardi." COL_RST "\n");
+            return 0;
+        }
+        printf(COL_DIM "Server occupato: sei in coda in posizione %llu", pos);
+        if (ms) printf(", attesa stimata ~%llu s", (ms + 999) / 1000);
+        printf(". Attendi..." COL_RST "\n");
+        fflush(stdout);
+    }
 
-    // (1) Numero temi
-    ret = recv(sd, &net, sizeof(net), MSG_WAITALL);
-    ret = RecErr(ret, sizeof(net));
-    if (ret){ if (ret<0) perror("recv numTemi"); return 1; }
-    int nTemi = ntohs(net);
+    // (1b) Negoziazione v2: saluto nel frame di login, il server conferma
+    char saluto[MaxUsernameL] = {0};
+    memcpy(saluto, PROTO_SALUTO, 3);
+    saluto[3] = PROTO_V2;
+    if (send(sd, saluto, MaxUsernameL, MSG_NOSIGNAL) < 0) { perror("send saluto"); return 1; }
+    if (attendiFrame(sd, FR_BENVENUTO, &r, "benvenuto")) {
+        printf(COL_ERR "Il server non supporta il protocollo v2." COL_RST "\n");
+        return 1;
+    }
 
     // (2) Login nickname (riusa default con Invio vuoto)
     struct Profilo* prof = NULL;
@@ -306,41 +731,39 @@ static int sessioneQuiz(int sd){
         if (lr == -2) return 1;                 // server spento
         if (lr == 0)  return -1;                // EOF stdin
 
-        // invia nome in buffer a lunghezza fissa
-        char tosend[MaxUsernameL] = {0};
-        strncpy(tosend, nick, MaxUsernameL-1);
-        if (send(sd, tosend, MaxUsernameL, MSG_NOSIGNAL) < 0) { perror("send nick"); return 1; }
-
         // comandi speciali prima del login accettato
-        if (!strcmp(nick, EndQuiz)) return 0;
+        if (!strcmp(nick, EndQuiz)) { inviaVuoto(sd, FR_FINE); return 0; }
         if (!strcmp(nick, ShowScore)){
-            if (riceviClassifiche(sd, nTemi, tosend) < 0) return 1;
+            if (inviaVuoto(sd, FR_CLASSIFICA) < 0) { perror("send show"); return 1; }
+            if (riceviClassifiche(sd) < 0) return 1;
             continue;
         }
 
+        protoFrameStringa(&g_tx, FR_LOGIN, nick, strlen(nick));
+        if (inviaFrame(sd) < 0) { perror("send nick"); return 1; }
+
         // ack univocità
-        ret = recv(sd, &net, sizeof(net), MSG_WAITALL);
-        ret = RecErr(ret, sizeof(net));
-        if (ret){ if (ret<0) perror("recv ack"); return 1; }
-        int ok = ntohs(net);
+        if (attendiFrame(sd, FR_ESITO_LOGIN, &r, "ack")) return 1;
+        int ok = (int)protoLeggiNumero(&r);
         if (ok) { strncpy(g_last_nick, nick, MaxUsernameL); prof = get_profilo(g_last_nick); break; }
         printf(COL_ERR "Nickname già in uso. Riprova." COL_RST "\n");
     }
 
     // (3) Elenco temi ricevuti dal server — filtriamo localmente quelli già svolti dal profilo
+    if (attendiFrame(sd, FR_TEMI, &r, "temi")) return 1;
     struct Tema *temi = NULL, *last = NULL;
-    char buf[MaxReadL];
-    for (int i=1; i<=nTemi; i++) {
-        ret = recv(sd, buf, MaxReadL, MSG_WAITALL);
-        ret = RecErr(ret, MaxReadL);
-        if (ret){ if (ret<0) perror("recv tema"); serverSpento_print(); liberaTemi(temi); return 1; }
+    int nTemi = (int)protoLeggiNumero(&r);
+    for (int i=1; i<=nTemi && !r.errore; i++) {
+        const char* nome;
+        size_t len = protoLeggiStringa(&r, &nome);
 
         // Se già completato per questo nick
         // NON si vede più tra i selezionabili
         if (prof && (prof->mask_done & (1u << (i-1)))) continue;
 
         struct Tema* n = (struct Tema*)malloc(sizeof(*n));
-        strncpy(n->nome, buf, MaxReadL); n->nome[MaxReadL-1] = '\0';
+        if (len >= MaxReadL) len = MaxReadL - 1;
+        memcpy(n->nome, nome, len); n->nome[len] = '\0';
         n->id = i; n->next = NULL;
         if (!temi) temi = n; else last->next = n; last = n;
     }
@@ -358,15 +781,26 @@ static int sessioneQuiz(int sd){
         int lr = leggiLinea_reactive(sd, "Seleziona", scelta, MaxReadL, NULL);
         if (lr == -2) { liberaTemi(temi); liberaCompletati(stor); return 1; } // server spento
         if (!strcmp(scelta, "0")) {
-            uint16_t cmd = htons(CMD_END);
-            send(sd, &cmd, sizeof(cmd), MSG_NOSIGNAL); // fine sessione lato server
+            inviaVuoto(sd, FR_FINE);    // fine sessione lato server
             liberaTemi(temi); liberaCompletati(stor);
             return 0;  // torna al menu SENZA perdere nickname/profilo
         }
         if (!strcmp(scelta, ShowScore)) {
-            uint16_t cmd = htons(CMD_SHOW);
-            if (send(sd, &cmd, sizeof(cmd), MSG_NOSIGNAL) < 0) perror("send show");
-            if (riceviClassifiche(sd, nTemi, buf) < 0) { liberaTemi(temi); liberaCompletati(stor); return 1; }
+            if (inviaVuoto(sd, FR_CLASSIFICA) < 0) perror("send show");
+            if (riceviClassifiche(sd) < 0) { liberaTemi(temi); liberaCompletati(stor); return 1; }
+            continue;
+        }
+        if (!strcmp(scelta, LiveScore)) {
+            if (classificaLive(sd)) { liberaTemi(temi); liberaCompletati(stor); return 1; }
+            continue;
+        }
+
+        if (!strncmp(scelta, RoomPlay " ", strlen(RoomPlay) + 1)) {
+            int n = atoi(scelta + strlen(RoomPlay) + 1);
+            if (n < 1 || n > nTemi) { printf("Scelta non valida.\n"); continue; }
+            const char* nome = "";
+            for (struct Tema* x=temi; x; x=x->next) if (x->id == n) nome = x->nome;
+            if (giocaStanza(sd, n - 1, nome[0] ? nome : scelta)) { liberaTemi(temi); liberaCompletati(stor); return 1; }
             continue;
         }
 
@@ -376,9 +810,9 @@ static int sessioneQuiz(int sd){
         struct Tema* t = estraiTema(&temi, id);
         if (!t) { printf("Scelta non valida.\n"); continue; }
 
-        // invio selezione tema col mapping corretto (id 1->3, 2->4, ...)
-        uint16_t cmd = htons(CMD_THEME_BASE + (id - 1));
-        if (send(sd, &cmd, sizeof(cmd), MSG_NOSIGNAL) < 0) {
+        // invio selezione tema (indice da 0)
+        protoFrameNumero(&g_tx, FR_TEMA, (uint64_t)(id - 1));
+        if (inviaFrame(sd) < 0) {
             perror("send tema"); free(t); liberaTemi(temi); liberaCompletati(stor); return 1;
         }
 
@@ -386,46 +820,53 @@ static int sessioneQuiz(int sd){
 
         // --- ciclo domande ---
         unsigned int corrette = 0;
+        int nuovaDomanda = 1;               // 0 dopo "Mostra Punteggio": stessa domanda
+        char domanda[1024];
         for (int q=0; q<NumQuest; q++) {
-            char domanda[MaxReadQuestL];
 
-            // ricevo domanda
-            ret = recv(sd, domanda, MaxReadQuestL, MSG_WAITALL);
-            ret = RecErr(ret, MaxReadQuestL);
-            if (ret){ if (ret<0) perror("recv domanda"); serverSpento_print(); free(t); liberaTemi(temi); liberaCompletati(stor); return 1; }
+            // ricevo domanda (testo a lunghezza variabile)
+            if (nuovaDomanda) {
+                if (attendiFrame(sd, FR_DOMANDA, &r, "domanda")) { free(t); liberaTemi(temi); liberaCompletati(stor); return 1; }
+                const char* d;
+                size_t len = protoLeggiStringa(&r, &d);
+                if (len >= sizeof(domanda)) len = sizeof(domanda) - 1;
+                memcpy(domanda, d, len); domanda[len] = '\0';
+            }
+            nuovaDomanda = 1;
 
             riga();
             printf("Domanda %d: %s\n", q+1, domanda);
 
             // leggo risposta reattivamente (possibile shutdown mentre scrivo)
-            char risposta[MaxReadL];
-            int lr2 = leggiLinea_reactive(sd, "Risposta", risposta, MaxReadL, NULL);
+            char risposta[MaxRispostaL];
+            int lr2 = leggiLinea_reactive(sd, "Risposta", risposta, MaxRispostaL, NULL);
             if (lr2 == -2) { free(t); liberaTemi(temi); liberaCompletati(stor); return 1; }
 
             // comandi inline
             if (!strcmp(risposta, ShowScore)) {
-                if (riceviClassifiche(sd, nTemi, buf) < 0) { free(t); liberaTemi(temi); liberaCompletati(stor); return 1; }
+                if (inviaVuoto(sd, FR_CLASSIFICA) < 0 || riceviClassifiche(sd) < 0) {
+                    free(t); liberaTemi(temi); liberaCompletati(stor); return 1;
+                }
+                nuovaDomanda = 0;
                 q--; // ripeti stessa domanda
                 continue;
             }
             if (!strcmp(risposta, EndQuiz)) {
-                // Torna al menu: il server chiude la sessione (é indicato come risposta)
+                // Torna al menu: il server chiude la sessione
+                inviaVuoto(sd, FR_FINE);
                 free(t); liberaTemi(temi); liberaCompletati(stor);
                 return 0;
             }
 
-            // invio risposta in buffer AZZERATO (evita scorie)
-            char tosend[MaxReadL] = {0};
-            strncpy(tosend, risposta, MaxReadL-1);
-            if (send(sd, tosend, MaxReadL, MSG_NOSIGNAL) < 0) {
+            // invio risposta (lunghezza esatta, niente padding)
+            protoFrameStringa(&g_tx, FR_RISPOSTA, risposta, strlen(risposta));
+            if (inviaFrame(sd) < 0) {
                 perror("send risposta"); free(t); liberaTemi(temi); liberaCompletati(stor); return 1;
             }
 
             // ricevo esito (0=corretta, 1=errata)
-            ret = recv(sd, &net, sizeof(net), MSG_WAITALL);
-            ret = RecErr(ret, sizeof(net));
-            if (ret){ if (ret<0) perror("recv esito"); serverSpento_print(); free(t); liberaTemi(temi); liberaCompletati(stor); return 1; }
-            int esito = ntohs(net);
+            if (attendiFrame(sd, FR_ESITO, &r, "esito")) { free(t); liberaTemi(temi); liberaCompletati(stor); return 1; }
+            int esito = (int)protoLeggiNumero(&r);
 
             printf("Esito: ");
             if (esito == 0) { printf(COL_OK  "CORRETTA" COL_RST "\n"); corrette++; }
@@ -441,10 +882,426 @@ static int sessioneQuiz(int sd){
     }
 }
 
+// ---------------------------- Modalità bot (generatore di carico) -------------
+// ./client 4242 -b <connessioni> [...]: nessuna interfaccia, ogni bot è un
+// thread che ripete sessioni complete sullo stesso protocollo di sessioneQuiz
+// (saluto v2, login, scelta temi, risposte, "Mostra Punteggio" casuali).
+// Le risposte giuste si ricavano dai file di qa/ (server sulla stessa macchina):
+// ogni risposta è corretta con probabilità BotCfg.quotaCorrette.
+// Ogni passo del protocollo è cronometrato dall'invio della richiesta alla
+// ricezione della risposta completa; le latenze finiscono in istogrammi
+// log-lineari per thread (stile HDR: 32 sotto-intervalli per potenza di 2,
+// errore relativo < 3%), fusi alla fine per p50/p99/p999.
+// -----------------------------------------------------------------------------
+#define ISTO_SUB     32                 // sotto-intervalli per ottava
+#define ISTO_OTTAVE  40                 // fino a 2^40 ns (~18 minuti)
+#define ISTO_DIM     (ISTO_OTTAVE * ISTO_SUB)
+
+enum PassoBot {
+    PASSO_CONNESSIONE,                  // connect() -> numero temi
+    PASSO_SALUTO,                       // saluto v2 -> FR_BENVENUTO
+    PASSO_LOGIN,                        // FR_LOGIN  -> esito + elenco temi
+    PASSO_TEMA,                         // FR_TEMA   -> prima domanda
+    PASSO_RISPOSTA,                     // FR_RISPOSTA -> esito (+ domanda successiva)
+    PASSO_CLASSIFICA,                   // FR_CLASSIFICA -> FR_CLASSIFICHE
+    NUM_PASSI
+};
+
+static const char* nomiPassi[NUM_PASSI] = {
+    "connessione", "saluto", "login", "tema", "risposta", "classifica"
+};
+
+struct Istogramma {
+    uint32_t conta[ISTO_DIM];
+    uint64_t totale;
+    uint64_t max;
+};
+
+struct BotCfg {
+    int         connessioni;            // bot (thread) concorrenti
+    int         durata;                 // secondi di prova
+    long        sessioni;               // sessioni per bot (0 = fino a fine durata)
+    int         temiPerSessione;        // 0 = tutti
+    double      quotaCorrette;          // probabilità di risposta giusta
+    double      probClassifica;         // probabilità di "Mostra Punteggio" per passo
+    const char* cartellaQA;
+};
+
+// Stato di un bot: buffer v2 propri (niente globali condivise) e statistiche locali
+struct Bot {
+    int               id;
+    pthread_t         tid;
+    uint64_t          rng;
+    struct ProtoBuf   tx, rx;
+    struct Istogramma passi[NUM_PASSI];
+    uint64_t          sessioniOk, errori, risposteGiuste, risposte;
+    uint64_t          inCoda, rifiutate;            // FR_OCCUPATO: attese e rifiuti a coda piena
+};
+
+// Risposte note: tabella hash (indirizzamento aperto) domanda -> risposta
+struct VoceRisposta { char* domanda; char* risposta; };
+
+static struct BotCfg        g_bot;
+static struct VoceRisposta* g_risposte = NULL;
+static size_t               g_risposteMaschera = 0;
+static atomic_int           g_botStop = 0;
+static struct sockaddr_in   g_srv;
+
+static uint64_t adessoNs(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void istoRegistra(struct Istogramma* h, uint64_t ns){
+    if (ns < ISTO_SUB) ns = ISTO_SUB;
+    int ott = 63 - __builtin_clzll(ns);                         // >= log2(ISTO_SUB)
+    size_t idx;
+    if (ott >= ISTO_OTTAVE) idx = ISTO_DIM - 1;
+    else idx = (size_t)ott * ISTO_SUB + (size_t)((ns >> (ott - 5)) & (ISTO_SUB - 1));
+    h->conta[idx]++;
+    h->totale++;
+    if (ns > h->max) h->max = ns;
+}
+
+// Valore (limite superiore del sotto-intervallo) al percentile q
+static uint64_t istoPercentile(const struct Istogramma* h, double q){
+    if (!h->totale) return 0;
+    uint64_t soglia = (uint64_t)(q * (double)h->totale);
+    if (soglia >= h->totale) soglia = h->totale - 1;
+    uint64_t visti = 0;
+    for (size_t i = 0; i < ISTO_DIM; i++) {
+        visti += h->conta[i];
+        if (visti > soglia) {
+            size_t ott = i / ISTO_SUB, sub = i % ISTO_SUB;
+            uint64_t sup = ((uint64_t)(ISTO_SUB + sub + 1)) << (ott - 5);
+            return sup < h->max ? sup : h->max;
+        }
+    }
+    return h->max;
+}
+
+static uint64_t botCasuale(struct Bot* b){
+    uint64_t z = (b->rng += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static double botUniforme(struct Bot* b){
+    return (double)(botCasuale(b) >> 11) / 9007199254740992.0;     // [0, 1)
+}
+
+static uint32_t hashTesto(const char* s){
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)s; *p; p++) { h ^= *p; h *= 16777619u; }
+    return h;
+}
+
+static const char* rispostaNota(const char* domanda){
+    if (!g_risposte) return NULL;
+    for (size_t i = hashTesto(domanda) & g_risposteMaschera; g_risposte[i].domanda; i = (i + 1) & g_risposteMaschera)
+        if (strcmp(g_risposte[i].domanda, domanda) == 0) return g_risposte[i].risposta;
+    return NULL;
+}
+
+static void aggiungiRisposta(const char* domanda, const char* risposta, size_t* num){
+    if ((*num + 1) * 2 > g_risposteMaschera + 1) {               // carico massimo 1/2
+        size_t dim = g_risposte ? (g_risposteMaschera + 1) * 2 : 1024;
+        struct VoceRisposta* nuova = (struct VoceRisposta*)calloc(dim, sizeof(*nuova));
+        if (!nuova) return;
+        for (size_t i = 0; g_risposte && i <= g_risposteMaschera; i++) {
+            if (!g_risposte[i].domanda) continue;
+            size_t k = hashTesto(g_risposte[i].domanda) & (dim - 1);
+            while (nuova[k].domanda) k = (k + 1) & (dim - 1);
+            nuova[k] = g_risposte[i];
+        }
+        free(g_risposte);
+        g_risposte = nuova;
+        g_risposteMaschera = dim - 1;
+    }
+    size_t k = hashTesto(domanda) & g_risposteMaschera;
+    while (g_risposte[k].domanda) {
+        if (strcmp(g_risposte[k].domanda, domanda) == 0) return;   // duplicata
+        k = (k + 1) & g_risposteMaschera;
+    }
+    g_risposte[k].domanda  = strdup(domanda);
+    g_risposte[k].risposta = strdup(risposta);
+    (*num)++;
+}
+
+// Carica le coppie domanda/risposta di tutti i .txt della cartella
+// (stesso formato letto dal server: righe alterne, soglia " ~N" opzionale)
+static size_t caricaRisposte(const char* cartella){
+    DIR* dir = opendir(cartella);
+    if (!dir) return 0;
+    size_t num = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir))) {
+        size_t L = strlen(ent->d_name);
+        if (L < 4 || strcmp(ent->d_name + L - 4, ".txt") != 0) continue;
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", cartella, ent->d_name);
+        FILE* f = fopen(path, "r");
+        if (!f) continue;
+        char* righe[2] = { NULL, NULL };
+        size_t cap[2] = { 0, 0 };
+        int k = 0;
+        while (getline(&righe[k], &cap[k], f) >= 0) {
+            trim(righe[k]);
+            if (!righe[k][0]) continue;
+            if (k == 1) {
+                size_t n = strlen(righe[1]);
+                if (n >= 3 && righe[1][n-3] == ' ' && righe[1][n-2] == '~' && isdigit((unsigned char)righe[1][n-1])) {
+                    righe[1][n-3] = '\0';
+                    trim(righe[1]);
+                }
+                aggiungiRisposta(righe[0], righe[1], &num);
+            }
+            k ^= 1;
+        }
+        free(righe[0]); free(righe[1]);
+        fclose(f);
+    }
+    closedir(dir);
+    return num;
+}
+
+// Invia il frame in b->tx e attende il tipo atteso, cronometrando il passo
+static int botPasso(struct Bot* b, int sd, enum PassoBot passo, uint8_t atteso, struct ProtoLettore* r){
+    uint64_t t0 = adessoNs();
+    if (inviaFrameDa(sd, &b->tx) < 0) return -1;
+    uint8_t tipo;
+    if (riceviFrameIn(sd, &b->rx, &tipo, r) != 0 || tipo != atteso) return -1;
+    istoRegistra(&b->passi[passo], adessoNs() - t0);
+    return 0;
+}
+
+static int botClassifica(struct Bot* b, int sd){
+    struct ProtoLettore r;
+    protoFrameVuoto(&b->tx, FR_CLASSIFICA);
+    return botPasso(b, sd, PASSO_CLASSIFICA, FR_CLASSIFICHE, &r);
+}
+
+// Gioca i temi della sessione (login già accettato): 0 ok, -1 errore
+static int botGioca(struct Bot* b, int sd, int nTemi){
+    struct ProtoLettore r;
+    uint8_t tipo;
+
+    // temi in ordine casuale (Fisher-Yates), ognuno giocato al massimo una volta
+    int ordine[nTemi];
+    for (int i = 0; i < nTemi; i++) ordine[i] = i;
+    for (int i = nTemi - 1; i > 0; i--) {
+        int j = (int)(botCasuale(b) % (uint64_t)(i + 1));
+        int x = ordine[i]; ordine[i] = ordine[j]; ordine[j] = x;
+    }
+    int giocati = (g_bot.temiPerSessione > 0 && g_bot.temiPerSessione < nTemi) ? g_bot.temiPerSessione : nTemi;
+
+    char domanda[1024];
+    for (int t = 0; t < giocati; t++) {
+        if (botUniforme(b) < g_bot.probClassifica && botClassifica(b, sd)) return -1;
+
+        protoFrameNumero(&b->tx, FR_TEMA, (uint64_t)ordine[t]);
+        if (botPasso(b, sd, PASSO_TEMA, FR_DOMANDA, &r)) return -1;
+        for (int q = 0; q < NumQuest; q++) {
+            const char* d;
+            size_t len = protoLeggiStringa(&r, &d);
+            if (len >= sizeof(domanda)) len = sizeof(domanda) - 1;
+            memcpy(domanda, d, len); domanda[len] = '\0';
+
+            if (botUniforme(b) < g_bot.probClassifica && botClassifica(b, sd)) return -1;
+
+            const char* giusta = rispostaNota(domanda);
+            int vuoleGiusta = botUniforme(b) < g_bot.quotaCorrette;
+            const char* risp = (vuoleGiusta && giusta) ? giusta : "risposta sbagliata";
+            protoFrameStringa(&b->tx, FR_RISPOSTA, risp, strlen(risp));
+
+            // il passo comprende la domanda successiva, che arriva nello stesso invio
+            uint64_t t1 = adessoNs();
+            if (inviaFrameDa(sd, &b->tx) < 0) return -1;
+            if (riceviFrameIn(sd, &b->rx, &tipo, &r) != 0 || tipo != FR_ESITO) return -1;
+            b->risposte++;
+            if (protoLeggiNumero(&r) == 0) b->risposteGiuste++;
+            if (q + 1 < NumQuest &&
+                (riceviFrameIn(sd, &b->rx, &tipo, &r) != 0 || tipo != FR_DOMANDA)) return -1;
+            istoRegistra(&b->passi[PASSO_RISPOSTA], adessoNs() - t1);
+        }
+    }
+
+    return 0;
+}
+
+// Una sessione completa su una nuova connessione: 0 ok, 1 rifiutata (coda piena), -1 errore
+static int botSessione(struct Bot* b, unsigned long progressivo){
+    struct ProtoLettore r;
+    uint8_t tipo;
+    int esito = -1;
+
+    uint64_t t0 = adessoNs();
+    int sd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sd < 0) return -1;
+    if (connect(sd, (struct sockaddr*)&g_srv, sizeof(g_srv)) < 0) { close(sd); return -1; }
+    uint16_t net;
+    while (1) {                                             // la connessione include l'attesa in coda
+        if (RecErr(recv(sd, &net, sizeof(net), MSG_WAITALL), sizeof(net))) goto fine;
+        if (ntohs(net) != PROTO_OCCUPATO) break;
+        if (riceviFrameIn(sd, &b->rx, &tipo, &r) != 0 || tipo != FR_OCCUPATO) goto fine;
+        if (protoLeggiNumero(&r) == 0) { b->rifiutate++; esito = 1; goto fine; }
+        b->inCoda++;
+    }
+    istoRegistra(&b->passi[PASSO_CONNESSIONE], adessoNs() - t0);
+
+    // saluto v2: frame di login da 16 byte (non è un frame v2, si accoda a mano)
+    char saluto[MaxUsernameL] = {0};
+    memcpy(saluto, PROTO_SALUTO, 3);
+    saluto[3] = PROTO_V2;
+    if (protoRiserva(&b->tx, MaxUsernameL) < 0) goto fine;
+    memcpy(b->tx.dati, saluto, MaxUsernameL);
+    b->tx.len = MaxUsernameL;
+    if (botPasso(b, sd, PASSO_SALUTO, FR_BENVENUTO, &r)) goto fine;
+
+    // login: il nick include id del bot e progressivo (univoco tra i bot)
+    char nick[MaxUsernameL];
+    snprintf(nick, sizeof(nick), "bot%d_%lu", b->id, progressivo % 1000000);
+    protoFrameStringa(&b->tx, FR_LOGIN, nick, strlen(nick));
+    if (botPasso(b, sd, PASSO_LOGIN, FR_ESITO_LOGIN, &r) || protoLeggiNumero(&r) != 1) goto fine;
+    if (riceviFrameIn(sd, &b->rx, &tipo, &r) != 0 || tipo != FR_TEMI) goto fine;
+    int nTemi = (int)protoLeggiNumero(&r);
+    if (r.errore || nTemi <= 0) goto fine;
+
+    if (botGioca(b, sd, nTemi)) goto fine;
+
+    protoFrameVuoto(&b->tx, FR_FINE);
+    inviaFrameDa(sd, &b->tx);
+    esito = 0;
+fine:
+    b->tx.len = 0; b->tx.errore = 0;
+    close(sd);
+    return esito;
+}
+
+static void* threadBot(void* arg){
+    struct Bot* b = (struct Bot*)arg;
+    for (unsigned long k = 0; !atomic_load(&g_botStop); k++) {
+        if (g_bot.sessioni && (long)k >= g_bot.sessioni) break;
+        int esito = botSessione(b, k);
+        if (esito == 0) b->sessioniOk++;
+        else if (esito < 0) b->errori++;
+        if (esito != 0) usleep(10 * 1000);                  // server pieno/spento: non martellare
+    }
+    return NULL;
+}
+
+static void stampaRisultatiBot(struct Bot* bot, int n, double secondiTot){
+    static struct Istogramma tot[NUM_PASSI];
+    uint64_t sessioni = 0, errori = 0, giuste = 0, risposte = 0, inCoda = 0, rifiutate = 0;
+    for (int i = 0; i < n; i++) {
+        sessioni += bot[i].sessioniOk;
+        inCoda    += bot[i].inCoda;
+        rifiutate += bot[i].rifiutate;
+        errori   += bot[i].errori;
+        giuste   += bot[i].risposteGiuste;
+        risposte += bot[i].risposte;
+        for (int p = 0; p < NUM_PASSI; p++) {
+            for (size_t k = 0; k < ISTO_DIM; k++) tot[p].conta[k] += bot[i].passi[p].conta[k];
+            tot[p].totale += bot[i].passi[p].totale;
+            if (bot[i].passi[p].max > tot[p].max) tot[p].max = bot[i].passi[p].max;
+        }
+    }
+
+    titolo("Risultati generatore di carico");
+    riga();
+    printf("bot: %d   durata: %.2f s\n", n, secondiTot);
+    printf("sessioni completate: %llu (%.1f/s)   errori: %llu\n",
+           (unsigned long long)sessioni, (double)sessioni / secondiTot, (unsigned long long)errori);
+    printf("risposte: %llu (%.1f/s), corrette %.1f%%\n",
+           (unsigned long long)risposte, (double)risposte / secondiTot,
+           risposte ? 100.0 * (double)giuste / (double)risposte : 0.0);
+    if (inCoda || rifiutate)
+        printf("server occupato: %llu connessioni passate dalla coda, %llu rifiutate a coda piena\n",
+               (unsigned long long)inCoda, (unsigned long long)rifiutate);
+    riga();
+    printf("%-12s %10s %10s %10s %10s %10s %10s\n", "passo (us)", "conteggio", "al sec", "p50", "p99", "p999", "max");
+    for (int p = 0; p < NUM_PASSI; p++) {
+        printf("%-12s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", nomiPassi[p],
+               (unsigned long long)tot[p].totale, (double)tot[p].totale / secondiTot,
+               istoPercentile(&tot[p], 0.50)  / 1e3, istoPercentile(&tot[p], 0.99) / 1e3,
+               istoPercentile(&tot[p], 0.999) / 1e3, tot[p].max / 1e3);
+    }
+    riga();
+}
+
+static int avviaBot(void){
+    size_t note = caricaRisposte(g_bot.cartellaQA);
+    if (!note) fprintf(stderr, "[bot] nessuna risposta nota in '%s': tutte le risposte saranno errate\n", g_bot.cartellaQA);
+
+    struct Bot* bot = (struct Bot*)calloc(g_bot.connessioni, sizeof(*bot));
+    if (!bot) { perror("calloc"); return -1; }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);           // molti bot: stack piccoli
+
+    printf("[bot] %d connessioni, %s, %zu risposte note, quota corrette %.2f\n",
+           g_bot.connessioni, g_bot.sessioni ? "sessioni a numero fisso" : "a tempo", note, g_bot.quotaCorrette);
+    fflush(stdout);
+
+    uint64_t t0 = adessoNs();
+    int avviati = 0;
+    for (; avviati < g_bot.connessioni; avviati++) {
+        bot[avviati].id  = avviati;
+        bot[avviati].rng = t0 ^ ((uint64_t)avviati << 40) ^ (uint64_t)getpid();
+        if (pthread_create(&bot[avviati].tid, &attr, threadBot, &bot[avviati]) != 0) {
+            perror("pthread_create");
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    if (!g_bot.sessioni) {
+        sleep((unsigned int)g_bot.durata);
+        atomic_store(&g_botStop, 1);
+    }
+    for (int i = 0; i < avviati; i++) pthread_join(bot[i].tid, NULL);
+
+    stampaRisultatiBot(bot, avviati, (double)(adessoNs() - t0) / 1e9);
+    for (int i = 0; i < avviati; i++) { free(bot[i].tx.dati); free(bot[i].rx.dati); }
+    free(bot);
+    return 0;
+}
+
 // ---------------------------- main --------------------------------------------
+// Uso: ./client <porta> [-b connessioni [-t secondi] [-n sessioni] [-T temi]
+//                        [-r quota_corrette] [-s prob_classifica] [-q cartella]]
+//   senza -b il client è interattivo; con -b parte il generatore di carico:
+//   -t  durata della prova (default 10 s), ignorata se c'è -n
+//   -n  sessioni per bot, poi il bot termina
+//   -T  temi giocati per sessione (default tutti)
+//   -r  probabilità di rispondere correttamente (default 0.7)
+//   -s  probabilità di "Mostra Punteggio" prima di ogni tema/domanda (default 0.05)
+//   -q  cartella con i .txt da cui ricavare le risposte (default qa)
 int main(int argc, char* argv[]){
-    if (argc != 2) { printf("Uso: %s <porta>\n", argv[0]); return -1; }
-    int porta = atoi(argv[1]);
+    g_bot = (struct BotCfg){ .durata = 10, .quotaCorrette = 0.7, .probClassifica = 0.05, .cartellaQA = "qa" };
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:n:T:r:s:q:")) != -1) {
+        switch (opt) {
+        case 'b': g_bot.connessioni     = atoi(optarg); break;
+        case 't': g_bot.durata          = atoi(optarg); break;
+        case 'n': g_bot.sessioni        = atol(optarg); break;
+        case 'T': g_bot.temiPerSessione = atoi(optarg); break;
+        case 'r': g_bot.quotaCorrette   = atof(optarg); break;
+        case 's': g_bot.probClassifica  = atof(optarg); break;
+        case 'q': g_bot.cartellaQA      = optarg; break;
+        default:  optind = argc + 1; break;
+        }
+    }
+    if (optind != argc - 1) {
+        printf("Uso: %s <porta> [-b connessioni [-t secondi] [-n sessioni] [-T temi] "
+               "[-r quota_corrette] [-s prob_classifica] [-q cartella]]\n", argv[0]);
+        return -1;
+    }
+    int porta = atoi(argv[optind]);
     if (porta != 4242) {
         printf("Porta non valida (Usa 4242)\n"); return -1;
     }
@@ -453,6 +1310,12 @@ int main(int argc, char* argv[]){
     srv.sin_family = AF_INET; srv.sin_port = htons(porta);
     inet_pton(AF_INET, IPADDR, &srv.sin_addr);
 
+    if (g_bot.connessioni > 0) {
+        if (g_bot.durata <= 0) g_bot.durata = 10;
+        g_srv = srv;
+        return avviaBot() < 0 ? -1 : 0;
+    }
+
     // Loop menu principale
     while (1) {
         menuPrincipale();
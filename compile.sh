@@ -3,8 +3,26 @@
 clear
 gcc -g -Wall -pthread -o server server.c 
 gcc -g -Wall -pthread -o client client.c
+gcc -O2 -Wall -o bench_normalizza bench_normalizza.c
+gcc -O2 -Wall -pthread -o bench_classifica bench_classifica.c
 
 # ./compile.sh -> fare la roba contenuta in questo file
 
-# ./server -> per avviare il server
-# ./client seguito dal numero di porta -> per avviare i client
\ No newline at end of file
+# ./server -> per avviare il server (modalità reactor: un loop epoll per core)
+# ./server -m thread -> modalità classica a 8 thread, per confronto
+# ./server -m uring -> loop reactor con I/O su io_uring (kernel >= 6.0, altrimenti torna a epoll)
+# ./server -l <loop> -c <max sessioni> -> parametri della modalità reactor
+# ./server -f -> accetta risposte con piccoli errori di battitura ("Incepton")
+# ./server -p <cartella> -> classifiche persistenti (log + snapshot nella cartella)
+# ./server -s /tmp/quiz.sock -> statistiche di latenza su socket Unix (testo, o JSON inviando "json")
+# ./server -q <posti> -> connessioni in coda oltre la capienza (risposta "server occupato" con posizione e attesa stimata)
+# ./server -C qa.pack -> compila qa/ in un pacchetto binario ed esce
+# ./server -P qa.pack -> serve temi e domande dal pacchetto (mappato, avvio senza parsing); ricompilarlo lo ricarica a caldo
+# ./server -t 60:180:600 -> scadenze in secondi per login, risposta e inattività al menu (0 = nessuna)
+# (server avviato) 'R' + Invio -> riavvio a caldo con il binario ricompilato, senza perdere le partite
+# ./client seguito dal numero di porta -> per avviare i client
+# (client, scelta del tema) "Classifica Live" -> classifiche aggiornate in tempo reale (modalità reactor)
+# (client, scelta del tema) "Stanza <n>" -> partita dal vivo con gli altri giocatori nella stanza del tema n (modalità reactor)
+# ./client 4242 -b <connessioni> [-t secondi] [-r quota_corrette] -> generatore di carico (bot)
+# ./bench_normalizza -> confronto di velocità tra i normalizzatori delle risposte
+# ./bench_classifica [-r righe] [-w scrittori] [-l lettori] [-b bloccati] -> (server avviato, meglio con -p) sessioni/s degli scrittori con e senza client che chiedono le classifiche
\ No newline at end of file
@@ -0,0 +1,139 @@
+// de Dato A.
+
+#pragma once //Evito di includere più volte il file
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>  // SSE2: sempre presente su x86-64, niente scelta a runtime
+#endif
+
+// ============================================================================
+// normalizza
+// ----------------------------------------------------------------------------
+// Confronto più tollerante per le risposte.
+// - Converte in minuscolo e conserva solo [a-z0-9].
+// - Ignora TUTTI i whitespace, la punteggiatura e i simboli.
+// - Lettere latine accentate (UTF-8, U+00C0..U+017F) ridotte alla lettera
+//   base: "perché" -> "perche", "città" -> "citta", "ß" -> "ss".
+// - Apostrofi tipografici (’ ‘ ʼ) e ogni altro carattere fuori tabella
+//   vengono scartati come l'apostrofo ASCII: "l’isola" == "l'isola".
+// - Byte UTF-8 non validi: scartati uno alla volta.
+// Fast path SSE2 per i tratti ASCII: 16 byte classificati per istruzione.
+// Può lavorare sul posto (out == in): non scrive mai oltre il byte letto.
+// ============================================================================
+
+// Byte ASCII -> carattere normalizzato (0 = scartato)
+static const char piegaAscii[128] = {
+    /* 00 */ 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  ,
+    /* 10 */ 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  ,
+    /* 20 */ 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  , 0  ,
+    /* 30 */ '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0  , 0  , 0  , 0  , 0  , 0  ,
+    /* 40 */ 0  , 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    /* 50 */ 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0  , 0  , 0  , 0  , 0  ,
+    /* 60 */ 0  , 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    /* 70 */ 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0  , 0  , 0  , 0  , 0  ,
+};
+
+// Code point U+00C0..U+017F -> fino a due lettere ASCII ("" = scartato)
+static const char piegaLatino[0x180 - 0xC0][2] = {
+    /* 00C0 ÀÁÂÃÄÅÆÇ */ "a" , "a" , "a" , "a" , "a" , "a" , "ae", "c" ,
+    /* 00C8 ÈÉÊËÌÍÎÏ */ "e" , "e" , "e" , "e" , "i" , "i" , "i" , "i" ,
+    /* 00D0 ÐÑÒÓÔÕÖx */ "d" , "n" , "o" , "o" , "o" , "o" , "o" , ""  ,
+    /* 00D8 ØÙÚÛÜÝÞß */ "o" , "u" , "u" , "u" , "u" , "y" , "th", "ss",
+    /* 00E0 àáâãäåæç */ "a" , "a" , "a" , "a" , "a" , "a" , "ae", "c" ,
+    /* 00E8 èéêëìíîï */ "e" , "e" , "e" , "e" , "i" , "i" , "i" , "i" ,
+    /* 00F0 ðñòóôõö/ */ "d" , "n" , "o" , "o" , "o" , "o" , "o" , ""  ,
+    /* 00F8 øùúûüýþÿ */ "o" , "u" , "u" , "u" , "u" , "y" , "th", "y" ,
+    /* 0100 ĀāĂăĄąĆć */ "a" , "a" , "a" , "a" , "a" , "a" , "c" , "c" ,
+    /* 0108 ĈĉĊċČčĎď */ "c" , "c" , "c" , "c" , "c" , "c" , "d" , "d" ,
+    /* 0110 ĐđĒēĔĕĖė */ "d" , "d" , "e" , "e" , "e" , "e" , "e" , "e" ,
+    /* 0118 ĘęĚěĜĝĞğ */ "e" , "e" , "e" , "e" , "g" , "g" , "g" , "g" ,
+    /* 0120 ĠġĢģĤĥĦħ */ "g" , "g" , "g" , "g" , "h" , "h" , "h" , "h" ,
+    /* 0128 ĨĩĪīĬĭĮį */ "i" , "i" , "i" , "i" , "i" , "i" , "i" , "i" ,
+    /* 0130 İıĲĳĴĵĶķ */ "i" , "i" , "ij", "ij", "j" , "j" , "k" , "k" ,
+    /* 0138 ĸĹĺĻļĽľĿ */ "k" , "l" , "l" , "l" , "l" , "l" , "l" , "l" ,
+    /* 0140 ŀŁłŃńŅņŇ */ "l" , "l" , "l" , "n" , "n" , "n" , "n" , "n" ,
+    /* 0148 ňŉŊŋŌōŎŏ */ "n" , "n" , "n" , "n" , "o" , "o" , "o" , "o" ,
+    /* 0150 ŐőŒœŔŕŖŗ */ "o" , "o" , "oe", "oe", "r" , "r" , "r" , "r" ,
+    /* 0158 ŘřŚśŜŝŞş */ "r" , "r" , "s" , "s" , "s" , "s" , "s" , "s" ,
+    /* 0160 ŠšŢţŤťŦŧ */ "s" , "s" , "t" , "t" , "t" , "t" , "t" , "t" ,
+    /* 0168 ŨũŪūŬŭŮů */ "u" , "u" , "u" , "u" , "u" , "u" , "u" , "u" ,
+    /* 0170 ŰűŲųŴŵŶŷ */ "u" , "u" , "u" , "u" , "w" , "w" , "y" , "y" ,
+    /* 0178 ŸŹźŻżŽžſ */ "y" , "z" , "z" , "z" , "z" , "z" , "z" , "s" ,
+};
+
+// Passo scalare: consuma il carattere (o la sequenza UTF-8) in p[i]
+static inline size_t normalizzaPasso(const unsigned char* p, size_t i, size_t len,
+                                     char* out, size_t* k, size_t cap){
+    unsigned char c = p[i];
+    if (c < 0x80) {
+        char r = piegaAscii[c];
+        if (r && *k + 1 < cap) out[(*k)++] = r;
+        return i + 1;
+    }
+    if ((c & 0xE0) == 0xC0 && i + 1 < len && (p[i+1] & 0xC0) == 0x80) {
+        unsigned int cp = ((c & 0x1Fu) << 6) | (p[i+1] & 0x3Fu);
+        if (cp >= 0xC0 && cp < 0x180) {
+            const char* f = piegaLatino[cp - 0xC0];
+            for (int j = 0; j < 2 && f[j]; j++)
+                if (*k + 1 < cap) out[(*k)++] = f[j];
+        }
+        return i + 2;
+    }
+    i++;
+    if (c >= 0xC0)                                  // sequenza di 3-4 byte: la salto intera
+        while (i < len && (p[i] & 0xC0) == 0x80) i++;
+    return i;
+}
+
+// Versione solo tabellare (riferimento per il fast path e per il benchmark)
+void normalizzaScalare(const char* in, char* out, size_t cap){
+    const unsigned char* p = (const unsigned char*)in;
+    size_t len = strlen(in), k = 0;
+    for (size_t i = 0; i < len; ) i = normalizzaPasso(p, i, len, out, &k, cap);
+    out[k] = '\0';
+}
+
+void normalizza(const char* in, char* out, size_t cap){
+#ifdef __SSE2__
+    const unsigned char* p = (const unsigned char*)in;
+    size_t len = strlen(in), k = 0, i = 0;
+
+    const __m128i bit20 = _mm_set1_epi8(0x20);
+    const __m128i primaA = _mm_set1_epi8('a' - 1), dopoZ = _mm_set1_epi8('z' + 1);
+    const __m128i prima0 = _mm_set1_epi8('0' - 1), dopo9 = _mm_set1_epi8('9' + 1);
+
+    while (i + 16 <= len && k + 16 < cap) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        unsigned int alto = (unsigned int)_mm_movemask_epi8(v);   // byte non ASCII
+        unsigned int ascii = alto ? (unsigned int)__builtin_ctz(alto) : 16;
+
+        // 'A'..'Z' | 0x20 = 'a'..'z' e le cifre hanno già il bit: basta un OR
+        __m128i basso   = _mm_or_si128(v, bit20);
+        __m128i lettera = _mm_and_si128(_mm_cmpgt_epi8(basso, primaA), _mm_cmplt_epi8(basso, dopoZ));
+        __m128i cifra   = _mm_and_si128(_mm_cmpgt_epi8(v, prima0),     _mm_cmplt_epi8(v, dopo9));
+        unsigned int tieni = (unsigned int)_mm_movemask_epi8(_mm_or_si128(lettera, cifra));
+        tieni &= (1u << ascii) - 1;
+
+        if (tieni == 0xFFFF) {
+            _mm_storeu_si128((__m128i*)(out + k), basso);           // blocco tutto alfanumerico
+            k += 16;
+        } else {
+            char tmp[16];
+            _mm_storeu_si128((__m128i*)tmp, basso);
+            while (tieni) {                                         // compattazione dei tenuti
+                out[k++] = tmp[__builtin_ctz(tieni)];
+                tieni &= tieni - 1;
+            }
+        }
+        i += ascii;
+        if (alto) i = normalizzaPasso(p, i, len, out, &k, cap);     // sequenza UTF-8
+    }
+    while (i < len) i = normalizzaPasso(p, i, len, out, &k, cap);
+    out[k] = '\0';
+#else
+    normalizzaScalare(in, out, cap);
+#endif
+}
@@ -0,0 +1,233 @@
+// de Dato A.
+
+#pragma once //Evito di includere più volte il file
+
+#include "utility.h"
+
+// ============================================================================
+// Protocollo v2: frame tipizzati a lunghezza variabile
+// ----------------------------------------------------------------------------
+// Negoziazione: il server invia sempre per primo il numero di temi (uint16_t,
+// come in v1). Un client v2 risponde con un frame di login da 16 byte che in
+// v1 non può esistere (primo byte 0 = nick vuoto): PROTO_SALUTO seguito dalla
+// versione richiesta. Il server che la conosce risponde FR_BENVENUTO e da quel
+// momento, in entrambe le direzioni, viaggiano solo frame v2.
+// I client v1 non inviano mai il saluto e restano sul formato a larghezza fissa.
+//
+// Frame:   tipo (1 byte) | lunghezza payload (varint) | payload
+// Numeri:  varint senza segno (LEB128: 7 bit per byte, bit alto = continua)
+// Stringhe: lunghezza (varint) + byte, senza terminatore
+// ============================================================================
+
+#define PROTO_V2            2
+#define PROTO_SALUTO        "\0QZ"      // primi 3 byte del frame di negoziazione
+#define PROTO_MAX_INTEST    11          // tipo + varint a 64 bit
+#define PROTO_MAX_RICHIESTA 512         // payload massimo client -> server
+#define PROTO_OCCUPATO      0xFFFF      // preambolo "server occupato" (al posto del numero di temi)
+#define MaxRispostaL        256         // risposta massima accettata dal client v2
+
+// Tipi di frame
+enum TipoFrame {
+    // client -> server
+    FR_LOGIN           = 0x01,  // stringa: nickname
+    FR_CLASSIFICA      = 0x02,  // (vuoto): richiesta classifiche
+    FR_FINE            = 0x03,  // (vuoto): fine sessione
+    FR_TEMA            = 0x04,  // numero: indice del tema (da 0)
+    FR_RISPOSTA        = 0x05,  // stringa: risposta alla domanda corrente
+    FR_ISCRIVI         = 0x06,  // numero: 1 = classifiche in diretta, 0 = basta
+    FR_STANZA          = 0x07,  // numero: indice del tema, entra nella sua stanza
+    FR_ESCI_STANZA     = 0x08,  // (vuoto): lascia la stanza (ignorato fuori da una stanza)
+
+    // server -> client
+    FR_BENVENUTO       = 0x81,  // numero: versione accettata
+    FR_ESITO_LOGIN     = 0x82,  // numero: 1 = accettato, 0 = nick non valido/in uso
+    FR_TEMI            = 0x83,  // numero n, poi n stringhe
+    FR_DOMANDA         = 0x84,  // stringa
+    FR_ESITO           = 0x85,  // numero: 0 = corretta, 1 = errata
+                                //   (in stanza anche 2 = non accettata: fuori tempo o ripetuta)
+    FR_CLASSIFICHE     = 0x86,  // numero temi; per tema: stringa, numero righe,
+                                //   righe (stringa nick, numero punteggio)
+    FR_ISCRIZIONE      = 0x87,  // numero: 1 = diretta attiva (segue FR_CLASSIFICHE,
+                                //   la copia locale riparte da lì), 0 = diretta finita
+    FR_DELTA           = 0x88,  // numero tema (indice in FR_CLASSIFICHE), numero n,
+                                //   poi n operazioni OpDelta da applicare in ordine
+    FR_OCCUPATO        = 0x89,  // numero posizione in coda (0 = coda piena, il server
+                                //   chiude), numero attesa stimata in ms (0 = ignota)
+    FR_STANZA_STATO    = 0x8A,  // numero FaseStanza, numero giocatori presenti,
+                                //   numero ms al prossimo passaggio (0 = nessuno)
+    FR_STANZA_DOMANDA  = 0x8B,  // numero turno (da 1), numero ms per rispondere, stringa
+    FR_STANZA_RISULTATI= 0x8C,  // numero turno, stringa risposta giusta, numero risposte
+                                //   giuste, numero risposte date, numero n, n righe
+                                //   (stringa nick, numero punti) in ordine di classifica
+    FR_STANZA_FINE     = 0x8D,  // numero n, n righe come sopra (classifica finale, n = 0
+                                //   se si è lasciata la stanza): la sessione torna ai temi
+};
+
+// Server occupato: prima della negoziazione (quindi per v1 e v2) il server
+// può inviare PROTO_OCCUPATO (uint16_t, nessun catalogo ha 65535 temi)
+// seguito da un frame FR_OCCUPATO. Con posizione > 0 la connessione resta in
+// coda e, appena si libera un posto, arriva il preambolo normale (numero
+// di temi).
+
+// Stanze (v2, modalità reactor): i membri ricevono le stesse domande nello
+// stesso istante. Dopo FR_STANZA il server risponde con FR_STANZA_STATO (e la
+// domanda aperta, se c'è), poi spinge domande, risultati di ogni turno e
+// classifica finale. FR_RISPOSTA vale una volta per turno, finché la domanda
+// è aperta. FR_STANZA_FINE chiude sempre la permanenza nella stanza; in
+// modalità thread arriva subito, vuoto (stanze non disponibili).
+enum FaseStanza {
+    STANZA_IN_ATTESA   = 0,     // si aspettano giocatori (ms: conto alla rovescia)
+    STANZA_IN_DOMANDA  = 1,     // domanda aperta (ms: tempo per rispondere)
+    STANZA_IN_RISULTATI= 2,     // risultati del turno (ms: alla prossima domanda)
+};
+
+// Operazioni di FR_DELTA: le righe si indicano per posizione (1 = prima),
+// valida nella copia locale dopo le operazioni precedenti
+enum OpDelta {
+    DELTA_INSERITO     = 1,     // numero posizione, stringa nick, numero punteggio
+    DELTA_SPOSTATO     = 2,     // numero da, numero a, numero punteggio (nuovo)
+    DELTA_RIMOSSO      = 3,     // numero posizione
+};
+
+// Buffer di scrittura che cresce con realloc (errore = allocazione fallita)
+struct ProtoBuf {
+    uint8_t* dati;
+    size_t   len, cap;
+    size_t   inizio;            // inizio del frame aperto
+    int      errore;
+};
+
+// Lettore del payload di un frame (errore = payload troncato o malformato)
+struct ProtoLettore {
+    const uint8_t* p;
+    size_t         resto;
+    int            errore;
+};
+
+
+// Codifica v in out (al massimo 10 byte), ritorna i byte usati
+size_t protoCodificaNumero(uint8_t* out, uint64_t v){
+    size_t k = 0;
+    while (v >= 0x80) { out[k++] = (uint8_t)(v | 0x80); v >>= 7; }
+    out[k++] = (uint8_t)v;
+    return k;
+}
+
+// Decodifica un varint: byte consumati, 0 se incompleto, -1 se malformato
+int protoDecodificaNumero(const uint8_t* p, size_t len, uint64_t* v){
+    uint64_t x = 0;
+    for (size_t k = 0; k < len && k < 10; k++) {
+        x |= (uint64_t)(p[k] & 0x7F) << (7 * k);
+        if (!(p[k] & 0x80)) { *v = x; return (int)k + 1; }
+    }
+    return len >= 10 ? -1 : 0;
+}
+
+// Lunghezza totale del frame che inizia in p (len byte disponibili):
+// se l'intestazione è incompleta ritorna len+1 (serve almeno un byte in più),
+// 0 se il frame non è valido o supera max byte di payload.
+size_t protoAttesa(const uint8_t* p, size_t len, size_t max){
+    if (len < 2) return 2;
+    uint64_t carico;
+    int k = protoDecodificaNumero(p + 1, len - 1, &carico);
+    if (k == 0) return len + 1;
+    if (k < 0 || carico > max) return 0;
+    return 1 + (size_t)k + (size_t)carico;
+}
+
+int protoRiserva(struct ProtoBuf* b, size_t n){
+    if (b->errore) return -1;
+    if (b->len + n <= b->cap) return 0;
+    size_t cap = b->cap ? b->cap : 256;
+    while (cap < b->len + n) cap *= 2;
+    uint8_t* nuovo = (uint8_t*)realloc(b->dati, cap);
+    if (!nuovo) { b->errore = 1; return -1; }
+    b->dati = nuovo; b->cap = cap;
+    return 0;
+}
+
+void protoNumero(struct ProtoBuf* b, uint64_t v){
+    if (protoRiserva(b, 10) < 0) return;
+    b->len += protoCodificaNumero(b->dati + b->len, v);
+}
+
+void protoStringa(struct ProtoBuf* b, const char* s, size_t len){
+    protoNumero(b, len);
+    if (protoRiserva(b, len) < 0) return;
+    memcpy(b->dati + b->len, s, len);
+    b->len += len;
+}
+
+// Apre un frame in coda al buffer: la lunghezza si scrive alla chiusura
+void protoIniziaFrame(struct ProtoBuf* b, uint8_t tipo){
+    if (protoRiserva(b, PROTO_MAX_INTEST) < 0) return;
+    b->inizio = b->len;
+    b->dati[b->len] = tipo;
+    b->len += PROTO_MAX_INTEST;                 // spazio massimo per la lunghezza
+}
+
+// Scrive la lunghezza del frame aperto e compatta il payload dietro di essa
+void protoChiudiFrame(struct ProtoBuf* b){
+    if (b->errore) return;
+    size_t payload = b->inizio + PROTO_MAX_INTEST;
+    size_t carico  = b->len - payload;
+    size_t k = protoCodificaNumero(b->dati + b->inizio + 1, carico);
+    memmove(b->dati + b->inizio + 1 + k, b->dati + payload, carico);
+    b->len = b->inizio + 1 + k + carico;
+}
+
+// Frame senza payload
+void protoFrameVuoto(struct ProtoBuf* b, uint8_t tipo){
+    protoIniziaFrame(b, tipo);
+    protoChiudiFrame(b);
+}
+
+// Frame con un solo numero
+void protoFrameNumero(struct ProtoBuf* b, uint8_t tipo, uint64_t v){
+    protoIniziaFrame(b, tipo);
+    protoNumero(b, v);
+    protoChiudiFrame(b);
+}
+
+// Frame con una sola stringa
+void protoFrameStringa(struct ProtoBuf* b, uint8_t tipo, const char* s, size_t len){
+    protoIniziaFrame(b, tipo);
+    protoStringa(b, s, len);
+    protoChiudiFrame(b);
+}
+
+// Lettore posizionato sul payload di un frame completo di len byte
+void protoApri(struct ProtoLettore* r, const uint8_t* frame, size_t len){
+    uint64_t carico = 0;
+    int k = protoDecodificaNumero(frame + 1, len - 1, &carico);
+    r->p      = frame + 1 + (k > 0 ? k : 0);
+    r->resto  = (k > 0 && 1 + (size_t)k + carico <= len) ? (size_t)carico : 0;
+    r->errore = (k <= 0);
+}
+
+uint64_t protoLeggiNumero(struct ProtoLettore* r){
+    uint64_t v = 0;
+    int k = protoDecodificaNumero(r->p, r->resto, &v);
+    if (k <= 0) { r->errore = 1; return 0; }
+    r->p += k; r->resto -= (size_t)k;
+    return v;
+}
+
+// Stringa senza copia: *s punta nel payload, ritorna la lunghezza
+size_t protoLeggiStringa(struct ProtoLettore* r, const char** s){
+    uint64_t len = protoLeggiNumero(r);
+    if (r->errore || len > r->resto) { r->errore = 1; *s = ""; return 0; }
+    *s = (const char*)r->p;
+    r->p += len; r->resto -= (size_t)len;
+    return (size_t)len;
+}
+
+// Copia una stringa in out (terminata); -1 se non entra in cap o contiene '\0'
+int protoCopiaStringa(struct ProtoLettore* r, char* out, size_t cap){
+    const char* s;
+    size_t len = protoLeggiStringa(r, &s);
+    if (r->errore || len >= cap || memchr(s, '\0', len)) return -1;
+    memcpy(out, s, len);
+    out[len] = '\0';
+    return (int)len;
+}
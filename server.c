@@ -5,182 +5,1156 @@
 //  - Stampa stato (test disponibili, utenti online con test svolti, classifiche)
 //  - Classifiche ordinate per punteggio e, a parità, per tempo di completamento
 //  - Shutdown controllato da tastiera: premere 'Q' + Invio per spegnere il server
+//  - Ricarica a caldo di qa/ (inotify): le nuove sessioni vedono il nuovo
+//    catalogo, quelle in corso finiscono sul vecchio; classifiche conservate
+//  - Protocollo v1 (frame a larghezza fissa) e v2 (frame tipizzati con
+//    lunghezza e varint, vedi protocollo.h), negoziato alla connessione
+//  - Classifiche persistenti opzionali (flag -p): log append-only dei
+//    risultati con fsync a lotti + snapshot binario periodico
+//  - Istogrammi di latenza e contatori per fase del protocollo, letti a
+//    server attivo da un socket Unix (flag -s), in testo o JSON
+//  - Riavvio a caldo ('R' + Invio, modalità reactor): socket e stato delle
+//    sessioni passano a un nuovo processo del binario, senza disconnessioni
+//  - Classifiche in diretta (v2, reactor): dopo FR_ISCRIVI il client riceve
+//    solo le variazioni (FR_DELTA), a lotti, invece di richiedere tutto
+//  - Stanze multigiocatore (v2, reactor): chi entra nella stanza di un tema
+//    riceve le stesse domande degli altri nello stesso istante, con risposte
+//    raccolte fino alla scadenza e risultati diffusi a tutti i membri
+//  - Controllo di ammissione (flag -q): oltre la capienza le connessioni
+//    ricevono subito "server occupato" con posizione e attesa stimata e
+//    aspettano in una coda limitata, invece di restare mute nel backlog
+//  - Scadenze per fase (flag -t): login, risposta e inattività al menu temi,
+//    in una ruota di timer gerarchica; la sessione scaduta si chiude come
+//    una disconnessione e libera lo slot
+//  - Tre modalità di servizio (flag -m):
+//      reactor: un loop epoll edge-triggered per core (SO_REUSEPORT),
+//               ogni connessione è una macchina a stati non bloccante
+//      uring:   gli stessi loop, con l'I/O su io_uring (accept e recv
+//               multishot, buffer forniti al kernel, una io_uring_enter per
+//               giro); se il kernel non lo consente si usa epoll
+//      thread:  modalità classica, MAX_THREAD worker con recv() bloccanti
 //
 // ============================================================================
 
+#define _GNU_SOURCE       // accept4, SOCK_NONBLOCK
+
 #include "utility.h"      // costanti, tipi e utility comuni
+#include "protocollo.h"   // formato v2 dei frame
+#include "normalizza.h"   // normalizzazione delle risposte (UTF-8, SSE2)
 #include <pthread.h>      // thread POSIX
 #include <dirent.h>       // lettura directory (qa/)
 #include <netinet/in.h>   // sockaddr_in, htons
+#include <netinet/tcp.h>  // TCP_NODELAY
 #include <time.h>         // time(), localtime_r, strftime
 #include <stdatomic.h>    // atomic_int per shutdown cooperativo
-#include <ctype.h>        // tolower, isspace
+#include <errno.h>        // EAGAIN/EINTR per I/O non bloccante
+#include <getopt.h>       // parsing flag da riga di comando
+#include <sys/epoll.h>    // epoll per la modalità reactor
+#include <sys/uio.h>      // struct iovec per invii vettoriali
+#include <sys/inotify.h>  // notifiche di modifica su qa/
+#include <poll.h>         // attesa con timeout (accorpamento eventi inotify)
+#include <limits.h>       // INT_MAX
+#include <fcntl.h>        // open() di log e snapshot
+#include <sys/stat.h>     // mkdir della cartella di persistenza
+#include <sys/un.h>       // sockaddr_un del socket delle statistiche
+#include <sys/eventfd.h>  // risveglio dei loop per il riavvio a caldo
+#include <sys/wait.h>     // waitpid del nuovo processo (riavvio a caldo)
+#include <stddef.h>       // offsetof (sessione dal suo timer)
+#include <sys/mman.h>     // mappature delle code di io_uring
+#include <sys/syscall.h>  // io_uring_setup/enter/register (senza liburing)
+#include <linux/io_uring.h> // strutture e costanti di io_uring
 
 // ==================== Configurazione ====================
-#define MAX_THREAD   8          // max client simultanei (1 slot per thread)
+#define MAX_THREAD   8          // max client simultanei in modalità thread (1 slot per thread)
+#define MAX_SESSIONI 16384      // max client simultanei in modalità reactor (default, flag -c)
+#define MAX_EVENTI   256        // eventi restituiti per singola epoll_wait
+#define ANELLO_VOCI  4096       // voci della coda di sottomissione io_uring (per loop)
+#define ANELLO_BUFFER 1024      // buffer forniti al kernel per la recv multishot (potenza di 2)
+#define ANELLO_DIM_BUF 2048     // byte di ciascun buffer fornito
+#define DIM_INGRESSO 1024       // buffer di ricezione per connessione (deve contenere un frame v2)
+#define USCITA_MAX   (1 << 20)  // byte non inviati oltre i quali il reactor smette di leggere dal client
+#define STAMPA_HZ    10         // frequenza massima di ridisegno dello stato
+#define DIRETTA_HZ   10         // lotti di variazioni al secondo verso gli iscritti
+#define STANZA_HZ    20         // passi al secondo del thread delle stanze
+#define STANZA_MIN   2          // giocatori presenti perché parta il conto alla rovescia
+#define STANZA_AVVIO 10         // secondi di attesa prima della prima domanda
+#define STANZA_TEMPO 20         // secondi per rispondere a una domanda della stanza
+#define STANZA_PAUSA 3          // secondi di risultati prima della domanda successiva
+#define STANZA_RIGHE 10         // righe di classifica nei risultati di un turno
+#define STANZA_MAX   256        // membri di una partita di stanza (presenti o usciti)
+#define CODA_MAX     256        // connessioni in attesa di un posto (default, flag -q)
+#define SCAD_LOGIN   60         // secondi per completare il login (default, flag -t)
+#define SCAD_RISPOSTA 180       // secondi per rispondere a una domanda (default, flag -t)
+#define SCAD_MENU    600        // secondi di inattività al menu dei temi (default, flag -t)
+#define RUOTA_TICK_MS 100       // granularità della ruota dei timer
+#define RUOTA_BIT    6          // slot per livello della ruota: 1 << RUOTA_BIT
+#define RUOTA_LIVELLI 4         // livelli della ruota (64^4 tick = ~194 giorni)
+#define LIVELLI_MAX  24         // livelli massimi della skip list di classifica
+#define REG_STRISCE  64         // strisce di lock del registro nickname online
 #define QA_FOLDER    "qa/"      // cartella con i file .txt (uno per tema)
+#define SOGLIA_MAX   3          // distanza di edit massima indicabile con " ~N"
+#define DASH_RIGHE   20         // righe per classifica mostrate dalla dashboard
+#define SNAP_OGNI    50000      // risultati nel log che fanno scattare uno snapshot (minimo)
+#define SNAP_SEC     60         // snapshot almeno ogni SNAP_SEC secondi (se ci sono novità)
+#define SLAB_BYTE    (64 * 1024) // dimensione di uno slab dei pool per thread
+#define LINEA_CACHE  64         // allineamento degli slab
+#define ISTO_SUB     16         // sotto-intervalli per ottava negli istogrammi di latenza
+#define ISTO_OTTAVE  40         // fino a 2^40 ns (~18 minuti)
+#define STAT_INVIO_MS 500       // ms concessi a un lettore del socket statistiche per ogni send
 #define SERVER_PORT  4242       // porta TCP del server
 
+_Static_assert(DIM_INGRESSO >= PROTO_MAX_INTEST + PROTO_MAX_RICHIESTA, "DIM_INGRESSO troppo piccolo per un frame v2");
+
 // ==================== Strutture Dati ====================
 
 /*
  * GiocatoreStato
  *  - Mantiene lo stato dell'utente collegato nel thread/slot.
- *    nome[0] == '\0' => slot libero (nessuno connesso).
+ *    nome[0] == '\0' => nessun login nello slot.
  *    temaCorr == NULL => non sta svolgendo un quiz in questo istante.
+ *  - nome è scritto solo dalla sessione proprietaria prima di entrare nel
+ *    registro online; temaCorr è atomico perché la dashboard lo legge senza
+ *    lock globali.
  */
 struct GiocatoreStato {
-    char  nome[MaxUsernameL];   // nickname corrente
-    char* temaCorr;             // nome del tema in corso (puntatore in temiQuiz)
+    char            nome[MaxUsernameL];   // nickname corrente
+    _Atomic(char*)  temaCorr;             // nome del tema in corso (Tabellone.nomeTema)
 };
 
 /*
  * NodoPunteggio
- *  - Nodo di lista doppiamente concatenata per la classifica di un tema.
+ *  - Nodo di skip list indicizzata per la classifica di un tema.
+ *  - Ordine (dal migliore): punteggio decrescente; a parità, prima chi ha
+ *    finito il quiz, poi fine più remota, poi chi ha raggiunto prima il
+ *    punteggio (ordine: numero di sequenza dell'ultimo aggiornamento).
  *  - finito: timestamp (secondi epoch) di fine quiz per tie-break;
  *            0 quando il quiz non è stato ancora completato.
  *  - nick:   COPIA del nickname (decoupling dagli slot online)
+ *  - lsn:    numero del record nel log dei risultati (modalità -p);
+ *            0 = risultato non persistente (quiz in corso o -p assente)
+ *  - succSalvato: catena in Tabellone.salvati (solo nodi con lsn)
+ *  - liv[i].salto: quanti nodi di livello 0 separa il collegamento i
+ *                  (serve al calcolo del rango in O(log n)).
  */
+struct LivelloSkip {
+    struct NodoPunteggio*  avanti;              // prossimo nodo (peggiore) a questo livello
+    unsigned int           salto;               // distanza in posizioni
+};
+
 struct NodoPunteggio {
     unsigned int           punteggio;           // risposte corrette accumulate
     time_t                 finito;              // istante di fine quiz (per il tie-break)
+    uint64_t               ordine;              // sequenza dell'ultimo aggiornamento
     char                   nick[MaxUsernameL];
-    struct NodoPunteggio*  prev;                // nodo precedente
-    struct NodoPunteggio*  nxt;                 // nodo successivo
+    uint64_t               lsn;                 // record nel log (0 = nessuno)
+    struct NodoPunteggio*  succSalvato;
+    struct NodoPunteggio*  indietro;            // nodo precedente (migliore), NULL se primo
+    int                    livelli;             // numero di livelli del nodo
+    struct LivelloSkip     liv[];
+};
+
+/*
+ * VistaClassifica
+ *  - Classifica di un tema già codificata, immutabile dopo la costruzione.
+ *  - rif: un riferimento del tabellone finché è la vista pubblicata, più uno
+ *    per ogni sessione che la sta copiando nella propria coda di uscita.
+ */
+struct VistaClassifica {
+    atomic_int  rif;
+    uint64_t    versione;               // Tabellone.versione codificata
+    size_t      len;
+    uint8_t     dati[];
+};
+
+/*
+ * RigaVista
+ *  - Campi di un nodo copiati sotto il lock del tabellone: la vista si
+ *    codifica poi da questa copia, a lock rilasciato.
+ */
+struct RigaVista {
+    char         nick[MaxUsernameL];
+    unsigned int punteggio;
 };
 
 /*
  * Tabellone
  *  - Rappresenta la classifica di un singolo tema.
- *  - nomeTema punta alla stringa temiQuiz[i].nome (memoria condivisa).
+ *  - Sopravvive alle ricariche di qa/: i cataloghi lo ritrovano per nome,
+ *    e non viene mai liberato (le sessioni ne tengono i puntatori).
+ *  - id: ordine di creazione.
+ *  - testa è una sentinella con LIVELLI_MAX livelli (non è un giocatore).
+ *  - versione cresce ad ogni modifica; vistaV1/vistaV2 sono la classifica
+ *    già codificata nei formati di "Mostra Punteggio" (v1 e blocco del
+ *    frame v2), immutabili e ricostruite solo quando la versione cambia.
+ *  - salvati: con -p, la riga salvata (lsn != 0) di ogni nick, per nick
+ *    (hash FNV-1a, catene su succSalvato): un nick ha una sola riga salvata
+ *    per tema, e un nuovo risultato sostituisce quello precedente.
+ *  - delta: operazioni OpDelta già codificate dall'ultimo lotto pubblicato,
+ *    registrate solo se c'è almeno un iscritto alla diretta; deltaVer[k] è
+ *    la versione dopo l'operazione k, deltaOff[k] il suo inizio in delta.
  */
 struct Tabellone {
-    char*                 nomeTema;     // etichetta del tema
-    struct NodoPunteggio* head;         // testa della lista classifica
+    char                  nomeTema[MaxReadL];   // etichetta del tema
+    int                   id;           // ordine di creazione
+    struct Tabellone*     succ;         // elenco di tutti i tabelloni
+    struct Tabellone*     succHash;     // catena nel bucket di indiceTabelloni
+    struct NodoPunteggio* testa;        // sentinella della skip list
+    struct NodoPunteggio* coda;         // ultimo (peggiore) nodo, NULL se vuota
+    int                   livello;      // livelli in uso
+    unsigned int          lunghezza;    // numero di giocatori in classifica
+    uint64_t              seq;          // contatore per NodoPunteggio.ordine
+    uint32_t              rng;          // stato xorshift per i livelli
+    uint64_t              versione;     // modifiche applicate alla classifica
+    struct VistaClassifica* vistaV1;    // classifica serializzata (v1)
+    struct VistaClassifica* vistaV2;    // blocco classifica in formato v2
+    struct NodoPunteggio** salvati;
+    uint32_t              maschSalvati, numSalvati;
+    struct ProtoBuf       delta;
+    uint64_t*             deltaVer;
+    uint32_t*             deltaOff;
+    size_t                deltaNum, deltaCap;
     pthread_mutex_t       lock;         // mutex per accessi concorrenti
 };
 
+/*
+ * LottoDelta
+ *  - Variazioni di un tabellone tra due pubblicazioni, immutabili: un
+ *    riferimento per ogni loop a cui sono consegnate, che le copia nelle
+ *    code di uscita dei propri iscritti.
+ *  - ver/off: come deltaVer/deltaOff del tabellone; dati: le operazioni.
+ */
+struct LottoDelta {
+    atomic_int         rif;
+    struct Tabellone*  tab;
+    size_t             num, len;
+    uint64_t*          ver;
+    uint32_t*          off;
+    uint8_t*           dati;
+};
+
+/*
+ * CursoreDiretta
+ *  - Per iscritto e tabellone (indice: Tabellone.id): posizione del tema in
+ *    FR_CLASSIFICHE (-1 = non nel catalogo della sessione) e ultima versione
+ *    già nota al client; le operazioni con versione <= si scartano.
+ */
+struct CursoreDiretta {
+    int      indice;
+    uint64_t versione;
+};
+
+/*
+ * Diffusione
+ *  - Uno o più frame di una stanza già codificati, immutabili: un riferimento
+ *    per ogni loop a cui sono consegnati. Il loop li scrive direttamente sui
+ *    socket dei membri (senza copia); solo chi ha già una coda di uscita, o
+ *    il resto di un invio parziale, ne riceve una copia in coda.
+ *  - gen: partita a cui appartengono (i membri di una partita successiva li
+ *    ignorano); fine: ultimo messaggio della partita, i membri tornano ai temi.
+ */
+struct Diffusione {
+    atomic_int         rif;
+    struct Stanza*     stanza;
+    uint64_t           gen;
+    int                fine;
+    size_t             len;
+    uint8_t            dati[];
+};
+
+/*
+ * MembroStanza
+ *  - Giocatore di una partita di stanza; resta nella classifica della
+ *    partita anche dopo essere uscito (presente = 0). Se rientra con lo
+ *    stesso nick riprende la propria riga; in attesa dell'avvio le righe
+ *    di chi è uscito si riusano per i nuovi arrivati.
+ *  - tempo: ns impiegati per le risposte giuste (spareggio a parità di punti).
+ *  - turno: ultimo turno a cui ha risposto (-1 = nessuno).
+ */
+struct MembroStanza {
+    char          nick[MaxUsernameL];
+    unsigned int  punti;
+    uint64_t      tempo;
+    int           turno;
+    int           presente;
+};
+
+/*
+ * Stanza
+ *  - Partita condivisa di un tema: una per tabellone, mai liberata (come i
+ *    tabelloni, sopravvive alle ricariche di qa/).
+ *  - Tutto sotto lock: il thread delle stanze la fa avanzare, i loop vi
+ *    registrano ingressi, uscite e risposte dei propri membri.
+ *  - gen: partita corrente (cresce ad ogni fine); cat/temaIdx/estratte: le
+ *    domande della partita, dal catalogo corrente al suo avvio.
+ *  - scadenza: istante (ns) del prossimo passaggio di fase, 0 = nessuno.
+ *  - perLoop: membri presenti per loop (a chi consegnare le diffusioni);
+ *    cambiata: presenti o fase cambiati, lo stato va diffuso.
+ *  - ordine: appoggio per la classifica della partita.
+ */
+struct Stanza {
+    struct Tabellone*     tab;
+    struct Stanza*        succ;
+    pthread_mutex_t       lock;
+    enum FaseStanza       fase;
+    uint64_t              gen;
+    uint64_t              scadenza;
+    uint64_t              apertura;     // ns di apertura della domanda corrente
+    struct Catalogo*      cat;
+    int                   temaIdx;
+    int                   turno;        // domanda corrente (0..NumQuest-1)
+    uint32_t              estratte[NumQuest];
+    uint64_t              rng;
+    struct MembroStanza*  membri;
+    struct MembroStanza** ordine;
+    int                   numMembri, capMembri;
+    int                   presenti, risposte, giuste;
+    int*                  perLoop;
+    int                   cambiata;
+};
+
 /*
  * CoppiaQ
- *  - Una domanda e la sua risposta corretta.
+ *  - Una domanda e la sua risposta corretta, come offset nell'arena
+ *    di stringhe del tema (testi terminati da '\0', nessun limite fisso).
+ *  - attesa: la risposta già normalizzata al caricamento, l'unica usata
+ *    nel confronto (il testo originale resta comunque nell'arena).
+ *  - soglia: distanza di edit tollerata in modalità -f (derivata dalla
+ *    lunghezza, o indicata nel file con " ~N" in coda alla risposta).
  */
 struct CoppiaQ {
-    char domanda[MaxReadQuestL];        // contiene già il '?'
-    char risposta[MaxReadL];
+    uint32_t domanda;                   // contiene già il '?'
+    uint32_t risposta;
+    uint32_t attesa;                    // risposta normalizzata
+    uint16_t lenAttesa;
+    uint8_t  soglia;
 };
 
 /*
  * TemaQuiz
- *  - Un tema con il suo nome (senza .txt) e l'array di NumQuest domande.
+ *  - Un tema con il suo nome (senza .txt) e il banco completo di domande.
+ *  - Ogni sessione estrae NumQuest domande a caso dal banco (numDomande >= NumQuest).
+ *  - Con un pacchetto (flag -P) quiz e arena puntano nella sua mappatura:
+ *    catalogoLibera non li libera ma smappa il pacchetto (Catalogo.mappa).
  */
 struct TemaQuiz {
-    char           nome[MaxReadL];
-    struct CoppiaQ quiz[NumQuest];
+    char            nome[MaxReadL];
+    struct CoppiaQ* quiz;               // banco domande
+    uint32_t        numDomande;
+    char*           arena;              // testi di domande e risposte
+    size_t          arenaLen, arenaCap;
+};
+
+/*
+ * Catalogo
+ *  - Insieme immutabile di temi e domande caricato da qa/, con il
+ *    tabellone associato a ciascun tema (stesso indice).
+ *  - Pubblicato tramite scambio di puntatore (stile RCU): ogni sessione
+ *    acquisisce il catalogo corrente alla connessione per l'elenco dei temi
+ *    (nomi e tabelloni, rif) e lo rilascia alla chiusura; l'ultimo rilascio
+ *    di un catalogo sostituito lo libera.
+ *  - Le domande hanno un conteggio a parte (rifDomande): ogni partita
+ *    prende il catalogo corrente solo per la sua durata, così una ricarica
+ *    libera banco e arene appena finiscono le partite che li usano, anche
+ *    se restano connesse sessioni che hanno ricevuto l'elenco vecchio.
+ */
+struct Catalogo {
+    int                numTemi;
+    struct TemaQuiz*   temi;
+    struct Tabellone** tabelloni;
+    uint64_t           generazione;
+    atomic_int         rif;             // sessioni + 1 finché è quello corrente
+    atomic_int         rifDomande;      // partite in corso + 1 finché è quello corrente
+    void*              mappa;           // pacchetto mappato (NULL: caricato da qa/)
+    size_t             lenMappa;
+};
+
+/*
+ * Pacchetto domande (flag -C per costruirlo, -P per servirlo)
+ *  - IntestPacchetto, poi numTemi TemaPacchetto, poi numDomande CoppiaQ di
+ *    tutti i temi (contigue per tema), infine la tabella delle stringhe:
+ *    le arene dei temi una dopo l'altra, con gli stessi offset delle CoppiaQ.
+ *  - crc: crc32 dell'indice dei temi e delle CoppiaQ, cioè di tutti gli
+ *    offset; le stringhe non sono lette all'apertura (ogni arena termina
+ *    con '\0', quindi un byte alterato cambia un testo, non un indirizzo).
+ *    dimCoppia e versione scartano pacchetti di un binario con un'altra
+ *    disposizione.
+ */
+struct IntestPacchetto {
+    char     magia[8];                  // "QZPACK1"
+    uint32_t versione;
+    uint32_t numTemi;
+    uint64_t dimensione;                // byte dell'intero file
+    uint64_t numDomande;
+    uint64_t lenStringhe;
+    uint32_t dimCoppia;                 // sizeof(struct CoppiaQ)
+    uint32_t crc;
+};
+
+struct TemaPacchetto {
+    char     nome[MaxReadL];
+    uint64_t primaDomanda;              // indice della prima CoppiaQ del tema
+    uint64_t arena;                     // offset dell'arena nella tabella delle stringhe
+    uint32_t numDomande;
+    uint32_t lenArena;
+};
+
+/*
+ * FaseSessione
+ *  - Punto del protocollo in cui si trova una connessione: determina
+ *    la dimensione del prossimo frame atteso dal client.
+ */
+enum FaseSessione {
+    FASE_LOGIN,                         // attesa nickname  (MaxUsernameL byte)
+    FASE_COMANDO,                       // attesa comando   (uint16_t)
+    FASE_RISPOSTA,                      // attesa risposta  (MaxReadL byte)
+    FASE_STANZA,                        // in una stanza (solo v2)
+    FASE_CHIUSA                         // sessione terminata, da ripulire
+};
+
+struct Reattore;
+
+/*
+ * Timer / RuotaTimer (scadenze di fase)
+ *  - Timer: nodo intrusivo (in Sessione) di una lista circolare doppia con
+ *    sentinella: armare e disarmare sono O(1). succ == NULL: non armato.
+ *  - RuotaTimer: RUOTA_LIVELLI livelli da 1 << RUOTA_BIT slot; il livello k
+ *    copre scadenze entro 64^(k+1) tick, con slot larghi 64^k tick.
+ *    Ogni tick svuota uno slot del livello 0; quando un livello compie un
+ *    giro si ridistribuisce lo slot corrente di quello superiore (cascata).
+ *    Il costo per tick non dipende dal numero di connessioni.
+ *  - adesso: prossimo tick da elaborare; armati: timer nella ruota.
+ */
+struct Timer {
+    struct Timer* prec, *succ;
+    uint64_t      scadenza;             // tick assoluto
+};
+
+struct RuotaTimer {
+    uint64_t      adesso;
+    size_t        armati;
+    struct Timer  slot[RUOTA_LIVELLI][1 << RUOTA_BIT];     // sentinelle
+};
+
+/*
+ * VoceGiocatore
+ *  - Riferimento diretto a un nodo di classifica posseduto dalla sessione:
+ *    alla disconnessione si scollegano solo questi, senza scandire i tabelloni.
+ *  - punteggio/finito/rangoArrivo: riepilogo aggiornato negli stessi punti in
+ *    cui si modifica la classifica, letto dalla sezione "Utenti online" senza
+ *    toccare i tabelloni.
+ */
+struct VoceGiocatore {
+    struct Tabellone*     tab;          // tabellone del tema
+    struct NodoPunteggio* nodo;
+    unsigned int          punteggio;    // copia di nodo->punteggio
+    time_t                finito;       // copia di nodo->finito (0 = in corso)
+    unsigned int          rangoArrivo;  // posizione in classifica a fine quiz
+};
+
+/*
+ * Sessione
+ *  - Stato di protocollo di una connessione (macchina a stati).
+ *  - La stessa logica serve entrambe le modalità: in "thread" il worker la
+ *    alimenta con recv() bloccanti, in "reactor" la alimenta il loop epoll.
+ *  - out/outLen/outOff: coda di uscita. Ogni risposta logica vi si accumula
+ *    e parte con un solo invio al termine del turno di protocollo (in
+ *    reactor, se send() restituisce EAGAIN, il resto attende EPOLLOUT).
+ *    outNuovi: byte accodati dall'ultimo punto di svuotamento.
+ *    pausa: il reactor ha smesso di consumare frame perché la coda di uscita
+ *    supera USCITA_MAX (client che non legge); riprende quando si svuota.
+ *  - versione: 1 finché il client non negozia v2 con il primo frame di login;
+ *    tx è il buffer in cui si compongono i frame v2.
+ *  - cursori: stato della diretta delle classifiche (solo v2 in reactor).
+ *  - stanza: stanza in cui si trova (FASE_STANZA), con la partita (gen) e
+ *    la posizione in Stanza.membri a cui appartiene la sessione.
+ *  - riserva: byte ricevuti che non si possono ancora consumare (arrivati in
+ *    pausa con io_uring, o oltre DIM_INGRESSO da un riavvio a caldo).
+ *  - ricevendo/inviando/outVolo/chiusa (solo io_uring): recv multishot
+ *    armata (2 = annullamento chiesto), byte della send in volo e buffer
+ *    che la send sta leggendo se out è stato riallocato nel frattempo;
+ *    chiusa: sessione già chiusa che attende le ultime completion.
+ */
+struct Sessione {
+    int                    conn_sd;                 // socket della connessione
+    int                    slot;                    // indice in giocatori[]
+    struct GiocatoreStato* gioc;                    // slot online associato
+    struct Catalogo*       elenco;                  // catalogo dell'elenco temi inviato al login
+    struct Catalogo*       cat;                     // catalogo del quiz in corso (FASE_RISPOSTA)
+    char                   nick_attuale[MaxUsernameL];
+    enum FaseSessione      fase;
+    int                    versione;                // protocollo: 1 o PROTO_V2
+    struct ProtoBuf        tx;                      // composizione frame v2
+
+    int                    temaIdx;                 // tema in corso, indice in cat
+    int                    domanda;                 // indice domanda in corso (0..NumQuest-1)
+    uint32_t               estratte[NumQuest];      // domande del banco estratte per il tema
+    uint64_t               rng;                     // stato PRNG (splitmix64) della sessione
+    struct NodoPunteggio*  nodo;                    // nodo classifica del tema in corso
+    struct VoceGiocatore*  voci;                    // tutti i nodi di classifica della sessione
+    int                    numVoci, capVoci;
+    pthread_mutex_t        mtxVoci;                 // protegge voci[] (letto dalla dashboard)
+
+    struct Reattore*       loop;                    // NULL in modalità thread
+    struct Sessione*       regNext;                 // catena nel bucket del registro online
+    struct Sessione*       regPrev, *regSucc;       // elenco online della striscia
+    uint32_t               regHash;                 // hash del nick (0 = non registrata)
+    char                   in[DIM_INGRESSO];        // byte ricevuti e non ancora consumati
+    size_t                 inLen;
+    char*                  out;                     // coda di uscita
+    size_t                 outLen, outOff, outCap;
+    size_t                 outNuovi;
+    int                    pausa;
+    char*                  riserva;
+    size_t                 riservaLen, riservaCap;
+    int                    ricevendo;
+    size_t                 inviando;
+    char*                  outVolo;
+    int                    chiusa;
+
+    struct CursoreDiretta* cursori;                 // != NULL: iscritta alla diretta
+    int                    numCursori;
+    struct Sessione*       iscrPrec, *iscrSucc;     // elenco iscritti del loop
+
+    struct Stanza*         stanza;                  // != NULL: in FASE_STANZA
+    uint64_t               stanzaGen;
+    int                    stanzaMembro;
+    struct Sessione*       stanzaPrec, *stanzaSucc; // elenco membri di stanza del loop
+
+    struct Timer           scad;                    // scadenza della fase corrente
+    uint64_t               inizio;                  // istante di avvio (ns), per la durata media
+};
+
+/*
+ * Ammissione (controllo di ammissione, sotto mtx_players)
+ *  - coda/arrivo: anello FIFO dei socket accettati in attesa di un posto e
+ *    istante di ingresso in coda (0 = nessuna attesa: in modalità thread
+ *    anche le connessioni per un worker libero passano da qui).
+ *  - attivi: worker occupati (modalità thread; nel reactor contano gli
+ *    slot liberi). picco: massima lunghezza raggiunta dalla coda.
+ *  - durataMedia: durata delle sessioni in ns (media mobile), per la stima
+ *    dell'attesa.
+ */
+struct Ammissione {
+    int*            coda;
+    uint64_t*       arrivo;
+    size_t          testa, num, cap, picco;
+    unsigned int    attivi;
+    uint64_t        durataMedia;
+    pthread_cond_t  pronta;             // modalità thread: connessioni per i worker
+};
+
+/*
+ * RegistroOnline
+ *  - Tabella hash dei nickname online (chiave: nick, valore: Sessione).
+ *  - Bucket a dimensione fissa (>= 2 * numSlot, potenza di 2): gli online non
+ *    possono superare gli slot, quindi niente rehash.
+ *  - Lock a strisce: il bucket b è protetto da strisce[b % REG_STRISCE];
+ *    ogni striscia tiene anche l'elenco delle proprie sessioni per la
+ *    dashboard (visita O(online), non O(bucket)).
+ */
+struct StrisciaRegistro {
+    pthread_mutex_t  lock;
+    struct Sessione* primo;             // elenco sessioni della striscia
+};
+
+struct RegistroOnline {
+    struct Sessione**       bucket;
+    uint32_t                maschera;   // numero bucket - 1
+    struct StrisciaRegistro strisce[REG_STRISCE];
+};
+
+/*
+ * Anello (modalità io_uring, uno per loop)
+ *  - fd e code condivise con il kernel: sottomissione (sq*, sqe) e
+ *    completamento (cq*, cqe). sqCoda: voci preparate dal loop, pubblicate
+ *    alla io_uring_enter successiva.
+ *  - buf/bufDati: buffer ring registrato (gruppo 0) e memoria dei suoi
+ *    ANELLO_BUFFER buffer, in cui il kernel deposita i dati delle recv
+ *    multishot; bufCoda: prossima posizione in cui restituirne uno.
+ *  - volo: operazioni che devono ancora produrre l'ultima completion.
+ *    fermo: riavvio a caldo, non se ne preparano altre.
+ */
+struct Anello {
+    int                       fd;
+    unsigned*                 sqTesta, *sqCodaK;
+    unsigned                  sqCoda, sqMaschera, sqVoci;
+    struct io_uring_sqe*      sqe;
+    unsigned*                 cqTesta, *cqCoda;
+    unsigned                  cqMaschera;
+    struct io_uring_cqe*      cqe;
+    void*                     mappa;
+    size_t                    lenMappa, lenSqe;
+    struct io_uring_buf_ring* buf;
+    char*                     bufDati;
+    uint16_t                  bufCoda;
+    size_t                    volo;
+    int                       fermo;
+};
+
+/*
+ * Reattore
+ *  - Un loop epoll per core, ciascuno con il proprio socket di ascolto
+ *    (SO_REUSEPORT: il kernel distribuisce le connessioni tra i loop).
+ *  - anello: in modalità io_uring sostituisce il descrittore epoll.
+ *  - posta: eventfd con cui il thread della diretta consegna i lotti di
+ *    variazioni (inArrivo, sotto mtxPosta); iscritti: sessioni del loop
+ *    iscritte alla diretta, toccate solo dal loop stesso.
+ *  - diffusioni: messaggi delle stanze, nella stessa posta; inStanza:
+ *    sessioni del loop che sono in una stanza.
+ *  - ruota: scadenze di fase delle sessioni del loop (nessun lock).
+ */
+struct Reattore {
+    int       id;
+    int       ep;                       // descrittore epoll (-1 con io_uring)
+    int       sd_ascolto;               // socket di ascolto di questo loop
+    struct Anello* anello;              // NULL = epoll
+    pthread_t tid;
+    struct PoolThread* pool;            // pool del thread del loop (sessioni)
+
+    int                  posta;
+    pthread_mutex_t      mtxPosta;
+    struct LottoDelta**  inArrivo;
+    size_t               numArrivo, capArrivo;
+    struct Sessione*     iscritti;
+    atomic_int           numIscritti;
+    struct Diffusione**  diffusioni;
+    size_t               numDiffusioni, capDiffusioni;
+    struct Sessione*     inStanza;
+
+    struct RuotaTimer    ruota;         // scadenze delle sessioni del loop
+};
+
+/*
+ * Persistenza (flag -p <cartella>)
+ *  - RecordWal: un risultato completato nel log append-only, a dimensione
+ *    fissa; crc per riconoscere un record scritto a metà (crash).
+ *  - Snapshot: intestazione, poi per ogni tabellone un blocco con le righe
+ *    già in ordine di classifica (si ricaricano accodando, in O(1) l'una).
+ *    taglio: tutti i record con lsn <= taglio sono inclusi nello snapshot.
+ */
+struct RecordWal {
+    uint64_t lsn;
+    int64_t  finito;
+    uint32_t punteggio;
+    uint32_t crc;                       // crc32 del record con crc = 0
+    char     tema[MaxReadL];
+    char     nick[MaxUsernameL];
+};
+
+struct IntestSnapshot {
+    char     magia[8];                  // "QZSNAP1"
+    uint64_t taglio;
+    uint32_t numBlocchi;
+    uint32_t riservato;
+};
+
+struct BloccoSnapshot {
+    char     tema[MaxReadL];
+    uint64_t righe;
+};
+
+struct RigaSnapshot {
+    char     nick[MaxUsernameL];
+    int64_t  finito;
+    uint32_t punteggio;
+    uint32_t riservato;
+};
+
+// Stato di accodamento in ordine (caricamento snapshot): ultimo nodo e suo
+// rango per ogni livello della skip list
+struct CodaSkip {
+    struct NodoPunteggio* ultimo[LIVELLI_MAX];
+    unsigned int          rango[LIVELLI_MAX];
+    int                   valida;       // 0 = righe fuori ordine, si inserisce normalmente
+};
+
+/*
+ * Statistiche di latenza (flag -s <socket>)
+ *  - Una StatThread per ogni thread che registra: solo il proprietario
+ *    scrive (load+store relaxed, nessuna istruzione atomica read-modify-write),
+ *    il lettore del socket somma tutte le StatThread dell'elenco.
+ *  - Istogramma log-lineare in ns: ISTO_SUB sotto-intervalli per potenza
+ *    di 2 (errore relativo < 1/ISTO_SUB), stile HDR.
+ */
+enum FaseStat {
+    STAT_ACCETTA,                       // accept -> numero temi inviato
+    STAT_LOGIN,                         // validazione nickname + elenco temi
+    STAT_TEMA,                          // selezione tema + prima domanda
+    STAT_RISPOSTA,                      // elaborazione risposta + domanda successiva
+    STAT_CLASSIFICA,                    // composizione di "Mostra Punteggio"
+    STAT_INVIO,                         // svuotamento della coda di uscita (send)
+    STAT_STAMPA,                        // ridisegno della dashboard
+    STAT_CODA,                          // attesa nella coda di ammissione
+    NUM_FASI
+};
+
+enum ContatoreStat {
+    CONT_CONNESSIONI,
+    CONT_LOGIN_RIFIUTATI,
+    CONT_GIUSTE,
+    CONT_ERRATE,
+    CONT_SEGNALAZIONI,                  // segnalaStato(): richieste di ridisegno
+    CONT_OGGETTI_POOL,                  // nodi/sessioni presi dai pool per thread
+    CONT_SLAB,                          // slab chiesti al sistema (unica malloc dei pool)
+    CONT_SCADUTE,                       // sessioni chiuse per scadenza di fase
+    CONT_IN_CODA,                       // connessioni messe in coda di ammissione
+    CONT_RIFIUTATE,                     // connessioni rifiutate a coda piena
+    NUM_CONTATORI
+};
+
+struct IstoLatenza {
+    _Atomic uint64_t conta[ISTO_OTTAVE * ISTO_SUB];
+    _Atomic uint64_t totale, somma, max;
+};
+
+struct StatThread {
+    struct IstoLatenza  fasi[NUM_FASI];
+    _Atomic uint64_t    contatori[NUM_CONTATORI];
+    struct StatThread*  succ;
+};
+
+/*
+ * Pool per thread (slab)
+ *  - Nodi di classifica (una classe per numero di livelli) e Sessioni del
+ *    reactor si prendono da slab di SLAB_BYTE allineati alla linea di cache,
+ *    tagliati in oggetti di dimensione fissa (multipla di 16 byte).
+ *  - Ogni thread ha il proprio pool: allocazione e rilascio sono un pop/push
+ *    sulla lista libera locale, senza lock. Le sessioni tornano sempre al
+ *    pool del proprio loop (creato all'avvio, Reattore.pool): se a
+ *    rilasciarle è un altro thread finiscono nella pila rientri della
+ *    classe (push atomico), che il proprietario svuota in blocco quando la
+ *    lista libera è vuota. Un nodo di classifica rilasciato da un altro loop
+ *    passa al pool di quel loop, che lo riusa.
+ *  - Gli slab non tornano mai al sistema: il pool si stabilizza sul picco.
+ */
+struct OggettoLibero {
+    struct OggettoLibero* succ;
+};
+
+struct ClassePool {
+    size_t                dim;          // byte per oggetto
+    struct OggettoLibero* liberi;
+    _Atomic(struct OggettoLibero*) rientri;     // rilasciati da altri thread
+    char*                 corrente;     // parte non ancora tagliata dell'ultimo slab
+    size_t                resto;
+};
+
+struct PoolThread {
+    struct ClassePool nodi[LIVELLI_MAX];    // nodi[i]: nodi con i+1 livelli
+    struct ClassePool sessioni;
+};
+
+/*
+ * Riavvio a caldo (passaggio di stato tra processi)
+ *  - Canale: socketpair SOCK_SEQPACKET ereditato dal nuovo processo (-H fd).
+ *    Ogni blocco logico viaggia in messaggi da PASSA_BLOCCO byte al massimo;
+ *    i descrittori (SCM_RIGHTS) accompagnano il primo messaggio del blocco.
+ *  - Ordine: intestazione (+ socket di ascolto), tabelloni con le righe in
+ *    ordine di classifica, poi una SessionePassata (+ socket) per
+ *    connessione, seguita da voci, byte in ingresso e risposta non inviata.
+ *  - Le voci indicano il nodo per posizione in classifica (rango): il nuovo
+ *    processo ricostruisce i tabelloni nello stesso ordine.
+ */
+struct IntestPassaggio {
+    char     magia[8];                  // "QZPASS1"
+    uint64_t walLsn;                    // ultimo lsn del log (modalità -p)
+    uint32_t numAscolto;
+    uint32_t numTabelloni;
+    uint32_t numSessioni;
+    uint32_t riservato;
+};
+
+struct RigaPassata {
+    char     nick[MaxUsernameL];
+    int64_t  finito;
+    uint64_t lsn;
+    uint32_t punteggio;
+    uint32_t riservato;
+};
+
+struct SessionePassata {
+    uint32_t fase;
+    uint32_t versione;
+    char     nick[MaxUsernameL];
+    char     tema[MaxReadL];            // tema in corso ("" fuori da FASE_RISPOSTA)
+    uint32_t domanda;
+    uint32_t estratte[NumQuest];
+    uint64_t rng;
+    uint32_t numVoci;
+    uint32_t inLen;                     // byte ricevuti non consumati (buffer + riserva)
+    uint64_t outLen;                    // byte di risposta non ancora inviati
+    uint32_t iscritto;                  // diretta attiva: il nuovo processo la riavvia
+    uint32_t riservato;
+};
+
+struct VocePassata {
+    char     tema[MaxReadL];
+    uint64_t rango;                     // posizione del nodo (1 = primo)
+    int64_t  finito;
+    uint32_t punteggio;
+    uint32_t rangoArrivo;
 };
 
 // ==================== Variabili Globali ====================
 
-static int                   sd_ascolto;                // socket di ascolto
-static int                   numTemi = 0;               // numero di file .txt in qa/
-static struct TemaQuiz*      temiQuiz   = NULL;         // vettore dinamico dei temi
-static struct Tabellone*     tabelloni  = NULL;         // classifica per ciascun tema
-static struct GiocatoreStato giocatori[MAX_THREAD];     // 1 slot per thread
+static int                   sd_ascolto;                // socket di ascolto (modalità thread)
+
+// Catalogo temi corrente (sostituito dalla ricarica a caldo) e tabelloni
+static struct Catalogo*      catalogoCorr = NULL;       // protetto da rw_catalogo
+static pthread_rwlock_t      rw_catalogo = PTHREAD_RWLOCK_INITIALIZER;
+static struct Tabellone*     elencoTabelloni = NULL;    // tutti i tabelloni mai creati (solo in testa)
+static int                   numTabelloni    = 0;
+static struct Tabellone**    indiceTabelloni = NULL;    // per nome tema (FNV-1a), sotto mtx_tabelloni
+static uint32_t              mascheraTabelloni = 0;     // numero bucket - 1 (0 = indice assente)
+static pthread_mutex_t       mtx_tabelloni = PTHREAD_MUTEX_INITIALIZER;
+static char                  esitoRicarica[128] = "";   // ultimo esito, per la dashboard
+static pthread_mutex_t       mtx_ricarica = PTHREAD_MUTEX_INITIALIZER;
+static struct GiocatoreStato* giocatori = NULL;         // 1 slot per connessione
+static int                   numSlot    = 0;            // dimensione di giocatori[]
+
+// Modalità di servizio (flag -m) e parametri del reactor
+static int                   modoReactor = 1;           // 1 = reactor, 0 = thread
+static int                   modoAnello  = 0;           // 1 = reactor su io_uring (-m uring)
+static int                   numLoop     = 0;           // 0 = uno per core (flag -l)
+static int                   modoTollerante = 0;        // 1 = accetta errori di battitura (flag -f)
+static const char*           percorsoPacchetto = NULL;  // catalogo da pacchetto (flag -P), NULL = qa/
+static atomic_int            iscrittiTotali = 0;        // sessioni iscritte alla diretta (tutti i loop)
+static struct Stanza*        elencoStanze = NULL;       // tutte le stanze mai aperte (solo in testa)
+static pthread_mutex_t       mtx_stanze = PTHREAD_MUTEX_INITIALIZER;
 
-// Sincronizzazione “stampa stato”
-static pthread_mutex_t mtx_score;
-static pthread_cond_t  cond_score;
-static int             flag_stampa = 0;                 // 0 = nessuna richiesta 
-                                                        // 1 = richiesta attiva
+// Scadenze per fase in secondi (flag -t login:risposta:menu, 0 = nessuna);
+// in modalità thread una sola ruota, avanzata da threadScadenze
+static unsigned int          scadenzaFase[FASE_CHIUSA] = { SCAD_LOGIN, SCAD_MENU, SCAD_RISPOSTA };
+static struct RuotaTimer     ruotaThread;
+static pthread_mutex_t       mtx_ruota = PTHREAD_MUTEX_INITIALIZER;
+
+// Persistenza delle classifiche (flag -p): coda dei record verso il thread del log
+static const char*           dirPersistenza = NULL;     // NULL = classifiche solo in memoria
+static int                   walFd   = -1;
+static struct RecordWal*     walCoda = NULL;            // record in attesa di scrittura
+static size_t                walNum  = 0, walCap = 0;
+static uint64_t              walLsn  = 0;               // ultimo lsn assegnato
+static size_t                walRipetuti = 0;           // record del log non ancora in uno snapshot
+static int                   walChiusura = 0;
+static pthread_mutex_t       mtx_wal  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t        cond_wal = PTHREAD_COND_INITIALIZER;
+static pthread_t             t_wal;
+
+// Statistiche: elenco delle StatThread (solo in testa) e socket Unix (flag -s)
+static const char*           percorsoStat = NULL;
+static struct StatThread*    elencoStat   = NULL;
+static pthread_mutex_t       mtx_stat = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct StatThread* statLocale = NULL;
+static __thread struct PoolThread* poolLocale = NULL;
+static __thread struct RigaVista*  righeVista = NULL;     // copia delle righe per classificaVista
+static __thread unsigned int       capRigheVista = 0;
+static __thread struct ProtoBuf    lavoroVista;           // codifica della vista v2
+static uint64_t              statAvvio = 0;             // istante di avvio (ns)
+static struct Reattore*      reattori    = NULL;
+static struct Sessione**     sessioniSlot = NULL;       // slot -> sessione (reactor)
+
+// Riavvio a caldo: argomenti originali, risveglio dei loop, socket ereditati
+static int                   argcAvvio;
+static char**                argvAvvio;
+static atomic_int            riavvio = 0;               // 1 = loop in pausa per il passaggio
+static pthread_rwlock_t      rw_passaggio = PTHREAD_RWLOCK_INITIALIZER;  // thread di servizio: lettura per giro
+static int                   svegliaLoop = -1;          // eventfd registrato in ogni epoll
+static int                   fdPassaggio = -1;          // canale dal vecchio processo (-H)
+static int*                  ascoltoEreditati = NULL;
+static int                   numEreditati = 0;
+static uint32_t              passaTabelloni, passaSessioni;   // annunciati dall'intestazione
+
+// Slot liberi in modalità reactor (pila protetta da mtx_players),
+// coda di ammissione e registro dei nickname online
+static struct RegistroOnline registro;
+static int*                  slotLiberi  = NULL;
+static int                   numLiberi   = 0;
+static struct Ammissione     amm = { .pronta = PTHREAD_COND_INITIALIZER };
+static int                   codaMax = CODA_MAX;        // flag -q
+
+// Sincronizzazione “stampa stato”: i worker incrementano il numero di
+// sequenza (fire-and-forget), il renderer ridisegna quando cambia.
+static atomic_uint     seqStato = 0;
 
 // Protezioni varie
-static pthread_mutex_t mtx_sd;                  // serialize accept() tra i thread
-static pthread_mutex_t mtx_players;             // protezione array giocatori[]
+static pthread_mutex_t mtx_players;             // pila degli slot liberi e coda di ammissione
 
 // ---- Shutdown controllato (premi 'Q' + Invio) ----
 static atomic_int server_shutdown = 0;          // 0=on 
                                                 // 1=shutdown
 
+// Contatori di invio (dashboard): syscall di scrittura per risposta logica
+// (con io_uring le io_uring_enter, che fanno tutto l'I/O del loop)
+static atomic_ullong statRisposte = 0;
+static atomic_ullong statSyscall  = 0;
+
 // Tracciamento connessioni attive per chiusura pulita (spegnimento)
-static int            conn_sd_list[MAX_THREAD];             // -1 = libero, altrimenti sd attivo
+static int*           conn_sd_list = NULL;                  // -1 = libero, altrimenti sd attivo
 static pthread_mutex_t mtx_conns;
 
 // ==================== Prototipi ====================
 static void* threadConnessione(void* arg);
-static void  gestisciConnessione(int conn_sd, struct GiocatoreStato* gioc);
+static void  gestisciConnessione(int conn_sd, int slot);
+
+static void  sessioneInit(struct Sessione* s, int conn_sd, int slot, struct Reattore* loop);
+static void  sessioneAvvia(struct Sessione* s);
+static size_t sessioneAttesa(const struct Sessione* s, const char* buf, size_t len);
+static int   sessioneFrame(struct Sessione* s, const char* frame, size_t len);
+static void  sessioneChiudi(struct Sessione* s);
+static void  sessioneCompatta(struct Sessione* s);
+static int   sessioneInvia(struct Sessione* s, const void* buf, size_t len);
+static int   sessioneInviaVettore(struct Sessione* s, struct iovec* iov, int n);
+static int   sessioneScarica(struct Sessione* s);
+static void  segnalaStato(void);
+
+static int   registroInit(int capienza);
+static struct Sessione* registroInserisci(struct Sessione* s);
+static void  registroRimuovi(struct Sessione* s);
+
+static int   avviaReattori(void);
+static void* threadReattore(void* arg);
+static void* threadAnello(struct Reattore* r);
+static struct Anello* anelloCrea(void);
+static void  anelloDistruggi(struct Anello* a);
+static void  anelloRiprendi(void);
+static void  anelloRicevi(struct Sessione* s);
+static void  anelloInvia(struct Sessione* s);
+static void  anelloAnnullaFd(struct Anello* a, int fd);
+static void  reattoreChiudi(struct Sessione* s);
+
+// Controllo di ammissione
+static int   ammissioneInit(void);
+static int   ammettiConnessione(int conn_sd);
+static int   rilasciaSlot(int slot, uint64_t durata, uint64_t* arrivo);
+static int   prendiConnessione(void);
+static void  ammissioneStato(size_t* inAttesa, size_t* picco, unsigned int* attive, uint64_t* durata);
+static void  lasciaConnessione(uint64_t durata);
+static void* threadAccettazione(void* arg);
+
+// Scadenze di fase (ruota dei timer)
+static void  ruotaInit(struct RuotaTimer* w, uint64_t adesso);
+static uint64_t oraTick(void);
+static void  sessioneRiarma(struct Sessione* s);
+static void  sessioneDisarma(struct Sessione* s);
+static void  reattoreScadenze(struct Reattore* r);
+static int   reattoreAttesa(const struct Reattore* r);
+static void* threadScadenze(void* arg);
+static int   leggiScadenze(const char* arg);
 
 static int   verificaRicezione(int ret, int len);           // helper, robusto su recv()
-static void  normalizza(const char* in, char* out, size_t cap);
+static int   distanzaEntro(const char* a, size_t m, const char* b, size_t n, unsigned int k);
+
+static int   inviaClassifica(struct Sessione* s);           // show-score
 
-static void  inviaClassifica(int conn_sd);                  // show-score
-static void  inviaPunteggiRicorsivo(struct NodoPunteggio* n, int conn_sd, int* cont);
+static void  classificaInit(struct Tabellone* tab);
+static struct NodoPunteggio* classificaNuovoNodo(struct Tabellone* tab, const char* nick);
+static void  classificaInserisci(struct Tabellone* tab, struct NodoPunteggio* n);
+static void  classificaAggiorna(struct Tabellone* tab, struct NodoPunteggio* n,
+                                unsigned int punteggio, time_t finito);
+static void  classificaRimuovi(struct Tabellone* tab, struct NodoPunteggio* n);
+static unsigned int classificaRango(const struct Tabellone* tab, const struct NodoPunteggio* n);
+static struct NodoPunteggio* classificaPrimo(const struct Tabellone* tab);
 
-static int   caricaDomande(const char* percorso, struct CoppiaQ* quiz);
-static int   costruisciIndice(void);
+static int   caricaDomande(const char* percorso, struct TemaQuiz* tema);
+static int   costruisciIndice(struct Catalogo* c);
 
-static void  stampaSezioneTemi(void);
-static void  stampaSezioneOnline(void);
-static void  stampaSezioneClassifiche(void);
+static struct Tabellone* tabelloneDelTema(const char* nome);
+static struct Catalogo* catalogoCarica(uint64_t generazione);
+static struct Catalogo* catalogoDaQA(uint64_t generazione);
+static void  crcInit(void);
+static void  catalogoLibera(struct Catalogo* c);
+static int   pacchettoScrivi(const struct Catalogo* c, const char* percorso);
+static struct Catalogo* catalogoAcquisisci(void);
+static void  catalogoRilascia(struct Catalogo* c);
+static struct Catalogo* catalogoPerTema(const struct Tabellone* tab, int* idx);
+static void  catalogoRilasciaDomande(struct Catalogo* c);
+static void  catalogoPubblica(struct Catalogo* c);
+static void* osservatoreQA(void* arg);
+
+static void  stampaSezioneTemi(FILE* o, const struct Catalogo* c);
+static void  stampaSezioneOnline(FILE* o);
+static void  stampaSezioneClassifiche(FILE* o, const struct Catalogo* c);
 static void  stampaStato(void);
 
-static void* consoleWatcher(void*);                         // thread che attende 'Q' su stdin
+static void* consoleWatcher(void*);                         // thread che attende 'Q'/'R' su stdin
+
+// Rimozione dei nodi della sessione da tutte le classifiche in cui compare
+static void  rimuovi_dalle_classifiche(struct Sessione* s);
+
+// Classifiche in diretta (modalità reactor, protocollo v2)
+static inline int direttaAttiva(void);
+static void  deltaRegistra(struct Tabellone* tab, enum OpDelta op, unsigned int a, unsigned int b,
+                           const struct NodoPunteggio* n);
+static void* threadDiretta(void* arg);
+static int   direttaAvvia(struct Sessione* s);
+static void  direttaLascia(struct Sessione* s);
+static int   direttaRichiesta(struct Sessione* s, int iscrivi);
+static void  direttaConsegna(struct Reattore* r);
+
+// Stanze multigiocatore (modalità reactor, protocollo v2)
+static int   stanzaEntra(struct Sessione* s, int temaIdx);
+static int   stanzaRispondi(struct Sessione* s, const char* buffer);
+static void  stanzaEsci(struct Sessione* s);
+static void  stanzaLascia(struct Sessione* s);
+static void* threadStanze(void* arg);
+static void  stanzeConsegna(struct Reattore* r);
 
-// Rimozione completa del nickname da *tutte* le classifiche
-static void  rimuovi_dalle_classifiche(const char* nick);
+static int   persistenzaCarica(void);
+static void  persistenzaAvvia(void);
+static void  persistenzaChiudi(void);
+static void  walRegistra(struct Tabellone* tab, struct NodoPunteggio* n);
+static void  salvaRisultato(struct Sessione* s, struct Tabellone* tab, struct NodoPunteggio* n);
+static int   persistenzaRiprendi(void);
+
+static uint64_t statOra(void);
+static void  statRegistra(enum FaseStat fase, uint64_t inizio);
+static void  statConta(enum ContatoreStat c);
+static int   statAvvia(void);
+
+static int   passaggioIntestazione(void);
+static int   passaggioStato(void);
+static void  riavvioCaldo(void);
+
+static struct PoolThread* poolNuovo(void);
+static struct PoolThread* poolDelThread(void);
+static void* poolPrendi(struct ClassePool* c);
+static void  poolRendi(struct ClassePool* c, void* p);
 
 // ============================================================================
 // main
+// ----------------------------------------------------------------------------
+// Uso: ./server [-m reactor|uring|thread] [-l loop] [-c max_sessioni] [-f] [-p cartella] [-s socket]
+//               [-t login:risposta:menu] [-q coda] [-C pacchetto | -P pacchetto]
+//   -m  modalità di servizio (default reactor; uring = reactor su io_uring,
+//       con ritorno a epoll se il kernel non lo supporta)
+//   -l  numero di loop in modalità reactor/uring (default: uno per core)
+//   -c  numero massimo di sessioni contemporanee in modalità reactor
+//   -f  risposte tolleranti agli errori di battitura (distanza di edit)
+//   -p  classifiche persistenti nella cartella indicata (log + snapshot):
+//       i risultati completati restano in classifica anche dopo l'uscita
+//   -s  socket Unix delle statistiche (latenze per fase e contatori):
+//       "nc -U <socket>" restituisce testo, inviando "json" si ottiene JSON
+//   -t  scadenze per fase in secondi (default 60:180:600, 0 = nessuna):
+//       login, risposta a una domanda, inattività al menu dei temi
+//   -q  connessioni in coda oltre la capienza (default 256, 0 = nessuna):
+//       ricevono "server occupato" con posizione e attesa stimata
+//   -C  compila qa/ nel pacchetto indicato ed esce (nessun server)
+//   -P  serve temi e domande dal pacchetto indicato (mappato in sola
+//       lettura) invece che da qa/; la ricarica a caldo osserva il file
+//   (-H fd è interno: lo aggiunge il riavvio a caldo al nuovo processo)
 // ============================================================================
-int main() {
+int main(int argc, char* argv[]) {
     struct sockaddr_in addr;
     pthread_t threads[MAX_THREAD];
+    int maxSessioni = MAX_SESSIONI;
+    const char* percorsoCompila = NULL;
 
-    // --- 1) Costruzione indice temi -----------------------------------
-    if (costruisciIndice() < 0) {
-        fprintf(stderr, "[ERR] impossibile costruire indice temi da '%s'\n", QA_FOLDER);
-        return -1;
+    // --- 0) Flag da riga di comando -----------------------------------
+    int opt;
+    while ((opt = getopt(argc, argv, "m:l:c:fp:s:t:q:C:P:H:")) != -1) {
+        switch (opt) {
+        case 'm':
+            if      (strcmp(optarg, "reactor") == 0) modoReactor = 1, modoAnello = 0;
+            else if (strcmp(optarg, "uring")   == 0) modoReactor = 1, modoAnello = 1;
+            else if (strcmp(optarg, "thread")  == 0) modoReactor = 0, modoAnello = 0;
+            else { fprintf(stderr, "[ERR] modalità sconosciuta: %s\n", optarg); return -1; }
+            break;
+        case 'l': numLoop     = atoi(optarg); break;
+        case 'c': maxSessioni = atoi(optarg); break;
+        case 'f': modoTollerante = 1; break;
+        case 'p': dirPersistenza = optarg; break;
+        case 's': percorsoStat   = optarg; break;
+        case 'q': codaMax = atoi(optarg); if (codaMax < 0) codaMax = 0; break;
+        case 't':
+            if (leggiScadenze(optarg) < 0) { fprintf(stderr, "[ERR] scadenze non valide: %s (login:risposta:menu)\n", optarg); return -1; }
+            break;
+        case 'C': percorsoCompila   = optarg; break;
+        case 'P': percorsoPacchetto = optarg; break;
+        case 'H': fdPassaggio    = atoi(optarg); break;
+        default:
+            fprintf(stderr, "Uso: %s [-m reactor|uring|thread] [-l loop] [-c max_sessioni] [-f] [-p cartella] [-s socket] [-t login:risposta:menu] [-q coda] [-C pacchetto | -P pacchetto]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (maxSessioni <= 0) maxSessioni = MAX_SESSIONI;
+    if (numLoop <= 0) {
+        long nc = sysconf(_SC_NPROCESSORS_ONLN);
+        numLoop = (nc > 0) ? (int)nc : 1;
     }
 
-    // --- 2) Caricamento domande da file -------------------------------
-    char path[MaxReadQuestL + sizeof(QA_FOLDER)];
-    for (int i = 0; i < numTemi; i++) {
-
-        // path "qa/<nome>.txt"
-        snprintf(path, sizeof(path), "%s%s.txt", QA_FOLDER, temiQuiz[i].nome);
+    crcInit();                                  // log, snapshot e pacchetto domande
 
-        if (caricaDomande(path, temiQuiz[i].quiz) < 0) {
-            fprintf(stderr, "[ERR] lettura domande fallita: %s\n", path);
+    // --- 0a) Solo compilazione del pacchetto domande -------------------
+    if (percorsoCompila) {
+        struct Catalogo* c = catalogoDaQA(1);
+        if (!c) return -1;
+        if (pacchettoScrivi(c, percorsoCompila) < 0) {
+            fprintf(stderr, "[ERR] pacchetto '%s': %s\n", percorsoCompila, strerror(errno));
             return -1;
         }
-
+        size_t domande = 0;
+        for (int i = 0; i < c->numTemi; i++) domande += c->temi[i].numDomande;
+        printf("Pacchetto %s: %d temi, %zu domande\n", percorsoCompila, c->numTemi, domande);
+        catalogoLibera(c);
+        return 0;
     }
 
-    // --- 3) Socket di ascolto -----------------------------------------
-    sd_ascolto = socket(AF_INET, SOCK_STREAM, 0);
-    if (sd_ascolto < 0) { perror("socket"); return -1; }
+    statAvvio = statOra();
+    argcAvvio = argc;
+    argvAvvio = argv;
+    if (fdPassaggio >= 0) {
+        if (!modoReactor) { fprintf(stderr, "[ERR] -H richiede la modalità reactor\n"); return -1; }
+        if (passaggioIntestazione() < 0) return -1;
+    }
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port   = htons(SERVER_PORT);
-    inet_pton(AF_INET, IPADDR, &addr.sin_addr);
+    // --- 0b) Classifiche persistenti: snapshot + coda del log ----------
+    // (dopo un riavvio a caldo le classifiche arrivano dal vecchio processo)
+    if (dirPersistenza) {
+        if ((fdPassaggio >= 0 ? persistenzaRiprendi() : persistenzaCarica()) < 0) return -1;
+        persistenzaAvvia();
+    }
 
-    if (bind(sd_ascolto, (struct sockaddr*)&addr, sizeof(addr)) < 0) { perror("bind"); return -1; }
-    if (listen(sd_ascolto, MAX_THREAD + 5) < 0) { perror("listen"); return -1; }
+    // --- 1-2) Indice temi e domande da file (primo catalogo) ---------
+    struct Catalogo* primo = catalogoCarica(1);
+    if (!primo) return -1;
+    catalogoPubblica(primo);
 
     // Init protezioni
-    pthread_mutex_init(&mtx_sd, NULL);
     pthread_mutex_init(&mtx_players, NULL);
-    pthread_mutex_init(&mtx_score, NULL);
-    pthread_cond_init(&cond_score, NULL);
     pthread_mutex_init(&mtx_conns, NULL);
 
     // Inizializza slot giocatori e tabella connessioni
-    for (int i = 0; i < MAX_THREAD; i++) {
+    numSlot      = modoReactor ? maxSessioni : MAX_THREAD;
+    giocatori    = (struct GiocatoreStato*)calloc(numSlot, sizeof(*giocatori));
+    conn_sd_list = (int*)malloc(numSlot * sizeof(*conn_sd_list));
+    slotLiberi   = (int*)malloc(numSlot * sizeof(*slotLiberi));
+    sessioniSlot = (struct Sessione**)calloc(numSlot, sizeof(*sessioniSlot));
+    if (!giocatori || !conn_sd_list || !slotLiberi || !sessioniSlot) { perror("malloc"); return -1; }
+    if (registroInit(numSlot) < 0 || ammissioneInit() < 0) { perror("malloc"); return -1; }
+    for (int i = 0; i < numSlot; i++) {
         giocatori[i].nome[0] = '\0';
-        giocatori[i].temaCorr = NULL;
+        atomic_init(&giocatori[i].temaCorr, NULL);
         conn_sd_list[i] = -1;
+        slotLiberi[numLiberi++] = numSlot - 1 - i;     // pop restituisce prima lo slot 0
     }
-    for (int i = 0; i < numTemi; i++) {
-        pthread_mutex_init(&tabelloni[i].lock, NULL);
+
+    // --- 3) Socket di ascolto -----------------------------------------
+    if (modoReactor) {
+        if (avviaReattori() < 0) return -1;
+        if (fdPassaggio >= 0 && passaggioStato() < 0) return -1;
+    } else {
+        sd_ascolto = socket(AF_INET, SOCK_STREAM, 0);
+        if (sd_ascolto < 0) { perror("socket"); return -1; }
+        int on = 1;
+        setsockopt(sd_ascolto, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port   = htons(SERVER_PORT);
+        inet_pton(AF_INET, IPADDR, &addr.sin_addr);
+
+        if (bind(sd_ascolto, (struct sockaddr*)&addr, sizeof(addr)) < 0) { perror("bind"); return -1; }
+        if (listen(sd_ascolto, SOMAXCONN) < 0) { perror("listen"); return -1; }
     }
 
     // Banner iniziale e prima stampa stato
@@ -188,55 +1162,239 @@ int main() {
     fflush(stdout);
     stampaStato();
 
-    // --- 4) Thread console: shutdown 'Q' -------------------------------
+    // --- 4) Thread console: shutdown 'Q', riavvio a caldo 'R' ----------
     pthread_t t_console;
     pthread_create(&t_console, NULL, consoleWatcher, NULL);
 
-    // --- 5) Avvio worker thread ---------------------------------------
-    for (int i = 0; i < MAX_THREAD; i++) {
-        int* idx = (int*)malloc(sizeof(int));
-        *idx = i;
-        pthread_create(&threads[i], NULL, threadConnessione, idx);
-    }
+    // --- 4b) Thread di ricarica a caldo di qa/ --------------------------
+    pthread_t t_qa;
+    pthread_create(&t_qa, NULL, osservatoreQA, NULL);
 
-    // --- 6) Loop di ristampa stato -----------------------------------
-    while (1) {
-        // attesa richiesta di refresh (alzata dai worker)
-        pthread_mutex_lock(&mtx_score);
+    // --- 4c) Socket delle statistiche ----------------------------------
+    if (percorsoStat && statAvvia() < 0) return -1;
 
-        while (!flag_stampa) pthread_cond_wait(&cond_score, &mtx_score);
+    // --- 5) Avvio worker thread / loop epoll ---------------------------
+    if (modoReactor) {
+        if (modoAnello) anelloRiprendi();
+        for (int i = 0; i < numLoop; i++) {
+            pthread_create(&reattori[i].tid, NULL, threadReattore, &reattori[i]);
+        }
+        pthread_t t_diretta, t_stanze;
+        pthread_create(&t_diretta, NULL, threadDiretta, NULL);
+        pthread_create(&t_stanze, NULL, threadStanze, NULL);
+    } else {
+        ruotaInit(&ruotaThread, oraTick());
+        pthread_t t_scadenze;
+        pthread_create(&t_scadenze, NULL, threadScadenze, NULL);
+        for (int i = 0; i < MAX_THREAD; i++) {
+            int* idx = (int*)malloc(sizeof(int));
+            *idx = i;
+            pthread_create(&threads[i], NULL, threadConnessione, idx);
+        }
+        pthread_t t_accetta;
+        pthread_create(&t_accetta, NULL, threadAccettazione, NULL);
+    }
 
-        flag_stampa = 0;                           // consumo richiesta
+    // --- 6) Loop di ristampa stato (renderer) ------------------------
+    // Al massimo STAMPA_HZ ridisegni al secondo: più segnalazioni arrivate
+    // nello stesso intervallo producono un solo ridisegno.
+    unsigned int ultima = atomic_load(&seqStato);
+    while (1) {
+        usleep(1000000 / STAMPA_HZ);
 
-        pthread_mutex_unlock(&mtx_score);
+        unsigned int seq = atomic_load(&seqStato);
+        if (seq == ultima) continue;               // nulla di nuovo
+        if (atomic_load(&riavvio)) continue;       // schermo del nuovo processo
+        ultima = seq;
 
         // stampa le tre sezioni richieste
         stampaStato();
-
-        // sblocca il worker che ha richiesto la stampa (handshake)
-        pthread_mutex_lock(&mtx_score);
-        pthread_cond_signal(&cond_score);
-        pthread_mutex_unlock(&mtx_score);
     }
     return 0;
 }
 
 // ============================================================================
-// threadConnessione
+// Controllo di ammissione: ammettiConnessione / rilasciaSlot
+// ----------------------------------------------------------------------------
+// Oltre la capienza (slot del reactor, worker della modalità thread) una
+// nuova connessione non resta muta nel backlog: riceve subito PROTO_OCCUPATO
+// + FR_OCCUPATO con la posizione in coda e l'attesa stimata, e aspetta in
+// una coda FIFO di al più codaMax socket (flag -q). Oltre la coda riceve
+// posizione 0 e viene chiusa. Lo stato vive sotto mtx_players, come la pila
+// degli slot liberi:
+//  - reactor: chi libera uno slot lo cede direttamente alla prima connessione
+//    in coda (e la adotta nel proprio loop);
+//  - thread: la coda contiene anche le connessioni che un worker libero
+//    prenderà subito; solo quelle oltre i worker liberi sono "in attesa".
+// La stima usa la durata media delle sessioni (media mobile esponenziale):
+// posizione * durata / capienza.
 // ============================================================================
-static void* threadConnessione(void* arg) {
-    int idx = *(int*)arg; 
-    free(arg);
+static void inviaOccupato(int conn_sd, uint64_t posizione, uint64_t attesaMs) {
+    uint8_t buf[2 + PROTO_MAX_INTEST + 20];
+    uint8_t carico[20];
+    size_t lenCarico = protoCodificaNumero(carico, posizione);
+    lenCarico += protoCodificaNumero(carico + lenCarico, attesaMs);
 
-    while (1) {
-        // accept serializzato (un solo thread alla volta)
-        pthread_mutex_lock(&mtx_sd);
-        int conn_sd = accept(sd_ascolto, NULL, NULL);
-        pthread_mutex_unlock(&mtx_sd);
+    uint16_t pre = htons(PROTO_OCCUPATO);
+    memcpy(buf, &pre, sizeof(pre));
+    buf[2] = FR_OCCUPATO;
+    size_t len = 3 + protoCodificaNumero(buf + 3, lenCarico);
+    memcpy(buf + len, carico, lenCarico);
+    len += lenCarico;
+    // socket appena accettato: il buffer di invio è vuoto, non si blocca
+    if (send(conn_sd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT) < 0) { /* il client se n'è già andato */ }
+}
+
+// Attesa stimata (ms) per chi è alla posizione data (mtx_players acquisito)
+static uint64_t stimaAttesa(uint64_t posizione) {
+    return posizione * amm.durataMedia / (uint64_t)numSlot / 1000000ull;
+}
+
+// Connessioni senza posto davanti a una nuova (+1): > 0 = deve attendere
+static long posizioneNuova(void) {
+    long liberi = modoReactor ? numLiberi : MAX_THREAD - (long)amm.attivi;
+    return (long)amm.num + 1 - liberi;
+}
+
+static void codaAccoda(int conn_sd, uint64_t arrivo) {
+    size_t i = (amm.testa + amm.num) % amm.cap;
+    amm.coda[i]   = conn_sd;
+    amm.arrivo[i] = arrivo;
+    amm.num++;
+    if (amm.num > amm.picco) amm.picco = amm.num;
+}
+
+static int codaEstrai(uint64_t* arrivo) {
+    int sd = amm.coda[amm.testa];
+    *arrivo = amm.arrivo[amm.testa];
+    amm.testa = (amm.testa + 1) % amm.cap;
+    amm.num--;
+    return sd;
+}
+
+static int ammissioneInit(void) {
+    // modalità thread: anche le connessioni per i worker liberi passano dalla coda
+    amm.cap    = (size_t)codaMax + (modoReactor ? 0 : MAX_THREAD) + 1;
+    amm.coda   = (int*)malloc(amm.cap * sizeof(*amm.coda));
+    amm.arrivo = (uint64_t*)malloc(amm.cap * sizeof(*amm.arrivo));
+    return (amm.coda && amm.arrivo) ? 0 : -1;
+}
+
+// Nuova connessione: restituisce lo slot assegnato (solo reactor), oppure -1
+// se la connessione è passata alla coda o è stata rifiutata (il socket non
+// appartiene più al chiamante). In modalità thread ritorna sempre -1.
+static int ammettiConnessione(int conn_sd) {
+    int slot = -1, rifiutata = 0;
+    pthread_mutex_lock(&mtx_players);
+    long pos = posizioneNuova();
+    if (pos <= 0 && modoReactor) {
+        slot = slotLiberi[--numLiberi];
+    } else if (pos <= 0) {
+        codaAccoda(conn_sd, 0);                     // un worker è libero
+        pthread_cond_signal(&amm.pronta);
+    } else if (pos <= codaMax) {
+        // il frame parte sotto il lock: nessuno può estrarre la connessione
+        // e inviare il preambolo prima di lui
+        inviaOccupato(conn_sd, (uint64_t)pos, stimaAttesa((uint64_t)pos));
+        codaAccoda(conn_sd, statOra());
+        statConta(CONT_IN_CODA);
+    } else {
+        inviaOccupato(conn_sd, 0, stimaAttesa((uint64_t)pos));
+        rifiutata = 1;
+    }
+    pthread_mutex_unlock(&mtx_players);
+
+    if (rifiutata) {
+        statConta(CONT_RIFIUTATE);
+        close(conn_sd);
+    }
+    return slot;
+}
+
+// Durata di una sessione conclusa (mtx_players acquisito)
+static void ammissioneDurata(uint64_t durata) {
+    amm.durataMedia = amm.durataMedia ? (amm.durataMedia * 7 + durata) / 8 : durata;
+}
+
+// Reactor: restituisce uno slot. Se c'è una connessione in coda lo slot passa
+// a lei: ritorna il suo socket (e l'istante di arrivo), da adottare con lo
+// stesso slot; altrimenti -1. durata: della sessione chiusa (0 = nessuna).
+static int rilasciaSlot(int slot, uint64_t durata, uint64_t* arrivo) {
+    int sd = -1;
+    pthread_mutex_lock(&mtx_players);
+    if (durata) ammissioneDurata(durata);
+    if (amm.num > 0) sd = codaEstrai(arrivo);
+    else             slotLiberi[numLiberi++] = slot;
+    pthread_mutex_unlock(&mtx_players);
+    return sd;
+}
+
+// Modalità thread: il worker attende la prossima connessione (-1 allo shutdown)
+static int prendiConnessione(void) {
+    uint64_t arrivo = 0;
+    int sd = -1;
+    pthread_mutex_lock(&mtx_players);
+    while (amm.num == 0 && !atomic_load(&server_shutdown))
+        pthread_cond_wait(&amm.pronta, &mtx_players);
+    if (amm.num > 0) {
+        sd = codaEstrai(&arrivo);
+        amm.attivi++;
+    }
+    pthread_mutex_unlock(&mtx_players);
+    if (arrivo) statRegistra(STAT_CODA, arrivo);
+    return sd;
+}
+
+static void lasciaConnessione(uint64_t durata) {
+    pthread_mutex_lock(&mtx_players);
+    amm.attivi--;
+    ammissioneDurata(durata);
+    pthread_mutex_unlock(&mtx_players);
+}
+
+// Istantanea per statistiche e dashboard: connessioni in attesa di un
+// posto, picco della coda, sessioni in corso, durata media (ns)
+static void ammissioneStato(size_t* inAttesa, size_t* picco, unsigned int* attive, uint64_t* durata) {
+    pthread_mutex_lock(&mtx_players);
+    long attesa = posizioneNuova() - 1;
+    *inAttesa = attesa > 0 ? (size_t)attesa : 0;
+    *picco    = amm.picco;
+    *attive   = modoReactor ? (unsigned int)(numSlot - numLiberi) : amm.attivi;
+    *durata   = amm.durataMedia;
+    pthread_mutex_unlock(&mtx_players);
+}
+
+// Modalità thread: un solo thread accetta, i worker prendono dalla coda
+static void* threadAccettazione(void* arg) {
+    (void)arg;
+    while (!atomic_load(&server_shutdown)) {
+        int conn_sd = accept4(sd_ascolto, NULL, NULL, SOCK_CLOEXEC);
         if (conn_sd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
             if (atomic_load(&server_shutdown)) break;
+            if (errno == EMFILE || errno == ENFILE) usleep(10 * 1000);      // niente descrittori: si riprova
             continue;
         }
+        ammettiConnessione(conn_sd);
+    }
+    pthread_mutex_lock(&mtx_players);
+    pthread_cond_broadcast(&amm.pronta);
+    pthread_mutex_unlock(&mtx_players);
+    return NULL;
+}
+
+// ============================================================================
+// threadConnessione (modalità thread)
+// ============================================================================
+static void* threadConnessione(void* arg) {
+    int idx = *(int*)arg; 
+    free(arg);
+
+    while (1) {
+        // prossima connessione dalla coda di ammissione (accettata da threadAccettazione)
+        int conn_sd = prendiConnessione();
+        if (conn_sd < 0) break;
+        uint64_t t0 = statOra();
 
         // registra la connessione per chiusura "gentile" allo shutdown
         pthread_mutex_lock(&mtx_conns);
@@ -244,13 +1402,14 @@ static void* threadConnessione(void* arg) {
         pthread_mutex_unlock(&mtx_conns);
 
         // esegue protocollo di sessione
-        gestisciConnessione(conn_sd, &giocatori[idx]);
+        gestisciConnessione(conn_sd, idx);
 
         // chiude e deregistra
         close(conn_sd);
         pthread_mutex_lock(&mtx_conns);
         conn_sd_list[idx] = -1;
         pthread_mutex_unlock(&mtx_conns);
+        lasciaConnessione(statOra() - t0);
 
         if (atomic_load(&server_shutdown)) break;
     }
@@ -258,340 +1417,3902 @@ static void* threadConnessione(void* arg) {
 }
 
 // ============================================================================
-// normalizza
+// Modalità reactor: avviaReattori / threadReattore
 // ----------------------------------------------------------------------------
-// Confronto più tollerante per le risposte.
-// - Converte in minuscolo.
-// - Ignora TUTTI i whitespace.
-// - Ignora caratteri non-ASCII (es. apostrofo tipografico ’, lettere accentate).
-// - Ignora punteggiatura e simboli vari: conserva solo [a-z0-9].
-// Serve tutto a evitare i mismatch per piccolezze o spazi o punteggiatura.
-// ============================================================================
-static void normalizza(const char* in, char* out, size_t cap) {
-    size_t k = 0;
-    for (const unsigned char* p = (const unsigned char*)in; *p && k + 1 < cap; ++p) {
-        unsigned char c = *p;
-        if (isspace(c)) continue;                 // ignora spazi/TAB/CR/LF
-        if (c & 0x80) continue;                   // ignora byte non-ASCII
-        c = (unsigned char)tolower(c);
-        if (isalnum(c)) out[k++] = (char)c;       // tieni solo [a-z0-9]
+// Ogni loop possiede un socket di ascolto non bloccante con SO_REUSEPORT e un
+// descrittore epoll. Tutti i socket sono registrati edge-triggered: ad ogni
+// notifica si legge/scrive finché il kernel non risponde EAGAIN.
+// ============================================================================
+static int apriAscoltoReuseport(void) {
+    int sd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sd < 0) { perror("socket"); return -1; }
+
+    int on = 1;
+    setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));    // riavvio con TIME_WAIT pendenti
+    if (setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        perror("setsockopt SO_REUSEPORT"); close(sd); return -1;
     }
-    out[k] = '\0';
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(SERVER_PORT);
+    inet_pton(AF_INET, IPADDR, &addr.sin_addr);
+
+    if (bind(sd, (struct sockaddr*)&addr, sizeof(addr)) < 0) { perror("bind"); close(sd); return -1; }
+    if (listen(sd, SOMAXCONN) < 0) { perror("listen"); close(sd); return -1; }
+    return sd;
 }
 
-// ============================================================================
-// gestisciConnessione (protocollo completo)
-// ============================================================================
-static void gestisciConnessione(int conn_sd, struct GiocatoreStato* gioc) {
-    uint16_t netNum;
-    int ret;
-    char buffer[MaxReadQuestL];
-    char nick_attuale[MaxUsernameL] = {0};
+static int avviaReattori(void) {
+    // dopo un riavvio a caldo si riusano tutti i socket di ascolto ereditati:
+    // chiuderne uno perderebbe le connessioni nella sua coda
+    if (numEreditati > numLoop) numLoop = numEreditati;
+    reattori = (struct Reattore*)calloc(numLoop, sizeof(*reattori));
+    if (!reattori) { perror("calloc"); return -1; }
 
-    // --- (1) invia numero di temi disponibili -------------------------
-    netNum = htons(numTemi);
-    send(conn_sd, &netNum, sizeof(netNum), MSG_NOSIGNAL);
+    svegliaLoop = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (svegliaLoop < 0) { perror("eventfd"); return -1; }
 
-    // --- (2) login/validazione nickname -------------------------------
-    do {
-        // riceve nickname (lunghezza fissa MaxUsernameL come da protocollo)
-        ret = recv(conn_sd, buffer, MaxUsernameL, MSG_WAITALL);
-        if (verificaRicezione(ret, MaxUsernameL) != 0) goto fine;
+    // io_uring: un anello per loop, o nessuno (si torna a epoll per tutti)
+    for (int i = 0; modoAnello && i < numLoop; i++) {
+        if ((reattori[i].anello = anelloCrea())) continue;
+        fprintf(stderr, "[io_uring] non disponibile (%s): modalità reactor con epoll\n", strerror(errno));
+        for (int k = 0; k < i; k++) { anelloDistruggi(reattori[k].anello); reattori[k].anello = NULL; }
+        modoAnello = 0;
+    }
 
-        // comandi “fuori sessione quiz”
-        if (strcmp(buffer, ShowScore) == 0) { inviaClassifica(conn_sd); continue; }
-        if (strcmp(buffer, EndQuiz)   == 0) { goto fine; }
+    for (int i = 0; i < numLoop; i++) {
+        struct Reattore* r = &reattori[i];
+        r->id = i;
+        r->sd_ascolto = (i < numEreditati) ? ascoltoEreditati[i] : apriAscoltoReuseport();
+        if (r->sd_ascolto < 0) return -1;
 
-        // controllo univocità tra gli slot attivi (giocatori[]):
-        int ok = 1;
-        pthread_mutex_lock(&mtx_players);
-        for (int i = 0; i < MAX_THREAD; i++) {
-            if (&giocatori[i] != gioc &&
-                giocatori[i].nome[0] != '\0' &&
-                strcmp(giocatori[i].nome, buffer) == 0) {
-                ok = 0; 
-                break;
-            }
+        r->pool = poolNuovo();
+        if (!r->pool) { perror("calloc"); return -1; }
+        ruotaInit(&r->ruota, oraTick());
+        r->posta = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (r->posta < 0) { perror("eventfd"); return -1; }
+        pthread_mutex_init(&r->mtxPosta, NULL);
+
+        r->ep = -1;
+        if (r->anello) continue;                // ascolto, posta e risveglio: anelloRiprendi
+        r->ep = epoll_create1(EPOLL_CLOEXEC);
+        if (r->ep < 0) { perror("epoll_create1"); return -1; }
+
+        // data.ptr == NULL identifica il socket di ascolto, &svegliaLoop il risveglio,
+        // r la posta (diretta e stanze)
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLET, .data.ptr = NULL };
+        if (epoll_ctl(r->ep, EPOLL_CTL_ADD, r->sd_ascolto, &ev) < 0) { perror("epoll_ctl"); return -1; }
+        struct epoll_event sv = { .events = EPOLLIN | EPOLLET, .data.ptr = &svegliaLoop };
+        if (epoll_ctl(r->ep, EPOLL_CTL_ADD, svegliaLoop, &sv) < 0) { perror("epoll_ctl"); return -1; }
+        struct epoll_event pv = { .events = EPOLLIN | EPOLLET, .data.ptr = r };
+        if (epoll_ctl(r->ep, EPOLL_CTL_ADD, r->posta, &pv) < 0) { perror("epoll_ctl"); return -1; }
+    }
+    return 0;
+}
+
+// Prende uno slot online libero (-1 se il server è pieno), senza passare
+// dalla coda di ammissione (sessioni ricevute da un riavvio a caldo)
+static int prendiSlot(void) {
+    int slot = -1;
+    pthread_mutex_lock(&mtx_players);
+    if (numLiberi > 0) slot = slotLiberi[--numLiberi];
+    pthread_mutex_unlock(&mtx_players);
+    return slot;
+}
+
+// Memoria e socket di una sessione chiusa, senza più operazioni in volo
+static void reattoreRilascia(struct Sessione* s) {
+    free(s->outVolo);
+    s->outVolo = NULL;
+    close(s->conn_sd);
+    poolRendi(&s->loop->pool->sessioni, s);             // sempre al pool del proprio loop
+}
+
+// Chiude connessione e sessione, tranne lo slot (resta al chiamante)
+static void reattoreScarta(struct Sessione* s) {
+    sessioneDisarma(s);
+    if (s->inviando) {                          // io_uring: la send in volo legge ancora out
+        if (s->outVolo) free(s->out);
+        else s->outVolo = s->out;
+        s->out = NULL;
+    }
+    sessioneChiudi(s);
+    if (!s->loop->anello) epoll_ctl(s->loop->ep, EPOLL_CTL_DEL, s->conn_sd, NULL);
+
+    pthread_mutex_lock(&mtx_conns);
+    conn_sd_list[s->slot] = -1;
+    pthread_mutex_unlock(&mtx_conns);
+    sessioniSlot[s->slot] = NULL;
+
+    // io_uring: socket e memoria restano finché il kernel non ha finito
+    if (s->ricevendo || s->inviando) {
+        s->chiusa = 1;
+        anelloAnnullaFd(s->loop->anello, s->conn_sd);
+        return;
+    }
+    reattoreRilascia(s);
+}
+
+static struct Sessione* reattoreApri(struct Reattore* r, int conn_sd, int slot);
+
+// Restituisce lo slot; se c'è una connessione in coda il loop la adotta
+// (il preambolo parte al primo EPOLLOUT, o con la send preparata da
+// reattoreApri). durata: della sessione chiusa.
+static void reattoreLiberaSlot(struct Reattore* r, int slot, uint64_t durata) {
+    uint64_t arrivo;
+    int sd;
+    while ((sd = rilasciaSlot(slot, durata, &arrivo)) >= 0) {
+        durata = 0;
+        statRegistra(STAT_CODA, arrivo);
+        if (reattoreApri(r, sd, slot)) return;
+    }
+}
+
+// Chiusura completa di una connessione del reactor (cleanup di sessione incluso)
+static void reattoreChiudi(struct Sessione* s) {
+    struct Reattore* r = s->loop;
+    int slot = s->slot;
+    uint64_t durata = statOra() - s->inizio;
+    reattoreScarta(s);
+    reattoreLiberaSlot(r, slot, durata);
+}
+
+// Flag comuni ai socket di connessione: le risposte partono già accorpate,
+// quindi Nagle aggiungerebbe solo attesa (interazione con il delayed ACK)
+static void impostaConnessione(int conn_sd) {
+    int on = 1;
+    setsockopt(conn_sd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+// Consuma i frame completi già ricevuti, riempiendo il buffer dalla riserva.
+// Con la coda di uscita oltre USCITA_MAX si ferma (s->pausa).
+// Ritorna -1 se la connessione è da chiudere.
+static int reattoreConsuma(struct Sessione* s) {
+    while (1) {
+        size_t off = 0;
+        s->pausa = 0;
+        while (s->fase != FASE_CHIUSA) {
+            if (s->outLen - s->outOff > USCITA_MAX) { s->pausa = 1; break; }
+            size_t need = sessioneAttesa(s, s->in + off, s->inLen - off);
+            if (need == 0) { s->fase = FASE_CHIUSA; break; }        // frame non valido
+            if (s->inLen - off < need) break;
+            if (sessioneFrame(s, s->in + off, need)) s->fase = FASE_CHIUSA;
+            off += need;
+        }
+        if (off) { memmove(s->in, s->in + off, s->inLen - off); s->inLen -= off; }
+        if (s->fase == FASE_CHIUSA) return -1;
+        if (off) sessioneRiarma(s);                             // frame completi: la sessione avanza
+        if (s->pausa || s->riservaLen == 0) return 0;
+
+        size_t n = s->riservaLen;
+        if (n > sizeof(s->in) - s->inLen) n = sizeof(s->in) - s->inLen;
+        if (n == 0 && off == 0) return 0;
+        memcpy(s->in + s->inLen, s->riserva, n);
+        memmove(s->riserva, s->riserva + n, s->riservaLen - n);
+        s->inLen += n;
+        s->riservaLen -= n;
+    }
+}
+
+// Accoda alla riserva byte ricevuti che non si possono ancora consumare
+static int sessioneRiserva(struct Sessione* s, const char* dati, size_t len) {
+    if (s->riservaLen + len > s->riservaCap) {
+        size_t cap = s->riservaCap ? s->riservaCap : DIM_INGRESSO;
+        while (cap < s->riservaLen + len) cap *= 2;
+        char* nuovo = (char*)realloc(s->riserva, cap);
+        if (!nuovo) return -1;
+        s->riserva = nuovo; s->riservaCap = cap;
+    }
+    memcpy(s->riserva + s->riservaLen, dati, len);
+    s->riservaLen += len;
+    return 0;
+}
+
+// Consuma i frame completi già ricevuti, poi legge tutto il disponibile.
+// Con la coda di uscita oltre USCITA_MAX si ferma (s->pausa): il resto resta
+// nel buffer o nel socket finché il client non smaltisce le risposte.
+// Con io_uring non legge: i dati arrivano dalla recv multishot.
+// Ritorna -1 se la connessione è da chiudere.
+static int reattoreLeggi(struct Sessione* s) {
+    while (1) {
+        if (reattoreConsuma(s) < 0) return -1;
+        if (s->pausa || s->loop->anello) return 0;
+
+        ssize_t n = recv(s->conn_sd, s->in + s->inLen, sizeof(s->in) - s->inLen, 0);
+        if (n == 0) return -1;                                  // peer chiuso
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        s->inLen += (size_t)n;
+    }
+}
+
+// Registra il socket nel loop: epoll edge-triggered, o recv multishot
+static int reattoreRegistra(struct Reattore* r, struct Sessione* s) {
+    if (r->anello) { anelloRicevi(s); return 0; }
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = s };
+    return epoll_ctl(r->ep, EPOLL_CTL_ADD, s->conn_sd, &ev);
+}
+
+// Sessione di conn_sd nello slot, registrata nel loop e con il preambolo in
+// coda; NULL se non si può (socket chiuso, lo slot resta al chiamante)
+static struct Sessione* reattoreApri(struct Reattore* r, int conn_sd, int slot) {
+    struct Sessione* s = (struct Sessione*)poolPrendi(&r->pool->sessioni);      // thread del loop
+    if (!s) { close(conn_sd); return NULL; }
+    sessioneInit(s, conn_sd, slot, r);
+    impostaConnessione(conn_sd);
+
+    pthread_mutex_lock(&mtx_conns);
+    conn_sd_list[slot] = conn_sd;
+    pthread_mutex_unlock(&mtx_conns);
+    sessioniSlot[slot] = s;
+
+    if (reattoreRegistra(r, s) < 0) { reattoreScarta(s); return NULL; }
+
+    sessioneAvvia(s);
+    sessioneRiarma(s);
+    if (r->anello) anelloInvia(s);              // nessun EPOLLOUT: la send si prepara subito
+    return s;
+}
+
+// Connessione appena accettata: ammissione, sessione, preambolo
+static void reattoreNuova(struct Reattore* r, int conn_sd) {
+    uint64_t t0 = statOra();
+    statConta(CONT_CONNESSIONI);
+
+    int slot = ammettiConnessione(conn_sd);
+    if (slot < 0) return;                               // in coda o rifiutata
+    struct Sessione* s = reattoreApri(r, conn_sd, slot);
+    if (!s) { reattoreLiberaSlot(r, slot, 0); return; }
+    if (sessioneScarica(s) < 0) { reattoreChiudi(s); return; }
+    statRegistra(STAT_ACCETTA, t0);
+}
+
+static void reattoreAccetta(struct Reattore* r) {
+    while (1) {
+        int conn_sd = accept4(r->sd_ascolto, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (conn_sd < 0) {
+            if (errno == EINTR) continue;
+            return;                                     // EAGAIN o errore: si riprova al prossimo evento
+        }
+        reattoreNuova(r, conn_sd);
+    }
+}
+
+static void* threadReattore(void* arg) {
+    struct Reattore* r = (struct Reattore*)arg;
+    struct epoll_event ev[MAX_EVENTI];
+    poolLocale = r->pool;                       // anche dopo un riavvio annullato (nuovo thread)
+    if (r->anello) return threadAnello(r);
+
+    while (!atomic_load(&server_shutdown) && !atomic_load(&riavvio)) {
+        int n = epoll_wait(r->ep, ev, MAX_EVENTI, reattoreAttesa(r));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        int posta = 0;
+        for (int i = 0; i < n; i++) {
+            if (ev[i].data.ptr == NULL) { reattoreAccetta(r); continue; }
+            if (ev[i].data.ptr == &svegliaLoop) continue;          // riavvio: esce dopo il lotto
+            if (ev[i].data.ptr == r) { posta = 1; continue; }
+
+            struct Sessione* s = (struct Sessione*)ev[i].data.ptr;
+            int chiudi = 0;
+            if (ev[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                chiudi = reattoreLeggi(s) < 0;
+            if (!chiudi)
+                chiudi = sessioneScarica(s) < 0;
+
+            // coda smaltita dopo una pausa: si riprendono i frame in attesa
+            // (finché il socket accetta tutto, EPOLLOUT non arriverebbe più)
+            while (!chiudi && s->pausa && s->outLen - s->outOff <= USCITA_MAX)
+                chiudi = reattoreLeggi(s) < 0 || sessioneScarica(s) < 0;
+            if (chiudi) reattoreChiudi(s);
+        }
+        // dopo il lotto: consegna e scadenze possono chiudere sessioni con eventi ancora in ev
+        if (posta) {
+            uint64_t v;
+            while (read(r->posta, &v, sizeof(v)) > 0) ;
+            direttaConsegna(r);
+            stanzeConsegna(r);
+        }
+        reattoreScadenze(r);
+    }
+    return NULL;
+}
+
+// ============================================================================
+// Modalità io_uring (-m uring): anelloCrea / threadAnello
+// ----------------------------------------------------------------------------
+// Gli stessi loop del reactor (socket SO_REUSEPORT, posta, ruota dei timer),
+// ma l'I/O passa da un anello io_uring per loop, con le syscall dirette:
+//  - accept multishot sul socket di ascolto, poll multishot su posta e
+//    risveglio: una sottomissione vale per tutte le notifiche successive;
+//  - recv multishot per connessione con buffer scelti dal kernel nel buffer
+//    ring del loop: i byte si copiano in s->in e il buffer torna subito
+//    all'anello, quindi ANELLO_BUFFER basta per qualsiasi numero di
+//    connessioni (se finiscono, la recv termina con ENOBUFS e si riarma);
+//  - una send per connessione alla volta, dell'intera coda di uscita: le
+//    risposte accodate mentre è in volo partono con la successiva.
+// Ogni giro del loop è una sola io_uring_enter, che sottomette tutto ciò che
+// il giro ha preparato e attende le completion con il timeout della ruota:
+// le syscall non crescono con le connessioni servite nel giro.
+// user_data: sessione (o NULL) con il tipo di operazione nei 3 bit bassi.
+// Una sessione chiusa con operazioni in volo (s->chiusa) tiene memoria e
+// socket, perché il numero del descrittore non venga riusato, fino
+// all'ultima completion. Nel riavvio a caldo il loop annulla tutto e
+// attende che l'anello sia vuoto prima di fermarsi: i socket passano al
+// nuovo processo senza letture pendenti nel vecchio.
+// ============================================================================
+enum OpAnello { OP_ACCETTA = 1, OP_RICEVI, OP_INVIA, OP_POSTA, OP_SVEGLIA, OP_ANNULLA };
+#define OP_MASCHERA 7
+
+static int anelloRegistra(int fd, unsigned op, void* arg, unsigned num) {
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, num);
+}
+
+static void anelloRendiBuffer(struct Anello* a, unsigned bid) {
+    struct io_uring_buf* b = &a->buf->bufs[a->bufCoda & (ANELLO_BUFFER - 1)];
+    b->addr = (uint64_t)(uintptr_t)(a->bufDati + (size_t)bid * ANELLO_DIM_BUF);
+    b->len  = ANELLO_DIM_BUF;
+    b->bid  = (uint16_t)bid;
+    a->bufCoda++;
+    __atomic_store_n(&a->buf->tail, a->bufCoda, __ATOMIC_RELEASE);
+}
+
+// Anello con code mappate e buffer ring registrato; NULL (errno impostato)
+// se il kernel non offre tutto quello che serve al loop
+static struct Anello* anelloCrea(void) {
+    struct Anello* a = (struct Anello*)calloc(1, sizeof(*a));
+    if (!a) return NULL;
+    a->fd = -1;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags      = IORING_SETUP_CQSIZE;
+    p.cq_entries = ANELLO_VOCI * 4;             // multishot: più completion per sottomissione
+    a->fd = (int)syscall(__NR_io_uring_setup, ANELLO_VOCI, &p);
+    if (a->fd < 0) goto errore;
+    unsigned servono = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((p.features & servono) != servono) { errno = ENOSYS; goto errore; }
+
+    size_t lenSq = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t lenCq = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    a->lenMappa = lenSq > lenCq ? lenSq : lenCq;
+    a->lenSqe   = p.sq_entries * sizeof(struct io_uring_sqe);
+    a->mappa = mmap(NULL, a->lenMappa, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->fd, IORING_OFF_SQ_RING);
+    if (a->mappa == MAP_FAILED) { a->mappa = NULL; goto errore; }
+    a->sqe = (struct io_uring_sqe*)mmap(NULL, a->lenSqe, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, a->fd, IORING_OFF_SQES);
+    if (a->sqe == MAP_FAILED) { a->sqe = NULL; goto errore; }
+
+    char* m = (char*)a->mappa;
+    a->sqTesta    = (unsigned*)(m + p.sq_off.head);
+    a->sqCodaK    = (unsigned*)(m + p.sq_off.tail);
+    a->sqMaschera = *(unsigned*)(m + p.sq_off.ring_mask);
+    a->sqVoci     = p.sq_entries;
+    a->sqCoda     = *a->sqCodaK;
+    unsigned* vettore = (unsigned*)(m + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++) vettore[i] = i;   // voce i nello slot i, sempre
+    a->cqTesta    = (unsigned*)(m + p.cq_off.head);
+    a->cqCoda     = (unsigned*)(m + p.cq_off.tail);
+    a->cqMaschera = *(unsigned*)(m + p.cq_off.ring_mask);
+    a->cqe        = (struct io_uring_cqe*)(m + p.cq_off.cqes);
+
+    // operazioni usate; SEND_ZC (6.0) arriva con la recv multishot, che
+    // invece non si può interrogare
+    static const int usate[] = { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND,
+                                 IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL, IORING_OP_SEND_ZC };
+    struct io_uring_probe* pr = (struct io_uring_probe*)calloc(1, sizeof(*pr) + 256 * sizeof(struct io_uring_probe_op));
+    if (!pr) goto errore;
+    int esito = anelloRegistra(a->fd, IORING_REGISTER_PROBE, pr, 256);
+    for (size_t i = 0; esito == 0 && i < sizeof(usate) / sizeof(usate[0]); i++)
+        if (usate[i] > pr->last_op || !(pr->ops[usate[i]].flags & IO_URING_OP_SUPPORTED)) { errno = ENOSYS; esito = -1; }
+    free(pr);
+    if (esito < 0) goto errore;
+
+    a->buf = (struct io_uring_buf_ring*)mmap(NULL, ANELLO_BUFFER * sizeof(struct io_uring_buf),
+                                             PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (a->buf == MAP_FAILED) { a->buf = NULL; goto errore; }
+    a->bufDati = (char*)malloc((size_t)ANELLO_BUFFER * ANELLO_DIM_BUF);
+    if (!a->bufDati) goto errore;
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (uint64_t)(uintptr_t)a->buf;
+    reg.ring_entries = ANELLO_BUFFER;
+    reg.bgid         = 0;
+    if (anelloRegistra(a->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) goto errore;
+    for (unsigned bid = 0; bid < ANELLO_BUFFER; bid++) anelloRendiBuffer(a, bid);
+    return a;
+
+errore:;
+    int e = errno;
+    anelloDistruggi(a);
+    errno = e;
+    return NULL;
+}
+
+static void anelloDistruggi(struct Anello* a) {
+    if (!a) return;
+    if (a->fd >= 0) close(a->fd);
+    if (a->mappa) munmap(a->mappa, a->lenMappa);
+    if (a->sqe) munmap(a->sqe, a->lenSqe);
+    if (a->buf) munmap(a->buf, ANELLO_BUFFER * sizeof(struct io_uring_buf));
+    free(a->bufDati);
+    free(a);
+}
+
+// Pubblica le voci preparate; con aspetta attende anche almeno una
+// completion, per al massimo ms millisecondi (-1 = senza limite)
+static int anelloEntra(struct Anello* a, int aspetta, int ms) {
+    __atomic_store_n(a->sqCodaK, a->sqCoda, __ATOMIC_RELEASE);
+    unsigned daInviare = a->sqCoda - __atomic_load_n(a->sqTesta, __ATOMIC_ACQUIRE);
+    if (!aspetta && daInviare == 0) return 0;
+
+    struct __kernel_timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long long)(ms % 1000) * 1000000 };
+    struct io_uring_getevents_arg arg = { .sigmask_sz = _NSIG / 8,
+                                          .ts = (ms >= 0) ? (uint64_t)(uintptr_t)&ts : 0 };
+    unsigned flag = IORING_ENTER_EXT_ARG | (aspetta ? IORING_ENTER_GETEVENTS : 0);
+    int n = (int)syscall(__NR_io_uring_enter, a->fd, daInviare, aspetta ? 1 : 0, flag, &arg, sizeof(arg));
+    atomic_fetch_add_explicit(&statSyscall, 1, memory_order_relaxed);
+    if (n < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN) return -1;
+    return 0;
+}
+
+// Nuova voce nella coda di sottomissione (con la coda piena si sottomette
+// subito quanto preparato finora)
+static struct io_uring_sqe* anelloVoce(struct Anello* a, uint8_t op, int fd, void* ptr, int tipo) {
+    while (a->sqCoda - __atomic_load_n(a->sqTesta, __ATOMIC_ACQUIRE) >= a->sqVoci)
+        if (anelloEntra(a, 0, 0) < 0) perror("io_uring_enter");
+    struct io_uring_sqe* e = &a->sqe[a->sqCoda & a->sqMaschera];
+    memset(e, 0, sizeof(*e));
+    e->opcode    = op;
+    e->fd        = fd;
+    e->user_data = (uint64_t)(uintptr_t)ptr | (uint64_t)tipo;
+    a->sqCoda++;
+    a->volo++;
+    return e;
+}
+
+static void anelloAccetta(struct Reattore* r) {
+    if (r->anello->fermo) return;
+    struct io_uring_sqe* e = anelloVoce(r->anello, IORING_OP_ACCEPT, r->sd_ascolto, NULL, OP_ACCETTA);
+    e->ioprio       = IORING_ACCEPT_MULTISHOT;
+    e->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+}
+
+static void anelloSorveglia(struct Anello* a, int fd, int tipo) {
+    if (a->fermo) return;
+    struct io_uring_sqe* e = anelloVoce(a, IORING_OP_POLL_ADD, fd, NULL, tipo);
+    e->len         = IORING_POLL_ADD_MULTI;
+    e->poll32_events = POLLIN;
+}
+
+// Arma la recv multishot della sessione (se non lo è già)
+static void anelloRicevi(struct Sessione* s) {
+    struct Anello* a = s->loop->anello;
+    if (a->fermo || s->ricevendo || s->chiusa) return;
+    struct io_uring_sqe* e = anelloVoce(a, IORING_OP_RECV, s->conn_sd, s, OP_RICEVI);
+    e->ioprio    = IORING_RECV_MULTISHOT;
+    e->flags     = IOSQE_BUFFER_SELECT;
+    e->buf_group = 0;
+    s->ricevendo = 1;
+}
+
+// Prepara la send della coda di uscita, se non ce n'è già una in volo
+static void anelloInvia(struct Sessione* s) {
+    struct Anello* a = s->loop->anello;
+    if (a->fermo || s->inviando || s->chiusa || s->outOff == s->outLen) return;
+    struct io_uring_sqe* e = anelloVoce(a, IORING_OP_SEND, s->conn_sd, s, OP_INVIA);
+    e->addr      = (uint64_t)(uintptr_t)(s->out + s->outOff);
+    e->len       = (uint32_t)(s->outLen - s->outOff);
+    e->msg_flags = MSG_NOSIGNAL;
+    s->inviando  = e->len;
+}
+
+// Annulla tutte le operazioni sul socket (sessione chiusa)
+static void anelloAnnullaFd(struct Anello* a, int fd) {
+    struct io_uring_sqe* e = anelloVoce(a, IORING_OP_ASYNC_CANCEL, fd, NULL, OP_ANNULLA);
+    e->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+}
+
+// Byte di una recv: nel buffer di ingresso a frame completi, nella riserva
+// se la sessione è in pausa. Ritorna -1 se la connessione è da chiudere.
+static int anelloDati(struct Sessione* s, const char* dati, size_t len) {
+    if (s->pausa || s->riservaLen) {
+        if (sessioneRiserva(s, dati, len) < 0) return -1;
+        return s->pausa ? 0 : reattoreConsuma(s);
+    }
+    while (len > 0) {
+        size_t n = sizeof(s->in) - s->inLen;
+        if (n > len) n = len;
+        memcpy(s->in + s->inLen, dati, n);
+        s->inLen += n;
+        dati += n; len -= n;
+        if (reattoreConsuma(s) < 0) return -1;
+        if (len && (s->pausa || n == 0)) return sessioneRiserva(s, dati, len);
+    }
+    return 0;
+}
+
+static void anelloRicevuti(struct Sessione* s, const struct io_uring_cqe* c, int ultima) {
+    struct Anello* a = s->loop->anello;
+    int chiudi = 0;
+    if (ultima) s->ricevendo = 0;
+    if (c->flags & IORING_CQE_F_BUFFER) {
+        unsigned bid = c->flags >> IORING_CQE_BUFFER_SHIFT;
+        if (!s->chiusa && c->res > 0)
+            chiudi = anelloDati(s, a->bufDati + (size_t)bid * ANELLO_DIM_BUF, (size_t)c->res) < 0;
+        anelloRendiBuffer(a, bid);
+    }
+    if (s->chiusa) {
+        if (!s->ricevendo && !s->inviando) reattoreRilascia(s);
+        return;
+    }
+    if (c->res == 0 || (c->res < 0 && c->res != -ENOBUFS && c->res != -ECANCELED)) chiudi = 1;
+
+    if (!chiudi && s->pausa && s->ricevendo == 1) {            // coda di uscita piena: smette di leggere
+        struct io_uring_sqe* e = anelloVoce(a, IORING_OP_ASYNC_CANCEL, -1, NULL, OP_ANNULLA);
+        e->addr = (uint64_t)(uintptr_t)s | OP_RICEVI;
+        s->ricevendo = 2;
+    }
+    if (!chiudi && !s->pausa) anelloRicevi(s);                 // multishot terminata (ENOBUFS...)
+    if (!chiudi) chiudi = sessioneScarica(s) < 0;
+    if (chiudi) reattoreChiudi(s);
+}
+
+static void anelloInviati(struct Sessione* s, const struct io_uring_cqe* c) {
+    s->inviando = 0;
+    free(s->outVolo);
+    s->outVolo = NULL;
+    if (s->chiusa) {
+        if (!s->ricevendo) reattoreRilascia(s);
+        return;
+    }
+    if (c->res == -ECANCELED && s->loop->anello->fermo) return;   // riavvio: la coda passa intera
+    if (c->res < 0) { reattoreChiudi(s); return; }
+
+    s->outOff += (size_t)c->res;
+    if (s->outOff == s->outLen) s->outOff = s->outLen = 0;
+    else sessioneCompatta(s);
+    int chiudi = 0;
+    // coda smaltita dopo una pausa: si riprendono i frame in attesa e la recv
+    if (s->pausa && s->outLen - s->outOff <= USCITA_MAX) {
+        chiudi = reattoreConsuma(s) < 0;
+        if (!chiudi && !s->pausa) anelloRicevi(s);
+    }
+    if (!chiudi) chiudi = sessioneScarica(s) < 0;
+    if (chiudi) reattoreChiudi(s);
+}
+
+// Elabora tutte le completion disponibili; ritorna 1 se è arrivata posta
+static int anelloRaccogli(struct Reattore* r) {
+    struct Anello* a = r->anello;
+    int posta = 0;
+    unsigned testa = *a->cqTesta;
+    while (testa != __atomic_load_n(a->cqCoda, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe c = a->cqe[testa & a->cqMaschera];
+        __atomic_store_n(a->cqTesta, ++testa, __ATOMIC_RELEASE);
+
+        int ultima = !(c.flags & IORING_CQE_F_MORE);
+        if (ultima) a->volo--;
+        void* ptr = (void*)(uintptr_t)(c.user_data & ~(uint64_t)OP_MASCHERA);
+        switch ((int)(c.user_data & OP_MASCHERA)) {
+        case OP_ACCETTA:
+            if (c.res >= 0) reattoreNuova(r, c.res);
+            if (ultima) anelloAccetta(r);
+            break;
+        case OP_POSTA:
+            posta = 1;
+            if (ultima) anelloSorveglia(a, r->posta, OP_POSTA);
+            break;
+        case OP_SVEGLIA:                                            // riavvio: esce dopo il giro
+            if (ultima) anelloSorveglia(a, svegliaLoop, OP_SVEGLIA);
+            break;
+        case OP_RICEVI: anelloRicevuti((struct Sessione*)ptr, &c, ultima); break;
+        case OP_INVIA:  anelloInviati((struct Sessione*)ptr, &c); break;
+        default: break;                                             // esito di un annullamento
+        }
+    }
+    return posta;
+}
+
+// Arma le operazioni permanenti di ogni loop e riprende le sessioni aperte
+// (ricevute da un riavvio a caldo, o ferme per un passaggio non riuscito).
+// Loop fermi: si chiama prima di avviarne i thread.
+static void anelloRiprendi(void) {
+    for (int i = 0; i < numLoop; i++) {
+        struct Reattore* r = &reattori[i];
+        r->anello->fermo = 0;
+        anelloAccetta(r);
+        anelloSorveglia(r->anello, r->posta, OP_POSTA);
+        anelloSorveglia(r->anello, svegliaLoop, OP_SVEGLIA);
+    }
+    for (int i = 0; i < numSlot; i++) {
+        struct Sessione* s = sessioniSlot[i];
+        if (!s) continue;
+        if (!s->pausa) anelloRicevi(s);
+        anelloInvia(s);
+    }
+}
+
+static void* threadAnello(struct Reattore* r) {
+    struct Anello* a = r->anello;
+    while (!atomic_load(&server_shutdown) && !atomic_load(&riavvio)) {
+        if (anelloEntra(a, 1, reattoreAttesa(r)) < 0) { perror("io_uring_enter"); break; }
+
+        // dopo il giro: consegna e scadenze possono chiudere sessioni con completion già elaborate
+        if (anelloRaccogli(r)) {
+            uint64_t v;
+            while (read(r->posta, &v, sizeof(v)) > 0) ;
+            direttaConsegna(r);
+            stanzeConsegna(r);
+        }
+        reattoreScadenze(r);
+    }
+    if (atomic_load(&server_shutdown)) return NULL;
+
+    // riavvio a caldo: il kernel non deve più leggere dai socket né accettare
+    // connessioni che passano al nuovo processo
+    a->fermo = 1;
+    struct io_uring_sqe* e = anelloVoce(a, IORING_OP_ASYNC_CANCEL, -1, NULL, OP_ANNULLA);
+    e->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    while (a->volo > 0) {
+        if (anelloEntra(a, 1, -1) < 0) { perror("io_uring_enter"); break; }
+        anelloRaccogli(r);
+    }
+    return NULL;
+}
+
+// ============================================================================
+// distanzaEntro
+// ----------------------------------------------------------------------------
+// 1 se la distanza di edit (Levenshtein) tra a (m <= 64) e b è al massimo k.
+// Algoritmo bit-parallelo di Myers nella formulazione di Hyyrö: una colonna
+// della matrice di programmazione dinamica sta in due parole (Pv/Mv = delta
+// verticali +1/-1), ogni carattere di b costa poche operazioni su 64 bit.
+// Peq si azzera solo sui caratteri che compaiono, niente memset di 2 KB.
+// ============================================================================
+static int distanzaEntro(const char* a, size_t m, const char* b, size_t n, unsigned int k) {
+    if ((m > n ? m - n : n - m) > k) return 0;            // differenza di lunghezza
+    if (m == 0) return n <= k;
+    if (m > 64) return m == n && memcmp(a, b, m) == 0;    // oltre una parola: solo esatto
+
+    uint64_t peq[256];
+    for (size_t i = 0; i < m; i++) peq[(unsigned char)a[i]] = 0;
+    for (size_t j = 0; j < n; j++) peq[(unsigned char)b[j]] = 0;
+    for (size_t i = 0; i < m; i++) peq[(unsigned char)a[i]] |= 1ull << i;
+
+    uint64_t pv = ~0ull, mv = 0, ultimo = 1ull << (m - 1);
+    size_t punti = m;
+    for (size_t j = 0; j < n; j++) {
+        uint64_t eq = peq[(unsigned char)b[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & ultimo) punti++;
+        else if (mh & ultimo) punti--;
+        ph = (ph << 1) | 1;                                 // riga 0: D[0][j] = j
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        if (punti > k + (n - 1 - j)) return 0;              // non può più scendere a k
+    }
+    return punti <= k;
+}
+
+// ============================================================================
+// Scadenze di fase: ruota dei timer gerarchica
+// ----------------------------------------------------------------------------
+// Ogni sessione ha al più un timer armato: la scadenza della fase in cui si
+// trova (login, risposta, menu temi), riarmata ad ogni frame completo.
+// Un client che non scrive, scrive un byte alla volta o non legge le
+// risposte non completa frame, quindi scade comunque.
+//  - reactor: una ruota per loop, avanzata dal loop stesso dopo ogni lotto
+//    di eventi (epoll_wait attende al più fino al tick successivo); la
+//    sessione scaduta si chiude con reattoreChiudi.
+//  - thread: una ruota condivisa sotto mtx_ruota, avanzata da threadScadenze;
+//    alla scadenza shutdown() sblocca il worker dentro recv/send, che esce
+//    dal ciclo e ripulisce la sessione come per una disconnessione.
+// ============================================================================
+static uint64_t oraTick(void) {
+    return statOra() / (1000000ull * RUOTA_TICK_MS);
+}
+
+static void ruotaInit(struct RuotaTimer* w, uint64_t adesso) {
+    w->adesso = adesso;
+    w->armati = 0;
+    for (int k = 0; k < RUOTA_LIVELLI; k++)
+        for (int i = 0; i < (1 << RUOTA_BIT); i++)
+            w->slot[k][i].prec = w->slot[k][i].succ = &w->slot[k][i];
+}
+
+static void timerScollega(struct Timer* t) {
+    t->prec->succ = t->succ;
+    t->succ->prec = t->prec;
+    t->prec = t->succ = NULL;
+}
+
+// Inserisce t nello slot che lo contiene: livello scelto dalla distanza,
+// indice dai bit assoluti della scadenza
+static void ruotaInserisci(struct RuotaTimer* w, struct Timer* t) {
+    uint64_t maxDist = (1ull << (RUOTA_BIT * RUOTA_LIVELLI)) - 1;
+    if (t->scadenza < w->adesso) t->scadenza = w->adesso;
+    if (t->scadenza - w->adesso > maxDist) t->scadenza = w->adesso + maxDist;
+
+    uint64_t dist = t->scadenza - w->adesso;
+    int k = 0;
+    while (k < RUOTA_LIVELLI - 1 && (dist >> (RUOTA_BIT * (k + 1))) != 0) k++;
+    struct Timer* testa = &w->slot[k][(t->scadenza >> (RUOTA_BIT * k)) & ((1 << RUOTA_BIT) - 1)];
+
+    t->succ = testa;
+    t->prec = testa->prec;
+    testa->prec->succ = t;
+    testa->prec = t;
+}
+
+static void ruotaArma(struct RuotaTimer* w, struct Timer* t, uint64_t scadenza) {
+    if (t->succ) timerScollega(t);
+    else         w->armati++;
+    t->scadenza = scadenza;
+    ruotaInserisci(w, t);
+}
+
+static void ruotaDisarma(struct RuotaTimer* w, struct Timer* t) {
+    if (!t->succ) return;
+    timerScollega(t);
+    w->armati--;
+}
+
+// Elabora i tick fino a fino (incluso): cascata dei livelli superiori che
+// compiono un giro, poi scadenza dello slot corrente del livello 0.
+// scaduto() riceve il timer già disarmato e può armare/disarmare altri timer.
+static void ruotaAvanza(struct RuotaTimer* w, uint64_t fino,
+                        void (*scaduto)(struct Timer* t, void* ctx), void* ctx) {
+    const uint64_t maschera = (1 << RUOTA_BIT) - 1;
+    if (w->armati == 0 && w->adesso <= fino) w->adesso = fino + 1;    // niente da elaborare
+
+    while (w->adesso <= fino) {
+        uint64_t ora = w->adesso;
+        for (int k = 1; k < RUOTA_LIVELLI && (ora & ((1ull << (RUOTA_BIT * k)) - 1)) == 0; k++) {
+            struct Timer* testa = &w->slot[k][(ora >> (RUOTA_BIT * k)) & maschera];
+            while (testa->succ != testa) {
+                struct Timer* t = testa->succ;
+                timerScollega(t);
+                ruotaInserisci(w, t);
+            }
+        }
+
+        // lo slot si stacca prima delle callback: i timer riarmati ora
+        // finiscono nel giro successivo, non in questo
+        struct Timer scadute;
+        struct Timer* testa = &w->slot[0][ora & maschera];
+        if (testa->succ != testa) {
+            scadute.succ = testa->succ;
+            scadute.prec = testa->prec;
+            scadute.succ->prec = scadute.prec->succ = &scadute;
+            testa->succ = testa->prec = testa;
+        } else {
+            scadute.succ = scadute.prec = &scadute;
+        }
+        w->adesso = ora + 1;
+
+        while (scadute.succ != &scadute) {
+            struct Timer* t = scadute.succ;
+            timerScollega(t);
+            w->armati--;
+            scaduto(t, ctx);
+        }
+        if (w->armati == 0 && w->adesso <= fino) w->adesso = fino + 1;
+    }
+}
+
+static struct Sessione* sessioneDelTimer(struct Timer* t) {
+    return (struct Sessione*)((char*)t - offsetof(struct Sessione, scad));
+}
+
+// Scadenza della fase corrente (0 = nessuna): chi segue la diretta al menu
+// non è inattivo
+static unsigned int scadenzaSessione(const struct Sessione* s) {
+    if (s->fase >= FASE_CHIUSA) return 0;
+    if (s->fase == FASE_COMANDO && s->cursori) return 0;
+    return scadenzaFase[s->fase];
+}
+
+// Riarma la scadenza dopo un frame completo o un cambio di fase
+static void sessioneRiarma(struct Sessione* s) {
+    unsigned int sec = scadenzaSessione(s);
+    struct RuotaTimer* w = s->loop ? &s->loop->ruota : &ruotaThread;
+    if (!s->loop) pthread_mutex_lock(&mtx_ruota);
+    if (sec) ruotaArma(w, &s->scad, oraTick() + (uint64_t)sec * 1000 / RUOTA_TICK_MS);
+    else     ruotaDisarma(w, &s->scad);
+    if (!s->loop) pthread_mutex_unlock(&mtx_ruota);
+}
+
+static void sessioneDisarma(struct Sessione* s) {
+    struct RuotaTimer* w = s->loop ? &s->loop->ruota : &ruotaThread;
+    if (!s->loop) pthread_mutex_lock(&mtx_ruota);
+    ruotaDisarma(w, &s->scad);
+    if (!s->loop) pthread_mutex_unlock(&mtx_ruota);
+}
+
+static void scadutaReattore(struct Timer* t, void* ctx) {
+    (void)ctx;
+    statConta(CONT_SCADUTE);
+    reattoreChiudi(sessioneDelTimer(t));
+}
+
+// Loop: scadenze maturate (dopo il lotto di eventi, come la posta)
+static void reattoreScadenze(struct Reattore* r) {
+    ruotaAvanza(&r->ruota, oraTick(), scadutaReattore, NULL);
+}
+
+// Timeout di epoll_wait: fino al prossimo tick se ci sono timer armati
+static int reattoreAttesa(const struct Reattore* r) {
+    if (r->ruota.armati == 0) return -1;
+    uint64_t ms = statOra() / 1000000ull;
+    uint64_t prossimo = r->ruota.adesso * RUOTA_TICK_MS;
+    return prossimo > ms ? (int)(prossimo - ms) : 0;
+}
+
+// Modalità thread: la sessione vive sullo stack del worker, che la disarma
+// (sotto mtx_ruota) prima di ripulirla; qui si tocca solo il socket
+static void scadutaThread(struct Timer* t, void* ctx) {
+    (void)ctx;
+    statConta(CONT_SCADUTE);
+    shutdown(sessioneDelTimer(t)->conn_sd, SHUT_RDWR);
+}
+
+static void* threadScadenze(void* arg) {
+    (void)arg;
+    while (!atomic_load(&server_shutdown)) {
+        usleep(RUOTA_TICK_MS * 1000);
+        pthread_mutex_lock(&mtx_ruota);
+        ruotaAvanza(&ruotaThread, oraTick(), scadutaThread, NULL);
+        pthread_mutex_unlock(&mtx_ruota);
+    }
+    return NULL;
+}
+
+// "login:risposta:menu" in secondi (flag -t); 0 disattiva la scadenza
+static int leggiScadenze(const char* arg) {
+    unsigned int login, risposta, menu;
+    char resto;
+    if (sscanf(arg, "%u:%u:%u%c", &login, &risposta, &menu, &resto) != 3) return -1;
+    scadenzaFase[FASE_LOGIN]    = login;
+    scadenzaFase[FASE_RISPOSTA] = risposta;
+    scadenzaFase[FASE_COMANDO]  = menu;
+    return 0;
+}
+
+// ============================================================================
+// gestisciConnessione (modalità thread)
+// ----------------------------------------------------------------------------
+// Driver bloccante della macchina a stati: riceve con MSG_WAITALL esattamente
+// i byte che mancano al frame atteso (in v2 prima l'intestazione, poi il
+// payload) e passa il frame completo a sessioneFrame(). La risposta di ogni
+// turno parte con un solo invio prima di tornare in ricezione.
+// ============================================================================
+static void gestisciConnessione(int conn_sd, int slot) {
+    struct Sessione s;
+    int ret;
+    size_t have = 0;
+
+    uint64_t t0 = statOra();
+    statConta(CONT_CONNESSIONI);
+    sessioneInit(&s, conn_sd, slot, NULL);
+    impostaConnessione(conn_sd);
+    sessioneAvvia(&s);
+    sessioneRiarma(&s);
+    if (sessioneScarica(&s) == 0) statRegistra(STAT_ACCETTA, t0);
+
+    while (s.fase != FASE_CHIUSA) {
+        if (sessioneScarica(&s) < 0) break;                     // fine turno: invio risposta
+        size_t need = sessioneAttesa(&s, s.in, have);
+        if (need == 0) break;                                   // frame non valido
+        if (have < need) {
+            ret = recv(conn_sd, s.in + have, need - have, MSG_WAITALL);
+            if (verificaRicezione(ret, (int)(need - have)) != 0) break;
+            have = need;
+            continue;
+        }
+        if (sessioneFrame(&s, s.in, need)) break;
+        have = 0;
+        sessioneRiarma(&s);
+    }
+
+    sessioneDisarma(&s);
+    sessioneChiudi(&s);
+}
+
+// ============================================================================
+// Macchina a stati di sessione (protocollo completo)
+// ----------------------------------------------------------------------------
+//   avvio          -> invia numero temi,               fase LOGIN
+//   LOGIN    (16B) -> nickname / comandi fuori sessione, poi elenco temi
+//                     (oppure saluto v2: da qui in poi solo frame v2)
+//   COMANDO  (2B)  -> 0 = fine, 1 = show-score, >=3 selezione tema
+//   RISPOSTA (32B) -> risposta alla domanda corrente, poi domanda successiva
+// In v2 le fasi sono le stesse, ma ogni richiesta è un frame tipizzato
+// (FR_LOGIN, FR_TEMA, FR_RISPOSTA, FR_CLASSIFICA, FR_FINE).
+// ============================================================================
+static void sessioneInit(struct Sessione* s, int conn_sd, int slot, struct Reattore* loop) {
+    memset(s, 0, sizeof(*s));
+    s->conn_sd = conn_sd;
+    s->slot    = slot;
+    s->gioc    = &giocatori[slot];
+    s->loop    = loop;
+    s->fase    = FASE_LOGIN;
+    s->versione = 1;
+    s->temaIdx = -1;
+    s->elenco  = catalogoAcquisisci();
+    s->inizio  = statOra();
+    pthread_mutex_init(&s->mtxVoci, NULL);
+
+    // seme diverso per ogni sessione, anche se aperte nello stesso istante
+    static atomic_ullong contaSessioni = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    s->rng = ((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec)
+           ^ (atomic_fetch_add(&contaSessioni, 1) << 32);
+}
+
+// Riporta in testa la parte non inviata quando il prefisso già inviato
+// supera metà buffer: un lettore che non svuota mai del tutto la coda
+// farebbe altrimenti crescere s->out senza limite (con una send io_uring
+// in volo il buffer non si tocca: si compatta al suo completamento)
+static void sessioneCompatta(struct Sessione* s) {
+    if (s->inviando || s->outOff == 0 || s->outOff < s->outCap / 2) return;
+    memmove(s->out, s->out + s->outOff, s->outLen - s->outOff);
+    s->outLen -= s->outOff;
+    s->outOff  = 0;
+}
+
+// Accoda un blocco di byte alla risposta in costruzione
+static int sessioneInvia(struct Sessione* s, const void* buf, size_t len) {
+    sessioneCompatta(s);
+    if (s->outLen + len > s->outCap) {
+        size_t cap = s->outCap ? s->outCap : 256;
+        while (cap < s->outLen + len) cap *= 2;
+        char* nuovo;
+        if (s->inviando) {                      // io_uring: il vecchio buffer serve alla send in volo
+            nuovo = (char*)malloc(cap);
+            if (!nuovo) return -1;
+            memcpy(nuovo, s->out, s->outLen);
+            if (s->outVolo) free(s->out);
+            else s->outVolo = s->out;
+        } else {
+            nuovo = (char*)realloc(s->out, cap);
+            if (!nuovo) return -1;
+        }
+        s->out = nuovo; s->outCap = cap;
+    }
+    memcpy(s->out + s->outLen, buf, len);
+    s->outLen   += len;
+    s->outNuovi += len;
+    return (int)len;
+}
+
+// Accoda più blocchi (copiati: i buffer d'origine possono essere protetti
+// da lock che non si tengono durante l'invio)
+static int sessioneInviaVettore(struct Sessione* s, struct iovec* iov, int n) {
+    for (int i = 0; i < n; i++)
+        if (sessioneInvia(s, iov[i].iov_base, iov[i].iov_len) < 0) return -1;
+    return 0;
+}
+
+// Messaggio condiviso (stanze, reactor): con la coda di uscita vuota va
+// direttamente sul socket, senza copia; il resto di un invio parziale, o
+// tutto se c'è già una coda, si accoda e attende EPOLLOUT.
+// Con io_uring si accoda sempre: le send di tutti i membri partono con la
+// stessa io_uring_enter. Ritorna -1 se la connessione è da chiudere.
+static int sessioneInviaCondiviso(struct Sessione* s, const uint8_t* dati, size_t len) {
+    if (s->loop->anello) return sessioneInvia(s, dati, len) < 0 ? -1 : sessioneScarica(s);
+    size_t off = 0;
+    int diretto = (s->outOff == s->outLen);
+    if (diretto) {
+        atomic_fetch_add_explicit(&statRisposte, 1, memory_order_relaxed);
+        while (off < len) {
+            ssize_t n = send(s->conn_sd, dati + off, len - off, MSG_NOSIGNAL);
+            atomic_fetch_add_explicit(&statSyscall, 1, memory_order_relaxed);
+            if (n > 0) { off += (size_t)n; continue; }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return -1;
+        }
+        if (off == len) return 0;
+    }
+    if (sessioneInvia(s, dati + off, len - off) < 0) return -1;
+    if (diretto) s->outNuovi -= len - off;          // già contato come risposta
+    return 0;
+}
+
+// Punto di svuotamento (fine turno): invia la coda di uscita.
+// Thread: bloccante, fino all'ultimo byte. Reactor: finché il socket accetta
+// dati, il resto attende EPOLLOUT. io_uring: prepara la send (una per volta),
+// che parte alla io_uring_enter del giro. Ritorna -1 se la connessione è da chiudere.
+static int sessioneScarica(struct Sessione* s) {
+    if (s->outNuovi) {
+        atomic_fetch_add_explicit(&statRisposte, 1, memory_order_relaxed);
+        s->outNuovi = 0;
+    }
+    if (s->outOff == s->outLen) return 0;
+    if (s->loop && s->loop->anello) { anelloInvia(s); return 0; }
+
+    uint64_t t0 = statOra();
+    while (s->outOff < s->outLen) {
+        ssize_t n = send(s->conn_sd, s->out + s->outOff, s->outLen - s->outOff, MSG_NOSIGNAL);
+        atomic_fetch_add_explicit(&statSyscall, 1, memory_order_relaxed);
+        if (n > 0) { s->outOff += (size_t)n; continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;      // attende EPOLLOUT
+        return -1;
+    }
+    statRegistra(STAT_INVIO, t0);
+    if (s->outOff == s->outLen) s->outOff = s->outLen = 0;
+    return 0;
+}
+
+// Segnala al renderer che lo stato è cambiato (non bloccante)
+static void segnalaStato(void) {
+    atomic_fetch_add_explicit(&seqStato, 1, memory_order_release);
+    statConta(CONT_SEGNALAZIONI);
+}
+
+// Byte necessari per completare il frame che inizia in buf (0 = non valido)
+static size_t sessioneAttesa(const struct Sessione* s, const char* buf, size_t len) {
+    if (s->versione == PROTO_V2)
+        return protoAttesa((const uint8_t*)buf, len, PROTO_MAX_RICHIESTA);
+
+    switch (s->fase) {
+    case FASE_LOGIN:    return MaxUsernameL;
+    case FASE_COMANDO:  return sizeof(uint16_t);
+    case FASE_RISPOSTA: return MaxReadL;
+    default:            return 0;
+    }
+}
+
+// --- (1) invia numero di temi disponibili -----------------------------
+static void sessioneAvvia(struct Sessione* s) {
+    uint16_t netNum = htons(s->elenco->numTemi);
+    sessioneInvia(s, &netNum, sizeof(netNum));
+}
+
+// Testo di domanda e risposta della domanda corrente (puntatori nell'arena)
+static const char* testoDomanda(const struct Sessione* s) {
+    const struct TemaQuiz* t = &s->cat->temi[s->temaIdx];
+    return t->arena + t->quiz[s->estratte[s->domanda]].domanda;
+}
+
+// Invia il frame v2 composto in s->tx
+static void inviaTx(struct Sessione* s) {
+    if (!s->tx.errore) sessioneInvia(s, s->tx.dati, s->tx.len);
+    s->tx.len = 0;
+    s->tx.errore = 0;
+}
+
+// Invia la domanda corrente (v1: buffer a lunghezza fissa MaxReadQuestL)
+static void inviaDomanda(struct Sessione* s) {
+    if (s->versione == PROTO_V2) {
+        const char* d = testoDomanda(s);
+        protoFrameStringa(&s->tx, FR_DOMANDA, d, strlen(d));
+        inviaTx(s);
+        return;
+    }
+    char buf[MaxReadQuestL] = {0};
+    strncpy(buf, testoDomanda(s), MaxReadQuestL - 1);
+    sessioneInvia(s, buf, MaxReadQuestL);
+}
+
+// Esito di login (v1: uint16_t) seguito, se accettato, dall'elenco dei temi
+static void inviaEsitoLogin(struct Sessione* s, int ok) {
+    const struct Catalogo* c = s->elenco;
+    if (s->versione == PROTO_V2) {
+        protoFrameNumero(&s->tx, FR_ESITO_LOGIN, ok);
+        if (ok) {
+            protoIniziaFrame(&s->tx, FR_TEMI);
+            protoNumero(&s->tx, c->numTemi);
+            for (int i = 0; i < c->numTemi; i++)
+                protoStringa(&s->tx, c->temi[i].nome, strlen(c->temi[i].nome));
+            protoChiudiFrame(&s->tx);
+        }
+        inviaTx(s);
+        return;
+    }
+
+    // rispondo col verdetto (0/1) in uint16_t rete
+    uint16_t netNum = htons(ok);
+    sessioneInvia(s, &netNum, sizeof(netNum));
+    if (!ok) return;
+
+    // --- (3) invio elenco nomi tema -----------------------------------
+    for (int i = 0; i < c->numTemi; i++) {
+        sessioneInvia(s, c->temi[i].nome, MaxReadL);
+    }
+}
+
+// Esito della risposta (0 = corretta, 1 = errata)
+static void inviaEsito(struct Sessione* s, int esito) {
+    if (s->versione == PROTO_V2) {
+        protoFrameNumero(&s->tx, FR_ESITO, esito);
+        inviaTx(s);
+        return;
+    }
+    uint16_t netNum = htons(esito);
+    sessioneInvia(s, &netNum, sizeof(netNum));
+}
+
+// PRNG splitmix64: veloce, stato di 64 bit (per sessione o per stanza)
+static uint64_t casuale(uint64_t* stato) {
+    uint64_t z = (*stato += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Estrae NumQuest domande distinte del banco in ordine casuale (solo indici)
+static void estraiDomande(uint64_t* rng, uint32_t* estratte, const struct TemaQuiz* t) {
+    for (int q = 0; q < NumQuest; q++) {
+        uint32_t k;
+        int dup;
+        do {
+            // riduzione moltiplicativa (Lemire) in [0, numDomande)
+            k = (uint32_t)(((casuale(rng) >> 32) * (uint64_t)t->numDomande) >> 32);
+            dup = 0;
+            for (int j = 0; j < q; j++) if (estratte[j] == k) { dup = 1; break; }
+        } while (dup);
+        estratte[q] = k;
+    }
+}
+
+// --- (2) login/validazione nickname -----------------------------------
+static int sessioneLogin(struct Sessione* s, const char* buffer) {
+    uint64_t t0 = statOra();
+    // controllo univocità: inserimento nel registro online solo se il nick è libero
+    strncpy(s->nick_attuale, buffer, MaxUsernameL);
+    strncpy(s->gioc->nome,   buffer, MaxUsernameL);
+    // segna “online” (temaCorr NULL finché non entra in un quiz)
+    atomic_store(&s->gioc->temaCorr, NULL);
+
+    int ok = (registroInserisci(s) == NULL);
+    if (!ok) {
+        s->nick_attuale[0] = '\0';
+        s->gioc->nome[0]   = '\0';
+    }
+
+    inviaEsitoLogin(s, ok);
+    statRegistra(STAT_LOGIN, t0);
+    if (!ok) { statConta(CONT_LOGIN_RIFIUTATI); return 0; }
+
+    // refresh "Utenti online"
+    segnalaStato();
+    s->fase = FASE_COMANDO;
+    return 0;
+}
+
+// --- (4) ciclo di gioco: selezione tema -------------------------------
+// temaIdx indica l'elenco ricevuto al login; le domande vengono dal
+// catalogo corrente, trattenuto fino alla fine del quiz
+static int sessioneScegliTema(struct Sessione* s, int temaIdx) {
+    if (temaIdx < 0 || temaIdx >= s->elenco->numTemi) return 1;  // comando non valido
+    uint64_t t0 = statOra();
+    struct Tabellone* tab = s->elenco->tabelloni[temaIdx];
+    int idx;
+    struct Catalogo* c = catalogoPerTema(tab, &idx);
+    if (!c) return 1;                                             // tema tolto da qa/
+
+    // marca lo stato: “sto svolgendo <tema>”
+    atomic_store(&s->gioc->temaCorr, tab->nomeTema);
+
+    // spazio per il riferimento al nuovo nodo (prima di toccare la classifica)
+    if (s->numVoci == s->capVoci) {
+        int cap = s->capVoci ? s->capVoci * 2 : 4;
+        pthread_mutex_lock(&s->mtxVoci);
+        struct VoceGiocatore* nv = (struct VoceGiocatore*)realloc(s->voci, cap * sizeof(*nv));
+        if (nv) { s->voci = nv; s->capVoci = cap; }
+        pthread_mutex_unlock(&s->mtxVoci);
+        if (!nv) { catalogoRilasciaDomande(c); return 1; }
+    }
+
+    // inserisce il giocatore nella classifica del tema (punteggio 0)
+    pthread_mutex_lock(&tab->lock);
+    struct NodoPunteggio* nodo = classificaNuovoNodo(tab, s->gioc->nome);
+    if (nodo) classificaInserisci(tab, nodo);
+    pthread_mutex_unlock(&tab->lock);
+    if (!nodo) { catalogoRilasciaDomande(c); return 1; }
+
+    pthread_mutex_lock(&s->mtxVoci);
+    s->voci[s->numVoci] = (struct VoceGiocatore){ .tab = tab, .nodo = nodo };
+    s->numVoci++;
+    pthread_mutex_unlock(&s->mtxVoci);
+
+    // refresh
+    segnalaStato();
+
+    // estrazione delle domande e prima domanda
+    s->cat     = c;
+    s->temaIdx = idx;
+    s->nodo    = nodo;
+    s->domanda = 0;
+    s->fase    = FASE_RISPOSTA;
+    estraiDomande(&s->rng, s->estratte, &c->temi[idx]);
+    inviaDomanda(s);
+    statRegistra(STAT_TEMA, t0);
+    return 0;
+}
+
+// Confronto con la risposta normalizzata al caricamento (vedi normalizza.h):
+// 0 = corretta (in modalità -f anche entro la soglia di q), 1 = errata
+static int rispostaErrata(const struct TemaQuiz* t, const struct CoppiaQ* q, const char* buffer) {
+    const char* attesa = t->arena + q->attesa;
+    char ricevuta[PROTO_MAX_RICHIESTA + 1];
+    normalizza(buffer, ricevuta, sizeof(ricevuta));
+    size_t len = strlen(ricevuta);
+
+    int esito = !(len == q->lenAttesa && memcmp(ricevuta, attesa, len) == 0);
+    if (esito && modoTollerante && q->soglia)
+        esito = !distanzaEntro(attesa, q->lenAttesa, ricevuta, len, q->soglia);
+    return esito;
+}
+
+// --- (5) risposta alla domanda corrente -------------------------------
+static int sessioneRispondi(struct Sessione* s, const char* buffer) {
+    uint64_t t0 = statOra();
+    struct Tabellone* tab = s->cat->tabelloni[s->temaIdx];
+    struct NodoPunteggio* nodo = s->nodo;
+
+    const struct TemaQuiz* t = &s->cat->temi[s->temaIdx];
+    int esito = rispostaErrata(t, &t->quiz[s->estratte[s->domanda]], buffer);
+
+    if (esito == 0) {
+        // +1 punto e riposizionamento in classifica, O(log n)
+        pthread_mutex_lock(&tab->lock);
+        classificaAggiorna(tab, nodo, nodo->punteggio + 1, nodo->finito);
+        pthread_mutex_unlock(&tab->lock);
+
+        pthread_mutex_lock(&s->mtxVoci);
+        s->voci[s->numVoci - 1].punteggio++;
+        pthread_mutex_unlock(&s->mtxVoci);
+    }
+
+    // refresh sezione Classifiche dopo ogni risposta
+    segnalaStato();
+
+    // invio esito (0 = corretta, 1 = errata)
+    inviaEsito(s, esito != 0);
+    statConta(esito ? CONT_ERRATE : CONT_GIUSTE);
+
+    if (++s->domanda < NumQuest) {
+        inviaDomanda(s);
+        statRegistra(STAT_RISPOSTA, t0);
+        return 0;
+    }
+
+    // quiz terminato: timestamp di fine, riordina per tie-break (parità di punteggio)
+    pthread_mutex_lock(&tab->lock);
+    classificaAggiorna(tab, nodo, nodo->punteggio, time(NULL));
+    if (dirPersistenza) salvaRisultato(s, tab, nodo);       // log + riga unica del nick
+    unsigned int rango = classificaRango(tab, nodo);
+    time_t finito = nodo->finito;
+    pthread_mutex_unlock(&tab->lock);
+
+    pthread_mutex_lock(&s->mtxVoci);
+    s->voci[s->numVoci - 1].finito      = finito;
+    s->voci[s->numVoci - 1].rangoArrivo = rango;
+    pthread_mutex_unlock(&s->mtxVoci);
+
+    // esco dal tema corrente
+    atomic_store(&s->gioc->temaCorr, NULL);
+
+    catalogoRilasciaDomande(s->cat);                // di nuovo al menu: nessun catalogo trattenuto oltre l'elenco
+    s->cat     = NULL;
+    s->temaIdx = -1;
+    s->nodo    = NULL;
+    s->fase    = FASE_COMANDO;
+
+    // refresh stato finale dopo il tema
+    segnalaStato();
+    statRegistra(STAT_RISPOSTA, t0);
+    return 0;
+}
+
+// --- frame v1 (larghezza fissa) ---------------------------------------
+static int frameLogin(struct Sessione* s, const char* frame) {
+    // saluto v2: da qui in poi solo frame tipizzati
+    if (memcmp(frame, PROTO_SALUTO, 3) == 0 && (uint8_t)frame[3] >= PROTO_V2) {
+        s->versione = PROTO_V2;
+        protoFrameNumero(&s->tx, FR_BENVENUTO, PROTO_V2);
+        inviaTx(s);
+        return 0;
+    }
+
+    char buffer[MaxUsernameL];
+    memcpy(buffer, frame, MaxUsernameL);
+    buffer[MaxUsernameL-1] = '\0';
+
+    // comandi “fuori sessione quiz”
+    if (strcmp(buffer, ShowScore) == 0) { return inviaClassifica(s) < 0; }
+    if (strcmp(buffer, EndQuiz)   == 0) { return 1; }
+
+    return sessioneLogin(s, buffer);
+}
+
+static int frameComando(struct Sessione* s, const char* frame) {
+    uint16_t netNum;
+    memcpy(&netNum, frame, sizeof(netNum));
+
+    // ricevo comando: 0=end 
+    // 1=showscore
+    // >=3 selezione tema
+    int cmd = ntohs(netNum);
+
+    // Fine sessione
+    if (cmd == 0) return 1;
+    if (cmd == 1) return inviaClassifica(s) < 0;
+
+    // selezione tema: protocollo usa offset +2 per i comandi, quindi:
+    //   cmd = (idTema + 2) + 1  => idTema = cmd - 3
+    return sessioneScegliTema(s, cmd - 3);
+}
+
+static int frameRisposta(struct Sessione* s, const char* frame) {
+    char buffer[MaxReadL];
+    memcpy(buffer, frame, MaxReadL);
+    buffer[MaxReadL-1] = '\0';
+
+    // comandi inline: show-score (ripete la domanda) / end
+    if (strcmp(buffer, ShowScore) == 0) {
+        if (inviaClassifica(s) < 0) return 1;
+        inviaDomanda(s);
+        return 0;
+    }
+    if (strcmp(buffer, EndQuiz)   == 0) { return 1; }
+
+    return sessioneRispondi(s, buffer);
+}
+
+// --- frame v2 (tipizzati) ----------------------------------------------
+// Ogni tipo è valido solo nella fase corrispondente; qualsiasi altra cosa
+// chiude la sessione come un comando v1 non valido.
+static int frameV2(struct Sessione* s, const char* frame, size_t len) {
+    struct ProtoLettore r;
+    protoApri(&r, (const uint8_t*)frame, len);
+    if (r.errore) return 1;
+
+    switch ((uint8_t)frame[0]) {
+    case FR_FINE:
+        return 1;
+
+    case FR_CLASSIFICA:                 // in v2 la domanda resta al client, non si ripete
+        return inviaClassifica(s) < 0;
+
+    case FR_ISCRIVI: {                  // classifiche in diretta (solo reactor)
+        uint64_t iscrivi = protoLeggiNumero(&r);
+        if (r.errore) return 1;
+        return direttaRichiesta(s, iscrivi != 0);
+    }
+
+    case FR_LOGIN: {
+        if (s->fase != FASE_LOGIN) return 1;
+        char nick[MaxUsernameL];
+        if (protoCopiaStringa(&r, nick, sizeof(nick)) <= 0) {
+            inviaEsitoLogin(s, 0);          // vuoto o troppo lungo
+            return 0;
+        }
+        return sessioneLogin(s, nick);
+    }
+
+    case FR_TEMA: {
+        if (s->fase != FASE_COMANDO) return 1;
+        uint64_t idx = protoLeggiNumero(&r);
+        if (r.errore || idx > INT_MAX) return 1;
+        return sessioneScegliTema(s, (int)idx);
+    }
+
+    case FR_RISPOSTA: {
+        if (s->fase != FASE_RISPOSTA && s->fase != FASE_STANZA) return 1;
+        char risposta[PROTO_MAX_RICHIESTA + 1];
+        if (protoCopiaStringa(&r, risposta, sizeof(risposta)) < 0) return 1;
+        if (s->fase == FASE_STANZA) return stanzaRispondi(s, risposta);
+        return sessioneRispondi(s, risposta);
+    }
+
+    case FR_STANZA: {
+        if (s->fase != FASE_COMANDO) return 1;
+        uint64_t idx = protoLeggiNumero(&r);
+        if (r.errore || idx > INT_MAX) return 1;
+        return stanzaEntra(s, (int)idx);
+    }
+
+    case FR_ESCI_STANZA:                // fuori da una stanza: la partita è già finita
+        if (s->fase == FASE_STANZA) stanzaEsci(s);
+        return 0;
+
+    default:
+        return 1;
+    }
+}
+
+// Consuma un frame completo della fase corrente.
+// Ritorna 1 se la sessione deve terminare (equivale al vecchio "goto fine").
+static int sessioneFrame(struct Sessione* s, const char* frame, size_t len) {
+    if (s->versione == PROTO_V2) return frameV2(s, frame, len);
+
+    switch (s->fase) {
+    case FASE_LOGIN:    return frameLogin(s, frame);
+    case FASE_COMANDO:  return frameComando(s, frame);
+    case FASE_RISPOSTA: return frameRisposta(s, frame);
+    default:            return 1;
+    }
+}
+
+static void sessioneChiudi(struct Sessione* s) {
+    s->fase = FASE_CHIUSA;
+
+    // Cleanup finale: cancello il nick da tutte le classifiche ed esco dal
+    // registro online. In quest'ordine: finché il nick è registrato nessun
+    // altro può completare un quiz con lo stesso nick e sostituire (con -p)
+    // una riga salvata a cui puntano ancora le voci di questa sessione.
+    rimuovi_dalle_classifiche(s);
+    registroRimuovi(s);
+    s->gioc->nome[0] = '\0';
+    atomic_store(&s->gioc->temaCorr, NULL);
+
+    direttaLascia(s);
+    stanzaLascia(s);
+    pthread_mutex_destroy(&s->mtxVoci);
+    catalogoRilasciaDomande(s->cat);
+    catalogoRilascia(s->elenco);
+    s->cat = s->elenco = NULL;
+    free(s->tx.dati);
+    memset(&s->tx, 0, sizeof(s->tx));
+    free(s->out);
+    s->out = NULL;
+    s->outLen = s->outOff = s->outCap = s->outNuovi = 0;
+    free(s->riserva);
+    s->riserva = NULL;
+    s->riservaLen = s->riservaCap = 0;
+
+    // refresh schermo
+    segnalaStato();
+}
+
+// ============================================================================
+// Registro online: registroInit / registroInserisci / registroRimuovi
+// ----------------------------------------------------------------------------
+// Hash FNV-1a del nick; il controllo di univocità al login tocca un solo
+// bucket sotto il lock della sua striscia, in O(1) atteso.
+// ============================================================================
+static uint32_t hashNick(const char* nick) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)nick; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h ? h : 1;                           // 0 è riservato a "non registrata"
+}
+
+static int registroInit(int capienza) {
+    uint32_t n = 64;
+    while (n < (uint32_t)capienza * 2) n <<= 1;
+    registro.bucket = (struct Sessione**)calloc(n, sizeof(*registro.bucket));
+    if (!registro.bucket) return -1;
+    registro.maschera = n - 1;
+    for (int k = 0; k < REG_STRISCE; k++) {
+        pthread_mutex_init(&registro.strisce[k].lock, NULL);
+        registro.strisce[k].primo = NULL;
+    }
+    return 0;
+}
+
+// Inserisce s con chiave s->nick_attuale se il nick è libero.
+// Ritorna NULL se inserita, altrimenti la sessione che già usa quel nick.
+static struct Sessione* registroInserisci(struct Sessione* s) {
+    uint32_t h = hashNick(s->nick_attuale);
+    uint32_t b = h & registro.maschera;
+    struct StrisciaRegistro* st = &registro.strisce[b % REG_STRISCE];
+
+    pthread_mutex_lock(&st->lock);
+    for (struct Sessione* x = registro.bucket[b]; x; x = x->regNext) {
+        if (x->regHash == h && strcmp(x->nick_attuale, s->nick_attuale) == 0) {
+            pthread_mutex_unlock(&st->lock);
+            return x;
+        }
+    }
+    s->regHash = h;
+    s->regNext = registro.bucket[b];
+    registro.bucket[b] = s;
+
+    s->regPrev = NULL;
+    s->regSucc = st->primo;
+    if (st->primo) st->primo->regPrev = s;
+    st->primo = s;
+    pthread_mutex_unlock(&st->lock);
+    return NULL;
+}
+
+static void registroRimuovi(struct Sessione* s) {
+    if (!s->regHash) return;                    // mai entrata nel registro
+    uint32_t b = s->regHash & registro.maschera;
+    struct StrisciaRegistro* st = &registro.strisce[b % REG_STRISCE];
+
+    pthread_mutex_lock(&st->lock);
+    struct Sessione** pp = &registro.bucket[b];
+    while (*pp && *pp != s) pp = &(*pp)->regNext;
+    if (*pp) *pp = s->regNext;
+
+    if (s->regPrev) s->regPrev->regSucc = s->regSucc; else st->primo = s->regSucc;
+    if (s->regSucc) s->regSucc->regPrev = s->regPrev;
+    pthread_mutex_unlock(&st->lock);
+
+    s->regHash = 0;
+}
+
+// ============================================================================
+// verificaRicezione
+// ============================================================================
+static int verificaRicezione(int ret, int len) {
+    if (ret == 0)             return 1;         // peer chiuso
+    if (ret < 0 || ret < len) return -1;        // errore/parziale
+    return 0;                                   // OK
+}
+
+// ============================================================================
+// Pool per thread: poolDelThread / poolPrendi / poolRendi
+// ----------------------------------------------------------------------------
+// Il pool del thread si crea al primo uso (un solo calloc). Un oggetto si
+// prende dalla lista libera, altrimenti si taglia dallo slab corrente; solo
+// quando lo slab è esaurito si chiede memoria al sistema.
+// ============================================================================
+static size_t poolArrotonda(size_t dim) {
+    return (dim + 15) & ~(size_t)15;
+}
+
+static struct PoolThread* poolNuovo(void) {
+    struct PoolThread* p = (struct PoolThread*)calloc(1, sizeof(*p));
+    if (!p) return NULL;
+    for (int i = 0; i < LIVELLI_MAX; i++)
+        p->nodi[i].dim = poolArrotonda(sizeof(struct NodoPunteggio) + (size_t)(i + 1) * sizeof(struct LivelloSkip));
+    p->sessioni.dim = poolArrotonda(sizeof(struct Sessione));
+    return p;
+}
+
+static struct PoolThread* poolDelThread(void) {
+    if (!poolLocale) poolLocale = poolNuovo();
+    return poolLocale;
+}
+
+// Solo il thread proprietario (o chiunque prima che il loop parta)
+static void* poolPrendi(struct ClassePool* c) {
+    statConta(CONT_OGGETTI_POOL);
+    if (!c->liberi && atomic_load_explicit(&c->rientri, memory_order_relaxed))
+        c->liberi = atomic_exchange_explicit(&c->rientri, NULL, memory_order_acquire);
+    struct OggettoLibero* o = c->liberi;
+    if (o) { c->liberi = o->succ; return o; }
+
+    if (c->resto < c->dim) {
+        size_t byte = (c->dim > SLAB_BYTE / 8) ? c->dim * 8 : SLAB_BYTE;   // almeno 8 oggetti per slab
+        char* slab = (char*)aligned_alloc(LINEA_CACHE, (byte + LINEA_CACHE - 1) & ~(size_t)(LINEA_CACHE - 1));
+        if (!slab) return NULL;
+        statConta(CONT_SLAB);
+        c->corrente = slab;
+        c->resto    = byte;
+    }
+    void* p = c->corrente;
+    c->corrente += c->dim;
+    c->resto    -= c->dim;
+    return p;
+}
+
+// Da qualsiasi thread: lista libera se c è del pool del chiamante,
+// altrimenti pila rientri (il proprietario la svuota in poolPrendi)
+static void poolRendi(struct ClassePool* c, void* p) {
+    if (!c) return;                                     // pool mai creato: si perde l'oggetto
+    struct OggettoLibero* o = (struct OggettoLibero*)p;
+    if (poolLocale && (char*)c >= (char*)poolLocale && (char*)c < (char*)(poolLocale + 1)) {
+        o->succ   = c->liberi;
+        c->liberi = o;
+        return;
+    }
+    o->succ = atomic_load_explicit(&c->rientri, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&c->rientri, &o->succ, o,
+                                                  memory_order_release, memory_order_relaxed)) {}
+}
+
+// ============================================================================
+// Classifica: skip list indicizzata
+// ----------------------------------------------------------------------------
+// Ogni collegamento conserva il numero di posizioni che scavalca, così
+// inserimento, rimozione, aggiornamento e rango costano O(log n) attesi.
+// Il livello 0 è una lista doppia ordinata dal migliore (testa->liv[0])
+// al peggiore (coda), percorribile in entrambe le direzioni.
+// Tutte le funzioni vanno chiamate con tab->lock acquisito.
+// ============================================================================
+
+// 1 se a precede (è migliore di) b
+static int classificaPrecede(const struct NodoPunteggio* a, const struct NodoPunteggio* b) {
+    if (a->punteggio != b->punteggio) return a->punteggio > b->punteggio;
+    if (!a->finito != !b->finito)     return a->finito != 0;       // chi ha finito, prima
+    if (a->finito != b->finito)       return a->finito < b->finito;
+    return a->ordine < b->ordine;
+}
+
+static struct NodoPunteggio* classificaAllocaNodo(int livelli) {
+    struct PoolThread* pool = poolDelThread();
+    struct NodoPunteggio* n = pool ? (struct NodoPunteggio*)poolPrendi(&pool->nodi[livelli - 1]) : NULL;
+    if (!n) return NULL;
+    memset(n, 0, sizeof(*n) + livelli * sizeof(n->liv[0]));
+    n->livelli = livelli;
+    return n;
+}
+
+static void classificaInit(struct Tabellone* tab) {
+    tab->testa     = classificaAllocaNodo(LIVELLI_MAX);
+    tab->coda      = NULL;
+    tab->livello   = 1;
+    tab->lunghezza = 0;
+    tab->seq       = 0;
+    tab->rng       = 0x9E3779B9u ^ (uint32_t)(uintptr_t)tab;
+    tab->versione  = 1;
+    tab->vistaV1   = NULL;                  // costruite alla prima richiesta
+    tab->vistaV2   = NULL;
+}
+
+// Livello casuale con p = 1/4 (xorshift32, stato per tabellone)
+static int classificaLivelloCasuale(struct Tabellone* tab) {
+    int l = 1;
+    while (l < LIVELLI_MAX) {
+        uint32_t x = tab->rng;
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        tab->rng = x;
+        if ((x & 3) != 0) break;
+        l++;
+    }
+    return l;
+}
+
+// Nuovo nodo con punteggio 0, non ancora collegato
+static struct NodoPunteggio* classificaNuovoNodo(struct Tabellone* tab, const char* nick) {
+    struct NodoPunteggio* n = classificaAllocaNodo(classificaLivelloCasuale(tab));
+    if (!n) return NULL;
+    strncpy(n->nick, nick, MaxUsernameL);
+    n->nick[MaxUsernameL-1] = '\0';
+    return n;
+}
+
+// Collega n nella posizione data da punteggio e tie-break; la restituisce (1 = primo)
+static unsigned int classificaCollega(struct Tabellone* tab, struct NodoPunteggio* n) {
+    struct NodoPunteggio* agg[LIVELLI_MAX];
+    unsigned int rango[LIVELLI_MAX];
+    struct NodoPunteggio* x = tab->testa;
+
+    n->ordine = ++tab->seq;
+    for (int i = tab->livello - 1; i >= 0; i--) {
+        rango[i] = (i == tab->livello - 1) ? 0 : rango[i + 1];
+        while (x->liv[i].avanti && classificaPrecede(x->liv[i].avanti, n)) {
+            rango[i] += x->liv[i].salto;
+            x = x->liv[i].avanti;
+        }
+        agg[i] = x;
+    }
+
+    if (n->livelli > tab->livello) {
+        for (int i = tab->livello; i < n->livelli; i++) {
+            rango[i] = 0;
+            agg[i]   = tab->testa;
+            agg[i]->liv[i].salto = tab->lunghezza;
+        }
+        tab->livello = n->livelli;
+    }
+
+    for (int i = 0; i < n->livelli; i++) {
+        n->liv[i].avanti      = agg[i]->liv[i].avanti;
+        agg[i]->liv[i].avanti = n;
+        n->liv[i].salto       = agg[i]->liv[i].salto - (rango[0] - rango[i]);
+        agg[i]->liv[i].salto  = (rango[0] - rango[i]) + 1;
+    }
+    for (int i = n->livelli; i < tab->livello; i++) agg[i]->liv[i].salto++;
+
+    n->indietro = (agg[0] == tab->testa) ? NULL : agg[0];
+    if (n->liv[0].avanti) n->liv[0].avanti->indietro = n;
+    else                  tab->coda = n;
+    tab->lunghezza++;
+    tab->versione++;
+    return rango[0] + 1;
+}
+
+static void classificaInserisci(struct Tabellone* tab, struct NodoPunteggio* n) {
+    unsigned int r = classificaCollega(tab, n);
+    if (direttaAttiva()) deltaRegistra(tab, DELTA_INSERITO, r, 0, n);
+}
+
+// Prepara c per accodare a un tabellone vuoto
+static void classificaAccodaInizio(struct Tabellone* tab, struct CodaSkip* c) {
+    for (int i = 0; i < LIVELLI_MAX; i++) { c->ultimo[i] = tab->testa; c->rango[i] = 0; }
+    c->valida = (tab->lunghezza == 0);
+}
+
+// Accoda n in fondo in O(1) (caricamento di righe già ordinate).
+// Se n non è peggiore della coda si ripiega sull'inserimento normale.
+static void classificaAccoda(struct Tabellone* tab, struct CodaSkip* c, struct NodoPunteggio* n) {
+    if (!c->valida || (tab->coda && classificaPrecede(n, tab->coda))) {
+        c->valida = 0;
+        classificaInserisci(tab, n);
+        return;
+    }
+
+    unsigned int r = tab->lunghezza + 1;            // rango di n
+    n->ordine = ++tab->seq;
+    if (n->livelli > tab->livello) tab->livello = n->livelli;
+    for (int i = 0; i < n->livelli; i++) {
+        c->ultimo[i]->liv[i].avanti = n;
+        c->ultimo[i]->liv[i].salto  = r - c->rango[i];
+        n->liv[i].avanti = NULL;
+        n->liv[i].salto  = 0;                       // collegamento a NULL: nodi dopo n
+        c->ultimo[i] = n;
+        c->rango[i]  = r;
+    }
+    for (int i = n->livelli; i < tab->livello; i++) c->ultimo[i]->liv[i].salto++;
+
+    n->indietro = tab->coda;
+    tab->coda = n;
+    tab->lunghezza++;
+    tab->versione++;
+    if (direttaAttiva()) deltaRegistra(tab, DELTA_INSERITO, r, 0, n);
+}
+
+// Scollega n (che deve essere in classifica) senza liberarlo;
+// restituisce la posizione che aveva (1 = primo)
+static unsigned int classificaScollega(struct Tabellone* tab, struct NodoPunteggio* n) {
+    struct NodoPunteggio* agg[LIVELLI_MAX];
+    struct NodoPunteggio* x = tab->testa;
+    unsigned int rango = 0;
+
+    for (int i = tab->livello - 1; i >= 0; i--) {
+        while (x->liv[i].avanti && classificaPrecede(x->liv[i].avanti, n)) {
+            rango += x->liv[i].salto;
+            x = x->liv[i].avanti;
+        }
+        agg[i] = x;
+    }
+
+    for (int i = 0; i < tab->livello; i++) {
+        if (agg[i]->liv[i].avanti == n) {
+            agg[i]->liv[i].salto += n->liv[i].salto - 1;
+            agg[i]->liv[i].avanti = n->liv[i].avanti;
+        } else {
+            agg[i]->liv[i].salto--;
+        }
+    }
+    if (n->liv[0].avanti) n->liv[0].avanti->indietro = n->indietro;
+    else                  tab->coda = n->indietro;
+
+    while (tab->livello > 1 && tab->testa->liv[tab->livello - 1].avanti == NULL) tab->livello--;
+    tab->lunghezza--;
+    tab->versione++;
+    return rango + 1;
+}
+
+// Nuovo punteggio/fine quiz: riposiziona il nodo in O(log n)
+static void classificaAggiorna(struct Tabellone* tab, struct NodoPunteggio* n,
+                               unsigned int punteggio, time_t finito) {
+    unsigned int da = classificaScollega(tab, n);
+    n->punteggio = punteggio;
+    n->finito    = finito;
+    unsigned int a = classificaCollega(tab, n);
+    if (direttaAttiva()) deltaRegistra(tab, DELTA_SPOSTATO, da, a, n);
+}
+
+// Restituisce al pool un nodo non (più) collegato
+static void classificaLibera(struct NodoPunteggio* n) {
+    struct PoolThread* pool = poolDelThread();
+    poolRendi(pool ? &pool->nodi[n->livelli - 1] : NULL, n);
+}
+
+static void classificaRimuovi(struct Tabellone* tab, struct NodoPunteggio* n) {
+    unsigned int r = classificaScollega(tab, n);
+    if (direttaAttiva()) deltaRegistra(tab, DELTA_RIMOSSO, r, 0, NULL);
+    classificaLibera(n);
+}
+
+// Posizione (1 = primo) del nodo in classifica, O(log n)
+static unsigned int classificaRango(const struct Tabellone* tab, const struct NodoPunteggio* n) {
+    unsigned int rango = 0;
+    const struct NodoPunteggio* x = tab->testa;
+    for (int i = tab->livello - 1; i >= 0; i--) {
+        while (x->liv[i].avanti &&
+               (x->liv[i].avanti == n || classificaPrecede(x->liv[i].avanti, n))) {
+            rango += x->liv[i].salto;
+            x = x->liv[i].avanti;
+        }
+        if (x == n) return rango;
+    }
+    return 0;
+}
+
+// Primo (migliore) nodo della classifica
+static struct NodoPunteggio* classificaPrimo(const struct Tabellone* tab) {
+    return tab->testa->liv[0].avanti;
+}
+
+// ============================================================================
+// inviaClassifica / classificaVista
+// ----------------------------------------------------------------------------
+// Per ogni tema: nome, numero record, coppie (nick, punteggio) dal migliore.
+// Il conteggio viaggia su 16 bit: oltre UINT16_MAX si inviano i primi.
+// Ogni tabellone pubblica la propria classifica già codificata come vista
+// immutabile con contatore di riferimenti, ricostruita solo se la versione è
+// cambiata. Il lettore tiene il lock di un tabellone alla volta, solo per
+// prendere un riferimento alla vista o copiarne le righe: codifica, copia
+// nella coda di uscita e invio avvengono senza lock, quindi né un client
+// lento né una classifica lunga rallentano chi aggiorna i punteggi. Una
+// vista sostituita si libera all'ultimo rilascio.
+// ============================================================================
+
+static struct VistaClassifica* vistaNuova(size_t len, uint64_t versione) {
+    struct VistaClassifica* v = (struct VistaClassifica*)malloc(sizeof(*v) + len);
+    if (!v) return NULL;
+    atomic_init(&v->rif, 1);                        // riferimento del tabellone
+    v->versione = versione;
+    v->len      = len;
+    return v;
+}
+
+static void vistaRilascia(struct VistaClassifica* v) {
+    if (v && atomic_fetch_sub(&v->rif, 1) == 1) free(v);
+}
+
+// Sostituisce la vista pubblicata in *slot (lock acquisito)
+static void vistaPubblica(struct VistaClassifica** slot, struct VistaClassifica* v) {
+    vistaRilascia(*slot);
+    *slot = v;
+}
+
+// Vista v1 dalle righe copiate (al più UINT16_MAX)
+static struct VistaClassifica* classificaCodifica(const char* nomeTema, const struct RigaVista* righe,
+                                                  unsigned int num, uint64_t versione) {
+    size_t len = MaxReadL + sizeof(uint16_t) + (size_t)num * (MaxReadL + sizeof(uint16_t));
+    struct VistaClassifica* v = vistaNuova(len, versione);
+    if (!v) return NULL;
+
+    char* p = (char*)v->dati;
+    memset(p, 0, MaxReadL);
+    strncpy(p, nomeTema, MaxReadL - 1);
+    p += MaxReadL;
+    uint16_t net = htons(num);
+    memcpy(p, &net, sizeof(net)); p += sizeof(net);             // numero giocatori
+
+    for (unsigned int k = 0; k < num; k++) {
+        memset(p, 0, MaxReadL);
+        memcpy(p, righe[k].nick, MaxUsernameL);
+        p += MaxReadL;
+        net = htons(righe[k].punteggio);
+        memcpy(p, &net, sizeof(net)); p += sizeof(net);
+    }
+    return v;
+}
+
+// Vista v2 del tema: nome, numero righe, (nick, punteggio) senza limite di
+// righe né padding. Si codifica nel buffer di lavoro del thread e si copia
+// in una vista della dimensione esatta
+static struct VistaClassifica* classificaCodificaV2(const char* nomeTema, const struct RigaVista* righe,
+                                                    unsigned int num, uint64_t versione) {
+    struct ProtoBuf* b = &lavoroVista;
+    b->len = 0;
+    b->errore = 0;
+    protoStringa(b, nomeTema, strlen(nomeTema));
+    protoNumero(b, num);
+    for (unsigned int k = 0; k < num; k++) {
+        protoStringa(b, righe[k].nick, strnlen(righe[k].nick, MaxUsernameL));
+        protoNumero(b, righe[k].punteggio);
+    }
+    if (b->errore) return NULL;
+
+    struct VistaClassifica* v = vistaNuova(b->len, versione);
+    if (!v) return NULL;
+    memcpy(v->dati, b->dati, b->len);
+    return v;
+}
+
+// Riferimento alla vista aggiornata di tab (NULL se non costruibile).
+// Sotto il lock si prende la vista pubblicata o, se è vecchia, si copiano
+// solo nick e punteggi; la codifica avviene a lock rilasciato e la nuova
+// vista si pubblica se nel frattempo non ne è arrivata una più recente.
+static struct VistaClassifica* classificaVista(struct Tabellone* tab, int v2) {
+    struct VistaClassifica** slot = v2 ? &tab->vistaV2 : &tab->vistaV1;
+    struct VistaClassifica* v;
+    unsigned int num;
+
+    pthread_mutex_lock(&tab->lock);
+    for (;;) {
+        v = *slot;
+        if (v && v->versione == tab->versione) {
+            atomic_fetch_add(&v->rif, 1);
+            pthread_mutex_unlock(&tab->lock);
+            return v;
+        }
+        num = tab->lunghezza;
+        if (!v2 && num > UINT16_MAX) num = UINT16_MAX;          // v1: conteggio su 16 bit
+        if (num <= capRigheVista) break;
+
+        // buffer del thread da ingrandire: fuori dal lock, poi si riguarda
+        pthread_mutex_unlock(&tab->lock);
+        struct RigaVista* nr = (struct RigaVista*)realloc(righeVista, (size_t)num * sizeof(*nr));
+        if (!nr) return NULL;
+        righeVista    = nr;
+        capRigheVista = num;
+        pthread_mutex_lock(&tab->lock);
+    }
+    uint64_t versione = tab->versione;
+    struct NodoPunteggio* n = classificaPrimo(tab);
+    for (unsigned int k = 0; k < num; k++, n = n->liv[0].avanti) {
+        memcpy(righeVista[k].nick, n->nick, MaxUsernameL);
+        righeVista[k].punteggio = n->punteggio;
+    }
+    pthread_mutex_unlock(&tab->lock);
+
+    v = v2 ? classificaCodificaV2(tab->nomeTema, righeVista, num, versione)
+           : classificaCodifica(tab->nomeTema, righeVista, num, versione);
+    if (!v) return NULL;
+
+    struct VistaClassifica* scartata = NULL;
+    pthread_mutex_lock(&tab->lock);
+    if (!*slot || (*slot)->versione < versione) vistaPubblica(slot, v);
+    else { scartata = v; v = *slot; }                           // un altro lettore è arrivato prima
+    atomic_fetch_add(&v->rif, 1);
+    pthread_mutex_unlock(&tab->lock);
+    vistaRilascia(scartata);
+    return v;
+}
+
+// v2: un solo frame FR_CLASSIFICHE; l'intestazione si calcola dopo aver
+// raccolto le viste. versioni (se non NULL) riceve la versione di ogni
+// vista inviata, UINT64_MAX per i temi senza vista.
+static void inviaClassificaV2(struct Sessione* s, uint64_t* versioni) {
+    const struct Catalogo* c = s->elenco;
+    struct VistaClassifica* viste[c->numTemi];
+    struct iovec iov[c->numTemi + 1];
+    uint8_t intest[PROTO_MAX_INTEST + 10];
+
+    uint8_t numero[10];
+    size_t lenNumero = protoCodificaNumero(numero, c->numTemi);
+    size_t carico = lenNumero;
+    for (int i = 0; i < c->numTemi; i++) {
+        viste[i] = classificaVista(c->tabelloni[i], 1);
+        if (versioni) versioni[i] = viste[i] ? viste[i]->versione : UINT64_MAX;
+        iov[i + 1].iov_base = viste[i] ? viste[i]->dati : NULL;
+        iov[i + 1].iov_len  = viste[i] ? viste[i]->len  : 0;
+        carico += iov[i + 1].iov_len;
+    }
+
+    intest[0] = FR_CLASSIFICHE;
+    size_t lenIntest = 1 + protoCodificaNumero(intest + 1, carico);
+    memcpy(intest + lenIntest, numero, lenNumero);
+    iov[0].iov_base = intest;
+    iov[0].iov_len  = lenIntest + lenNumero;
+
+    sessioneInviaVettore(s, iov, c->numTemi + 1);
+    for (int i = 0; i < c->numTemi; i++) vistaRilascia(viste[i]);
+}
+
+// v1: i blocchi non hanno prefisso di lunghezza, quindi una vista mancante
+// (memoria esaurita) non si può saltare: non si invia nulla e la sessione
+// si chiude, invece di desincronizzare il client
+static int inviaClassificaV1(struct Sessione* s) {
+    const struct Catalogo* c = s->elenco;
+    struct VistaClassifica* viste[c->numTemi];
+    struct iovec iov[c->numTemi];
+    int esito = 0;
+
+    for (int i = 0; i < c->numTemi; i++) {
+        viste[i] = classificaVista(c->tabelloni[i], 0);
+        if (!viste[i]) { esito = -1; continue; }
+        iov[i].iov_base = viste[i]->dati;
+        iov[i].iov_len  = viste[i]->len;
+    }
+
+    if (esito == 0) esito = sessioneInviaVettore(s, iov, c->numTemi);
+    for (int i = 0; i < c->numTemi; i++) vistaRilascia(viste[i]);
+    return esito;
+}
+
+// -1 se la classifica non si è potuta inviare (sessione da chiudere)
+static int inviaClassifica(struct Sessione* s) {
+    uint64_t t0 = statOra();
+    int esito = 0;
+    if (s->versione == PROTO_V2) inviaClassificaV2(s, NULL);
+    else                         esito = inviaClassificaV1(s);
+    statRegistra(STAT_CLASSIFICA, t0);
+    return esito;
+}
+
+// ============================================================================
+// Classifiche in diretta: deltaRegistra / threadDiretta / direttaConsegna
+// ----------------------------------------------------------------------------
+// Chi modifica un tabellone (sotto il suo lock) codifica l'operazione in
+// tab->delta, ma solo se esiste almeno un iscritto: senza iscritti il costo
+// è una lettura atomica. Ogni 1/DIRETTA_HZ s il thread della diretta stacca
+// le operazioni accumulate da ogni tabellone in un LottoDelta immutabile e lo
+// consegna ai loop che hanno iscritti (posta + eventfd); ogni loop copia il
+// lotto nelle code di uscita dei propri iscritti come un frame FR_DELTA.
+// Il client riceve un'istantanea (FR_CLASSIFICHE) all'iscrizione e poi solo
+// le variazioni: byte proporzionali alle modifiche, non alla classifica.
+// Le versioni del tabellone ordinano istantanea e lotti: le operazioni già
+// contenute nell'istantanea (versione <= cursore) si saltano.
+// Un iscritto che non legge (coda oltre USCITA_MAX) perde la diretta:
+// riceve FR_ISCRIZIONE 0 e può iscriversi di nuovo.
+// ============================================================================
+static inline int direttaAttiva(void) {
+    return atomic_load_explicit(&iscrittiTotali, memory_order_relaxed) > 0;
+}
+
+// Codifica un'operazione in coda al tabellone (chiamata con tab->lock acquisito).
+// Se manca memoria l'operazione si perde: il lotto chiederà una nuova istantanea.
+static void deltaRegistra(struct Tabellone* tab, enum OpDelta op, unsigned int a, unsigned int b,
+                          const struct NodoPunteggio* n) {
+    if (tab->deltaNum == tab->deltaCap) {
+        size_t cap = tab->deltaCap ? tab->deltaCap * 2 : 64;
+        uint64_t* ver = (uint64_t*)realloc(tab->deltaVer, cap * sizeof(*ver));
+        if (ver) tab->deltaVer = ver;
+        uint32_t* off = ver ? (uint32_t*)realloc(tab->deltaOff, cap * sizeof(*off)) : NULL;
+        if (off) tab->deltaOff = off;
+        if (!ver || !off) { tab->delta.errore = 1; return; }
+        tab->deltaCap = cap;
+    }
+    size_t inizio = tab->delta.len;
+    protoNumero(&tab->delta, op);
+    protoNumero(&tab->delta, a);
+    if (op == DELTA_INSERITO) protoStringa(&tab->delta, n->nick, strnlen(n->nick, MaxUsernameL));
+    if (op == DELTA_SPOSTATO) protoNumero(&tab->delta, b);
+    if (op != DELTA_RIMOSSO)  protoNumero(&tab->delta, n->punteggio);
+    if (tab->delta.errore) return;
+
+    tab->deltaOff[tab->deltaNum] = (uint32_t)inizio;
+    tab->deltaVer[tab->deltaNum] = tab->versione;
+    tab->deltaNum++;
+}
+
+// Stacca le operazioni accumulate in un lotto (NULL se non ce ne sono).
+// Un lotto con num == 0 segnala operazioni perse: gli iscritti ripartono
+// da una nuova istantanea.
+static struct LottoDelta* deltaStacca(struct Tabellone* tab) {
+    pthread_mutex_lock(&tab->lock);
+    if (tab->deltaNum == 0 && !tab->delta.errore) { pthread_mutex_unlock(&tab->lock); return NULL; }
+
+    size_t num = tab->delta.errore ? 0 : tab->deltaNum;
+    size_t len = tab->delta.errore ? 0 : tab->delta.len;
+    struct LottoDelta* l = (struct LottoDelta*)malloc(sizeof(*l) + num * (sizeof(uint64_t) + sizeof(uint32_t)) + len);
+    if (l) {
+        atomic_init(&l->rif, 1);
+        l->tab  = tab;
+        l->num  = num;
+        l->len  = len;
+        l->ver  = (uint64_t*)(l + 1);
+        l->off  = (uint32_t*)(l->ver + num);
+        l->dati = (uint8_t*)(l->off + num);
+        memcpy(l->ver, tab->deltaVer, num * sizeof(uint64_t));
+        memcpy(l->off, tab->deltaOff, num * sizeof(uint32_t));
+        memcpy(l->dati, tab->delta.dati, len);
+    }
+    tab->deltaNum = 0;
+    tab->delta.len = 0;
+    tab->delta.errore = (l == NULL);                // riprova al prossimo giro
+    pthread_mutex_unlock(&tab->lock);
+    return l;
+}
+
+static void lottoRilascia(struct LottoDelta* l) {
+    if (l && atomic_fetch_sub(&l->rif, 1) == 1) free(l);
+}
+
+static void* threadDiretta(void* arg) {
+    (void)arg;
+    struct LottoDelta** lotti = NULL;
+    size_t cap = 0;
+
+    // ogni giro sotto rw_passaggio (in lettura): il riavvio a caldo lo
+    // prende in scrittura e trova il thread fermo tra due giri
+    pthread_rwlock_rdlock(&rw_passaggio);
+    while (!atomic_load(&server_shutdown)) {
+        pthread_rwlock_unlock(&rw_passaggio);
+        usleep(1000000 / DIRETTA_HZ);
+        pthread_rwlock_rdlock(&rw_passaggio);
+
+        pthread_mutex_lock(&mtx_tabelloni);
+        struct Tabellone* primo = elencoTabelloni;  // si aggiungono solo in testa
+        size_t tot = (size_t)numTabelloni;
+        pthread_mutex_unlock(&mtx_tabelloni);
+        if (tot > cap) {
+            struct LottoDelta** nl = (struct LottoDelta**)realloc(lotti, tot * sizeof(*nl));
+            if (!nl) continue;
+            lotti = nl; cap = tot;
+        }
+
+        size_t num = 0;
+        for (struct Tabellone* t = primo; t && num < cap; t = t->succ) {
+            struct LottoDelta* l = deltaStacca(t);
+            if (l) lotti[num++] = l;
+        }
+        if (num == 0) continue;
+
+        for (int i = 0; i < numLoop; i++) {
+            struct Reattore* r = &reattori[i];
+            if (atomic_load(&r->numIscritti) == 0) continue;
+
+            pthread_mutex_lock(&r->mtxPosta);
+            if (r->numArrivo + num > r->capArrivo) {
+                size_t nc = r->capArrivo ? r->capArrivo : 16;
+                while (nc < r->numArrivo + num) nc *= 2;
+                struct LottoDelta** na = (struct LottoDelta**)realloc(r->inArrivo, nc * sizeof(*na));
+                if (na) { r->inArrivo = na; r->capArrivo = nc; }
+            }
+            // senza spazio il loop perderebbe operazioni: meglio saltare il giro
+            // per tutti (i lotti successivi ripartono da versioni più vecchie)
+            if (r->numArrivo + num <= r->capArrivo) {
+                for (size_t k = 0; k < num; k++) {
+                    atomic_fetch_add(&lotti[k]->rif, 1);
+                    r->inArrivo[r->numArrivo++] = lotti[k];
+                }
+            }
+            pthread_mutex_unlock(&r->mtxPosta);
+
+            uint64_t uno = 1;
+            if (write(r->posta, &uno, sizeof(uno)) < 0 && errno != EAGAIN) perror("eventfd diretta");
+        }
+        for (size_t k = 0; k < num; k++) lottoRilascia(lotti[k]);
+    }
+    pthread_rwlock_unlock(&rw_passaggio);
+    free(lotti);
+    return NULL;
+}
+
+// Iscrizione (o nuova istantanea): FR_ISCRIZIONE 1 + FR_CLASSIFICHE, e
+// cursori alle versioni delle viste inviate
+static int direttaAvvia(struct Sessione* s) {
+    const struct Catalogo* c = s->elenco;
+    struct Reattore* r = s->loop;
+    if (!s->cursori) {
+        int numCur = 0;
+        for (int i = 0; i < c->numTemi; i++)
+            if (c->tabelloni[i]->id >= numCur) numCur = c->tabelloni[i]->id + 1;
+        s->cursori = (struct CursoreDiretta*)malloc((numCur ? numCur : 1) * sizeof(*s->cursori));
+        if (!s->cursori) return -1;
+        s->numCursori = numCur;
+
+        s->iscrPrec = NULL;
+        s->iscrSucc = r->iscritti;
+        if (r->iscritti) r->iscritti->iscrPrec = s;
+        r->iscritti = s;
+        atomic_fetch_add(&r->numIscritti, 1);
+        atomic_fetch_add(&iscrittiTotali, 1);       // prima delle viste: nessuna modifica persa
+    }
+    for (int k = 0; k < s->numCursori; k++) s->cursori[k].indice = -1;
+
+    protoFrameNumero(&s->tx, FR_ISCRIZIONE, 1);
+    inviaTx(s);
+    uint64_t versioni[c->numTemi];
+    inviaClassificaV2(s, versioni);
+    for (int i = 0; i < c->numTemi; i++) {
+        if (versioni[i] == UINT64_MAX) continue;     // vista non disponibile: tema escluso
+        struct CursoreDiretta* cur = &s->cursori[c->tabelloni[i]->id];
+        cur->indice   = i;
+        cur->versione = versioni[i];
+    }
+    return 0;
+}
+
+static void direttaLascia(struct Sessione* s) {
+    if (!s->cursori) return;
+    struct Reattore* r = s->loop;
+    if (s->iscrPrec) s->iscrPrec->iscrSucc = s->iscrSucc;
+    else             r->iscritti = s->iscrSucc;
+    if (s->iscrSucc) s->iscrSucc->iscrPrec = s->iscrPrec;
+    s->iscrPrec = s->iscrSucc = NULL;
+    atomic_fetch_sub(&r->numIscritti, 1);
+    atomic_fetch_sub(&iscrittiTotali, 1);
+    free(s->cursori);
+    s->cursori = NULL;
+    s->numCursori = 0;
+}
+
+// FR_ISCRIVI: 1 = iscrizione, 0 = fine (conferma con FR_ISCRIZIONE 0)
+static int direttaRichiesta(struct Sessione* s, int iscrivi) {
+    if (iscrivi && s->loop) {
+        if (s->cursori) return 0;                   // già iscritta
+        return direttaAvvia(s) < 0;
+    }
+    direttaLascia(s);
+    protoFrameNumero(&s->tx, FR_ISCRIZIONE, 0);     // anche in modalità thread: non disponibile
+    inviaTx(s);
+    return 0;
+}
+
+// Copia in coda le operazioni del lotto non ancora note alla sessione
+static void direttaInviaLotto(struct Sessione* s, const struct LottoDelta* l) {
+    int id = l->tab->id;
+    if (id >= s->numCursori || s->cursori[id].indice < 0) return;
+    struct CursoreDiretta* cur = &s->cursori[id];
+    if (l->num == 0) { direttaAvvia(s); return; }   // operazioni perse: nuova istantanea
+
+    size_t k = 0;
+    while (k < l->num && l->ver[k] <= cur->versione) k++;
+    if (k == l->num) return;
+
+    uint8_t intest[1 + 10 + 20];
+    uint8_t numeri[20];
+    size_t lenNumeri = protoCodificaNumero(numeri, (uint64_t)cur->indice);
+    lenNumeri += protoCodificaNumero(numeri + lenNumeri, l->num - k);
+    size_t carico = lenNumeri + (l->len - l->off[k]);
+    intest[0] = FR_DELTA;
+    size_t lenIntest = 1 + protoCodificaNumero(intest + 1, carico);
+    memcpy(intest + lenIntest, numeri, lenNumeri);
+
+    struct iovec iov[2] = {
+        { .iov_base = intest,               .iov_len = lenIntest + lenNumeri },
+        { .iov_base = l->dati + l->off[k],  .iov_len = l->len - l->off[k] },
+    };
+    sessioneInviaVettore(s, iov, 2);
+    cur->versione = l->ver[l->num - 1];
+}
+
+// Loop: lotti in posta -> code di uscita degli iscritti, poi un invio ciascuno
+static void direttaConsegna(struct Reattore* r) {
+    pthread_mutex_lock(&r->mtxPosta);
+    size_t num = r->numArrivo;
+    struct LottoDelta* lotti[num ? num : 1];
+    memcpy(lotti, r->inArrivo, num * sizeof(*lotti));
+    r->numArrivo = 0;
+    pthread_mutex_unlock(&r->mtxPosta);
+
+    struct Sessione* succ;
+    for (struct Sessione* s = r->iscritti; s; s = succ) {
+        succ = s->iscrSucc;
+        if (s->outLen - s->outOff > USCITA_MAX) {   // non legge: niente diretta
+            direttaLascia(s);
+            protoFrameNumero(&s->tx, FR_ISCRIZIONE, 0);
+            inviaTx(s);
+            sessioneRiarma(s);                      // di nuovo soggetta alla scadenza del menu
+        } else {
+            for (size_t k = 0; k < num; k++) direttaInviaLotto(s, lotti[k]);
+        }
+        if (sessioneScarica(s) < 0) reattoreChiudi(s);
+    }
+    for (size_t k = 0; k < num; k++) lottoRilascia(lotti[k]);
+}
+
+// ============================================================================
+// Stanze multigiocatore: stanzaEntra / threadStanze / stanzeConsegna
+// ----------------------------------------------------------------------------
+// Una stanza per tema (v2, reactor): chi vi entra con FR_STANZA gioca la
+// stessa partita degli altri membri. Il thread delle stanze le fa avanzare
+// STANZA_HZ volte al secondo: con almeno STANZA_MIN presenti parte il conto
+// alla rovescia (STANZA_AVVIO), ogni domanda resta aperta STANZA_TEMPO
+// secondi o finché tutti hanno risposto, i risultati del turno restano
+// STANZA_PAUSA secondi, dopo NumQuest turni la classifica finale rimanda i
+// membri ai temi e la stanza riparte vuota (nuova gen).
+// I membri stanno in loop diversi: ingressi, uscite e risposte passano dal
+// lock della stanza, mentre ogni messaggio verso i membri si codifica una
+// sola volta in una Diffusione e viaggia nella posta dei loop che ne hanno
+// (come i lotti della diretta). Il loop la scrive sul socket di ciascun
+// membro: un send() per membro, nessuna copia né codifica per destinatario.
+// Un membro che non legge (coda oltre USCITA_MAX) viene fatto uscire.
+// ============================================================================
+
+// Stanza del tabellone, creata al primo ingresso (NULL se manca memoria)
+static struct Stanza* stanzaDelTema(struct Tabellone* tab) {
+    pthread_mutex_lock(&mtx_stanze);
+    struct Stanza* st = elencoStanze;
+    while (st && st->tab != tab) st = st->succ;
+    if (!st) {
+        st = (struct Stanza*)calloc(1, sizeof(*st));
+        int* perLoop = st ? (int*)calloc(numLoop, sizeof(*perLoop)) : NULL;
+        if (perLoop) {
+            st->tab     = tab;
+            st->perLoop = perLoop;
+            st->fase    = STANZA_IN_ATTESA;
+            st->gen     = 1;
+            st->turno   = -1;
+            st->rng     = statOra() ^ ((uint64_t)tab->id << 48);
+            pthread_mutex_init(&st->lock, NULL);
+            st->succ = elencoStanze;
+            elencoStanze = st;
+        } else {
+            free(st);
+            st = NULL;
+        }
+    }
+    pthread_mutex_unlock(&mtx_stanze);
+    return st;
+}
+
+// --- codifica dei frame (lock della stanza acquisito) -----------------
+static uint64_t stanzaMancano(const struct Stanza* st, uint64_t ora) {
+    return st->scadenza > ora ? (st->scadenza - ora) / 1000000ull : 0;
+}
+
+static const struct CoppiaQ* stanzaDomanda(const struct Stanza* st) {
+    return &st->cat->temi[st->temaIdx].quiz[st->estratte[st->turno]];
+}
+
+static void stanzaCodificaStato(const struct Stanza* st, struct ProtoBuf* b, uint64_t ora) {
+    protoIniziaFrame(b, FR_STANZA_STATO);
+    protoNumero(b, st->fase);
+    protoNumero(b, st->presenti);
+    protoNumero(b, stanzaMancano(st, ora));
+    protoChiudiFrame(b);
+}
+
+static void stanzaCodificaDomanda(const struct Stanza* st, struct ProtoBuf* b, uint64_t ora) {
+    const char* d = st->cat->temi[st->temaIdx].arena + stanzaDomanda(st)->domanda;
+    protoIniziaFrame(b, FR_STANZA_DOMANDA);
+    protoNumero(b, st->turno + 1);
+    protoNumero(b, stanzaMancano(st, ora));
+    protoStringa(b, d, strlen(d));
+    protoChiudiFrame(b);
+}
+
+// Ordine della partita: più punti, a parità meno tempo, poi prima entrato
+static int membroPrecede(const void* a, const void* b) {
+    const struct MembroStanza* x = *(struct MembroStanza* const*)a;
+    const struct MembroStanza* y = *(struct MembroStanza* const*)b;
+    if (x->punti != y->punti) return x->punti > y->punti ? -1 : 1;
+    if (x->tempo != y->tempo) return x->tempo < y->tempo ? -1 : 1;
+    return x < y ? -1 : 1;
+}
+
+// Numero di righe e prime max righe (nick, punti) della classifica della partita
+static void stanzaCodificaClassifica(struct Stanza* st, struct ProtoBuf* b, int max) {
+    for (int i = 0; i < st->numMembri; i++) st->ordine[i] = &st->membri[i];
+    qsort(st->ordine, st->numMembri, sizeof(*st->ordine), membroPrecede);
+    int n = st->numMembri < max ? st->numMembri : max;
+    protoNumero(b, n);
+    for (int i = 0; i < n; i++) {
+        protoStringa(b, st->ordine[i]->nick, strnlen(st->ordine[i]->nick, MaxUsernameL));
+        protoNumero(b, st->ordine[i]->punti);
+    }
+}
+
+// --- passaggi di fase (thread delle stanze, lock acquisito) -----------
+static void stanzaApriDomanda(struct Stanza* st, struct ProtoBuf* b, uint64_t ora) {
+    st->fase     = STANZA_IN_DOMANDA;
+    st->risposte = st->giuste = 0;
+    st->apertura = ora;
+    st->scadenza = ora + STANZA_TEMPO * 1000000000ull;
+    st->cambiata = 1;
+    stanzaCodificaDomanda(st, b, ora);
+}
+
+static void stanzaChiudiTurno(struct Stanza* st, struct ProtoBuf* b, uint64_t ora) {
+    const struct TemaQuiz* t = &st->cat->temi[st->temaIdx];
+    const char* giusta = t->arena + stanzaDomanda(st)->risposta;
+    st->fase     = STANZA_IN_RISULTATI;
+    st->scadenza = ora + STANZA_PAUSA * 1000000000ull;
+    st->cambiata = 1;
+
+    protoIniziaFrame(b, FR_STANZA_RISULTATI);
+    protoNumero(b, st->turno + 1);
+    protoStringa(b, giusta, strlen(giusta));
+    protoNumero(b, st->giuste);
+    protoNumero(b, st->risposte);
+    stanzaCodificaClassifica(st, b, STANZA_RIGHE);
+    protoChiudiFrame(b);
+}
+
+// Classifica finale completa, poi la stanza riparte vuota
+static void stanzaFine(struct Stanza* st, struct ProtoBuf* b) {
+    protoIniziaFrame(b, FR_STANZA_FINE);
+    stanzaCodificaClassifica(st, b, st->numMembri);
+    protoChiudiFrame(b);
+
+    if (st->cat) catalogoRilasciaDomande(st->cat);
+    st->cat       = NULL;
+    st->gen++;
+    st->fase      = STANZA_IN_ATTESA;
+    st->scadenza  = 0;
+    st->turno     = -1;
+    st->numMembri = st->presenti = st->risposte = st->giuste = 0;
+    memset(st->perLoop, 0, numLoop * sizeof(*st->perLoop));
+    st->cambiata  = 0;
+}
+
+// Prima domanda, dal catalogo corrente (il tema può essere sparito da qa/)
+static int stanzaAvvia(struct Stanza* st, struct ProtoBuf* b, uint64_t ora) {
+    int idx;
+    struct Catalogo* c = catalogoPerTema(st->tab, &idx);
+    if (!c) { stanzaFine(st, b); return 1; }
+
+    st->cat     = c;
+    st->temaIdx = idx;
+    st->turno   = 0;
+    estraiDomande(&st->rng, st->estratte, &c->temi[idx]);
+    stanzaApriDomanda(st, b, ora);
+    return 0;
+}
+
+// Fa avanzare la stanza all'istante ora, componendo in b i frame da
+// diffondere; ritorna 1 se la partita è finita (b contiene FR_STANZA_FINE)
+static int stanzaAvanza(struct Stanza* st, struct ProtoBuf* b, uint64_t ora) {
+    switch (st->fase) {
+    case STANZA_IN_ATTESA:
+        if (st->presenti < STANZA_MIN) {
+            if (st->scadenza) { st->scadenza = 0; st->cambiata = 1; }   // conto alla rovescia annullato
+        } else if (!st->scadenza) {
+            st->scadenza = ora + STANZA_AVVIO * 1000000000ull;
+            st->cambiata = 1;
+        } else if (ora >= st->scadenza && stanzaAvvia(st, b, ora)) {
+            return 1;
+        }
+        break;
+    case STANZA_IN_DOMANDA:
+        if (ora >= st->scadenza || st->risposte >= st->presenti) stanzaChiudiTurno(st, b, ora);
+        break;
+    case STANZA_IN_RISULTATI:
+        if (ora < st->scadenza) break;
+        if (st->turno + 1 == NumQuest || st->presenti == 0) { stanzaFine(st, b); return 1; }
+        st->turno++;
+        stanzaApriDomanda(st, b, ora);
+        break;
+    }
+    if (st->cambiata) {
+        stanzaCodificaStato(st, b, ora);
+        st->cambiata = 0;
+    }
+    return 0;
+}
+
+static void diffusioneRilascia(struct Diffusione* d) {
+    if (d && atomic_fetch_sub(&d->rif, 1) == 1) free(d);
+}
+
+// Consegna d al loop r (un riferimento in più) e lo sveglia
+static void diffusionePosta(struct Reattore* r, struct Diffusione* d) {
+    pthread_mutex_lock(&r->mtxPosta);
+    if (r->numDiffusioni == r->capDiffusioni) {
+        size_t nc = r->capDiffusioni ? r->capDiffusioni * 2 : 16;
+        struct Diffusione** na = (struct Diffusione**)realloc(r->diffusioni, nc * sizeof(*na));
+        if (na) { r->diffusioni = na; r->capDiffusioni = nc; }
+    }
+    int ok = r->numDiffusioni < r->capDiffusioni;
+    if (ok) {
+        atomic_fetch_add(&d->rif, 1);
+        r->diffusioni[r->numDiffusioni++] = d;
+    }
+    pthread_mutex_unlock(&r->mtxPosta);
+
+    uint64_t uno = 1;
+    if (ok && write(r->posta, &uno, sizeof(uno)) < 0 && errno != EAGAIN) perror("eventfd stanze");
+}
+
+static void* threadStanze(void* arg) {
+    (void)arg;
+    struct ProtoBuf b = {0};
+    char* dest = (char*)calloc(numLoop, 1);        // loop con membri della stanza
+    if (!dest) { perror("calloc"); return NULL; }
+
+    pthread_rwlock_rdlock(&rw_passaggio);           // come threadDiretta
+    while (!atomic_load(&server_shutdown)) {
+        pthread_rwlock_unlock(&rw_passaggio);
+        usleep(1000000 / STANZA_HZ);
+        pthread_rwlock_rdlock(&rw_passaggio);
+
+        pthread_mutex_lock(&mtx_stanze);
+        struct Stanza* primo = elencoStanze;        // si aggiungono solo in testa
+        pthread_mutex_unlock(&mtx_stanze);
+
+        uint64_t ora = statOra();
+        for (struct Stanza* st = primo; st; st = st->succ) {
+            b.len = 0;
+            b.errore = 0;
+            int membri = 0;
+            pthread_mutex_lock(&st->lock);
+            uint64_t gen = st->gen;
+            for (int i = 0; i < numLoop; i++) membri += (dest[i] = st->perLoop[i] > 0);
+            int fine = stanzaAvanza(st, &b, ora);
+            pthread_mutex_unlock(&st->lock);
+            if (!membri || b.len == 0 || b.errore) continue;
+
+            // codificato una volta, condiviso da tutti i loop e i membri
+            struct Diffusione* d = (struct Diffusione*)malloc(sizeof(*d) + b.len);
+            if (!d) continue;
+            atomic_init(&d->rif, 1);
+            d->stanza = st;
+            d->gen    = gen;
+            d->fine   = fine;
+            d->len    = b.len;
+            memcpy(d->dati, b.dati, b.len);
+            for (int i = 0; i < numLoop; i++)
+                if (dest[i]) diffusionePosta(&reattori[i], d);
+            diffusioneRilascia(d);
+        }
+    }
+    pthread_rwlock_unlock(&rw_passaggio);
+    free(dest);
+    free(b.dati);
+    return NULL;
+}
+
+// --- lato loop ---------------------------------------------------------
+static void stanzaStacca(struct Sessione* s) {
+    struct Reattore* r = s->loop;
+    if (s->stanzaPrec) s->stanzaPrec->stanzaSucc = s->stanzaSucc;
+    else               r->inStanza = s->stanzaSucc;
+    if (s->stanzaSucc) s->stanzaSucc->stanzaPrec = s->stanzaPrec;
+    s->stanzaPrec = s->stanzaSucc = NULL;
+    s->stanza = NULL;
+    atomic_store(&s->gioc->temaCorr, NULL);
+}
+
+// FR_STANZA: ingresso nella stanza del tema, con stato (e domanda aperta)
+static int stanzaEntra(struct Sessione* s, int temaIdx) {
+    if (temaIdx < 0 || temaIdx >= s->elenco->numTemi) return 1;
+    struct Tabellone* tab = s->elenco->tabelloni[temaIdx];
+    struct Stanza* st = s->loop ? stanzaDelTema(tab) : NULL;
+
+    int ok = 0;
+    if (st) {
+        pthread_mutex_lock(&st->lock);
+        // riga già nella partita: la propria (stesso nick), o in attesa quella di chi è uscito
+        int idx = -1;
+        for (int i = 0; i < st->numMembri && idx < 0; i++)
+            if (!st->membri[i].presente && strncmp(st->membri[i].nick, s->nick_attuale, MaxUsernameL) == 0) idx = i;
+        for (int i = 0; i < st->numMembri && idx < 0 && st->fase == STANZA_IN_ATTESA; i++)
+            if (!st->membri[i].presente) idx = i;
+
+        if (idx < 0 && st->numMembri == st->capMembri && st->capMembri < STANZA_MAX) {
+            int cap = st->capMembri ? st->capMembri * 2 : 16;
+            if (cap > STANZA_MAX) cap = STANZA_MAX;
+            struct MembroStanza* nm = (struct MembroStanza*)realloc(st->membri, cap * sizeof(*nm));
+            if (nm) st->membri = nm;
+            struct MembroStanza** no = nm ? (struct MembroStanza**)realloc(st->ordine, cap * sizeof(*no)) : NULL;
+            if (no) { st->ordine = no; st->capMembri = cap; }
+        }
+        if (idx < 0 && st->numMembri < st->capMembri) {
+            idx = st->numMembri++;
+            st->membri[idx].nick[0] = '\0';                 // riga nuova, azzerata qui sotto
         }
+        ok = idx >= 0;
         if (ok) {
-            strncpy(gioc->nome, buffer, MaxUsernameL);
-            strncpy(nick_attuale, buffer, MaxUsernameL);
+            struct MembroStanza* m = &st->membri[idx];
+            if (strncmp(m->nick, s->nick_attuale, MaxUsernameL) != 0) {
+                memset(m, 0, sizeof(*m));                   // riga di un altro: si riparte da zero
+                memcpy(m->nick, s->nick_attuale, MaxUsernameL);
+                m->turno = -1;
+            } else if (st->fase == STANZA_IN_DOMANDA && m->turno == st->turno) {
+                st->risposte++;                             // aveva già risposto al turno aperto
+            }
+            m->presente = 1;
+            s->stanzaMembro = idx;
+            s->stanzaGen    = st->gen;
+            st->presenti++;
+            st->perLoop[s->loop->id]++;
+            st->cambiata = 1;
+
+            uint64_t ora = statOra();
+            stanzaCodificaStato(st, &s->tx, ora);
+            if (st->fase == STANZA_IN_DOMANDA) stanzaCodificaDomanda(st, &s->tx, ora);
+        }
+        pthread_mutex_unlock(&st->lock);
+    }
+    if (!ok) {                                      // modalità thread, stanza piena o memoria esaurita
+        protoFrameNumero(&s->tx, FR_STANZA_FINE, 0);
+        inviaTx(s);
+        return 0;
+    }
+    inviaTx(s);
+
+    struct Reattore* r = s->loop;
+    s->stanza     = st;
+    s->stanzaPrec = NULL;
+    s->stanzaSucc = r->inStanza;
+    if (r->inStanza) r->inStanza->stanzaPrec = s;
+    r->inStanza = s;
+    s->fase = FASE_STANZA;                          // nessuna scadenza: i turni li scandisce la stanza
+    atomic_store(&s->gioc->temaCorr, tab->nomeTema);
+    segnalaStato();
+    return 0;
+}
+
+// Uscita dalla stanza (chiusura della sessione o FR_ESCI_STANZA); se la
+// partita è già finita resta solo da staccarsi dall'elenco del loop
+static void stanzaLascia(struct Sessione* s) {
+    struct Stanza* st = s->stanza;
+    if (!st) return;
+    pthread_mutex_lock(&st->lock);
+    if (s->stanzaGen == st->gen) {
+        struct MembroStanza* m = &st->membri[s->stanzaMembro];
+        m->presente = 0;
+        st->presenti--;
+        st->perLoop[s->loop->id]--;
+        if (st->fase == STANZA_IN_DOMANDA && m->turno == st->turno) st->risposte--;
+        st->cambiata = 1;
+    }
+    pthread_mutex_unlock(&st->lock);
+    stanzaStacca(s);
+}
+
+// Ritorno ai temi con FR_STANZA_FINE vuoto
+static void stanzaEsci(struct Sessione* s) {
+    stanzaLascia(s);
+    s->fase = FASE_COMANDO;
+    protoFrameNumero(&s->tx, FR_STANZA_FINE, 0);
+    inviaTx(s);
+    sessioneRiarma(s);
+    segnalaStato();
+}
+
+// FR_RISPOSTA in stanza: una per turno, solo a domanda aperta (esito 2 altrimenti)
+static int stanzaRispondi(struct Sessione* s, const char* buffer) {
+    uint64_t t0 = statOra();
+    struct Stanza* st = s->stanza;
+    int esito = 2;
+    pthread_mutex_lock(&st->lock);
+    if (s->stanzaGen == st->gen && st->fase == STANZA_IN_DOMANDA && t0 < st->scadenza) {
+        struct MembroStanza* m = &st->membri[s->stanzaMembro];
+        if (m->turno != st->turno) {
+            esito = rispostaErrata(&st->cat->temi[st->temaIdx], stanzaDomanda(st), buffer);
+            m->turno = st->turno;
+            st->risposte++;
+            if (esito == 0) {
+                m->punti++;
+                m->tempo += t0 - st->apertura;
+                st->giuste++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&st->lock);
+
+    if (esito < 2) statConta(esito ? CONT_ERRATE : CONT_GIUSTE);
+    inviaEsito(s, esito);
+    statRegistra(STAT_RISPOSTA, t0);
+    return 0;
+}
+
+// Loop: diffusioni in posta -> socket dei membri della stanza e della partita
+static void stanzeConsegna(struct Reattore* r) {
+    pthread_mutex_lock(&r->mtxPosta);
+    size_t num = r->numDiffusioni;
+    struct Diffusione* diff[num ? num : 1];
+    memcpy(diff, r->diffusioni, num * sizeof(*diff));
+    r->numDiffusioni = 0;
+    pthread_mutex_unlock(&r->mtxPosta);
+
+    for (size_t k = 0; k < num; k++) {
+        struct Diffusione* d = diff[k];
+        struct Sessione* succ;
+        for (struct Sessione* s = r->inStanza; s; s = succ) {
+            succ = s->stanzaSucc;
+            if (s->stanza != d->stanza || s->stanzaGen != d->gen) continue;
+            if (s->outLen - s->outOff > USCITA_MAX) {       // non legge: fuori dalla stanza
+                stanzaEsci(s);
+                if (sessioneScarica(s) < 0) reattoreChiudi(s);
+                continue;
+            }
+            if (sessioneInviaCondiviso(s, d->dati, d->len) < 0) { reattoreChiudi(s); continue; }
+            if (d->fine) {
+                stanzaStacca(s);
+                s->fase = FASE_COMANDO;
+                sessioneRiarma(s);
+                segnalaStato();
+            }
+        }
+        diffusioneRilascia(d);
+    }
+}
+
+// ============================================================================
+// rimuovi_dalle_classifiche
+// ----------------------------------------------------------------------------
+// O(temi giocati): si bloccano solo i tabelloni in cui la sessione ha un nodo.
+// In modalità persistente i risultati completati (registrati nel log)
+// restano in classifica: da qui in poi il nodo appartiene al tabellone.
+// ============================================================================
+static void rimuovi_dalle_classifiche(struct Sessione* s) {
+    for (int k = 0; k < s->numVoci; k++) {
+        struct Tabellone* tab = s->voci[k].tab;
+        pthread_mutex_lock(&tab->lock);
+        if (!s->voci[k].nodo->lsn) classificaRimuovi(tab, s->voci[k].nodo);
+        pthread_mutex_unlock(&tab->lock);
+    }
+    pthread_mutex_lock(&s->mtxVoci);
+    free(s->voci);
+    s->voci    = NULL;
+    s->numVoci = s->capVoci = 0;
+    pthread_mutex_unlock(&s->mtxVoci);
+    s->nodo    = NULL;
+}
+
+// ============================================================================
+// Persistenza: log dei risultati (WAL) + snapshot periodico
+// ----------------------------------------------------------------------------
+// A fine quiz il thread di gioco accoda un RecordWal (sotto il lock del
+// tabellone, così nodo->lsn e coda restano coerenti) e prosegue: il thread
+// del log scrive a lotti tutto ciò che trova e fa un solo fdatasync per lotto.
+// Quando il log supera SNAP_OGNI record e un quarto delle righe dell'ultimo
+// snapshot (costo ammortizzato costante per risultato), o ogni SNAP_SEC
+// secondi, lo stesso thread scrive uno snapshot con le righe lsn <= taglio,
+// lo rende definitivo con rename e svuota il log: i record successivi sono
+// ancora in coda, non su disco.
+// All'avvio: snapshot accodato in ordine, poi i record del log > taglio;
+// un record finale incompleto (crash durante la scrittura) viene scartato.
+// ============================================================================
+#define FILE_WAL   "classifiche.wal"
+#define FILE_SNAP  "classifiche.snap"
+#define MAGIA_SNAP "QZSNAP1"
+
+static uint32_t tabellaCrc[256];
+
+static void crcInit(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        tabellaCrc[i] = c;
+    }
+}
+
+// crc32 incrementale: si parte da 0 e si passa il risultato al blocco dopo
+static uint32_t crcAggiorna(uint32_t crc, const void* buf, size_t len) {
+    const uint8_t* p = (const uint8_t*)buf;
+    uint32_t c = ~crc;
+    for (size_t i = 0; i < len; i++) c = tabellaCrc[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return ~c;
+}
+
+static uint32_t crcRecord(const struct RecordWal* r) {
+    struct RecordWal copia = *r;
+    copia.crc = 0;
+    return crcAggiorna(0, &copia, sizeof(copia));
+}
+
+static void percorsoPersistenza(char* out, size_t cap, const char* nome) {
+    snprintf(out, cap, "%s/%s", dirPersistenza, nome);
+}
+
+// write() completa (gestisce scritture parziali ed EINTR)
+static int scriviTutto(int fd, const void* buf, size_t len) {
+    const char* p = (const char*)buf;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0) { if (errno == EINTR) continue; return -1; }
+        p += w; len -= (size_t)w;
+    }
+    return 0;
+}
+
+// Nodo di classifica per un risultato caricato da disco
+static struct NodoPunteggio* nodoDaDisco(struct Tabellone* tab, const char* nick,
+                                         unsigned int punteggio, time_t finito, uint64_t lsn) {
+    char n16[MaxUsernameL];
+    memcpy(n16, nick, MaxUsernameL);
+    n16[MaxUsernameL-1] = '\0';
+    struct NodoPunteggio* n = classificaNuovoNodo(tab, n16);
+    if (!n) return NULL;
+    n->punteggio = punteggio;
+    n->finito    = finito ? finito : 1;            // un risultato su disco è sempre finito
+    n->lsn       = lsn;
+    return n;
+}
+
+// Riga salvata del nick nel tema, NULL se non c'è (lock di tab acquisito)
+static struct NodoPunteggio* salvatoCerca(const struct Tabellone* tab, const char* nick) {
+    if (!tab->salvati) return NULL;
+    struct NodoPunteggio* n = tab->salvati[hashNick(nick) & tab->maschSalvati];
+    while (n && strcmp(n->nick, nick) != 0) n = n->succSalvato;
+    return n;
+}
+
+// Indicizza n come riga salvata del suo nick e restituisce quella che
+// sostituisce (NULL se è la prima); n resta fuori dall'indice solo se la
+// tabella non si può allocare (lock di tab acquisito)
+static struct NodoPunteggio* salvatoSostituisci(struct Tabellone* tab, struct NodoPunteggio* n) {
+    if (tab->numSalvati >= tab->maschSalvati) {             // raddoppio dei bucket
+        uint32_t num = tab->salvati ? (tab->maschSalvati + 1) * 2 : 16;
+        struct NodoPunteggio** b = (struct NodoPunteggio**)calloc(num, sizeof(*b));
+        if (b) {
+            for (uint32_t i = 0; tab->salvati && i <= tab->maschSalvati; i++) {
+                for (struct NodoPunteggio* x = tab->salvati[i], *succ; x; x = succ) {
+                    succ = x->succSalvato;
+                    uint32_t j = hashNick(x->nick) & (num - 1);
+                    x->succSalvato = b[j];
+                    b[j] = x;
+                }
+            }
+            free(tab->salvati);
+            tab->salvati      = b;
+            tab->maschSalvati = num - 1;
+        }
+        if (!tab->salvati) return NULL;
+    }
+
+    struct NodoPunteggio** p = &tab->salvati[hashNick(n->nick) & tab->maschSalvati];
+    while (*p && strcmp((*p)->nick, n->nick) != 0) p = &(*p)->succSalvato;
+    struct NodoPunteggio* prec = *p;
+    if (prec == n) return NULL;
+    if (prec) {
+        n->succSalvato = prec->succSalvato;
+    } else {
+        n->succSalvato = NULL;
+        tab->numSalvati++;
+    }
+    *p = n;
+    return prec;
+}
+
+// Fine quiz con -p (lock di tab acquisito): risultato nel log e unica riga
+// salvata del nick nel tema, al posto di quella di una partita precedente.
+// La riga sostituita può essere una voce di questa stessa sessione (tema
+// rigiocato): la voce passa al nodo nuovo prima che il vecchio si liberi.
+static void salvaRisultato(struct Sessione* s, struct Tabellone* tab, struct NodoPunteggio* n) {
+    walRegistra(tab, n);                            // solo accodato: l'fsync è del logger
+    if (!n->lsn) return;                            // coda piena: resta solo in memoria
+    struct NodoPunteggio* prec = salvatoSostituisci(tab, n);
+    if (!prec) return;
+    pthread_mutex_lock(&s->mtxVoci);
+    for (int k = 0; k < s->numVoci; k++)
+        if (s->voci[k].nodo == prec) s->voci[k].nodo = n;
+    pthread_mutex_unlock(&s->mtxVoci);
+    classificaRimuovi(tab, prec);
+}
+
+// Snapshot: blocchi per tabellone, righe in ordine di classifica
+static int snapshotCarica(uint64_t* taglio, size_t* righe) {
+    char path[PATH_MAX];
+    percorsoPersistenza(path, sizeof(path), FILE_SNAP);
+    FILE* f = fopen(path, "rb");
+    *taglio = 0;
+    *righe  = 0;
+    if (!f) return (errno == ENOENT) ? 0 : -1;      // primo avvio: nessuno snapshot
+
+    static char bufFile[1 << 20];
+    setvbuf(f, bufFile, _IOFBF, sizeof(bufFile));
+
+    struct IntestSnapshot in;
+    if (fread(&in, sizeof(in), 1, f) != 1 || memcmp(in.magia, MAGIA_SNAP, sizeof(in.magia)) != 0) {
+        fclose(f);
+        return -1;
+    }
+
+    struct RigaSnapshot lotto[4096];
+    for (uint32_t b = 0; b < in.numBlocchi; b++) {
+        struct BloccoSnapshot blocco;
+        if (fread(&blocco, sizeof(blocco), 1, f) != 1) { fclose(f); return -1; }
+        blocco.tema[MaxReadL-1] = '\0';
+        struct Tabellone* tab = tabelloneDelTema(blocco.tema);
+        if (!tab) { fclose(f); return -1; }
+
+        struct CodaSkip coda;
+        pthread_mutex_lock(&tab->lock);
+        classificaAccodaInizio(tab, &coda);
+        for (uint64_t letti = 0; letti < blocco.righe; ) {
+            size_t chiedi = (blocco.righe - letti > 4096) ? 4096 : (size_t)(blocco.righe - letti);
+            if (fread(lotto, sizeof(lotto[0]), chiedi, f) != chiedi) {
+                pthread_mutex_unlock(&tab->lock);
+                fclose(f);
+                return -1;
+            }
+            for (size_t k = 0; k < chiedi; k++) {
+                struct NodoPunteggio* n = nodoDaDisco(tab, lotto[k].nick, lotto[k].punteggio,
+                                                      (time_t)lotto[k].finito, in.taglio ? in.taglio : 1);
+                if (!n) continue;
+                // snapshot precedenti alla riga unica per nick: resta la
+                // migliore (le righe sono in ordine di classifica)
+                if (salvatoCerca(tab, n->nick)) { classificaLibera(n); continue; }
+                classificaAccoda(tab, &coda, n);
+                salvatoSostituisci(tab, n);
+            }
+            letti += chiedi;
+        }
+        pthread_mutex_unlock(&tab->lock);
+        *righe += blocco.righe;
+    }
+    fclose(f);
+    *taglio = in.taglio;
+    return 0;
+}
+
+// Log: ripete i record > taglio, scarta la coda incompleta, apre in append
+static int walCarica(uint64_t taglio, size_t* ripetuti) {
+    char path[PATH_MAX];
+    percorsoPersistenza(path, sizeof(path), FILE_WAL);
+    walFd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (walFd < 0) return -1;
+
+    FILE* f = fdopen(dup(walFd), "rb");
+    if (!f) return -1;
+    struct RecordWal r;
+    off_t buono = 0;
+    struct Tabellone* tab = NULL;
+    *ripetuti = 0;
+    while (fread(&r, sizeof(r), 1, f) == 1 && r.crc == crcRecord(&r)) {
+        buono += (off_t)sizeof(r);
+        if (r.lsn > walLsn) walLsn = r.lsn;
+        if (r.lsn <= taglio) continue;              // già nello snapshot
+
+        r.tema[MaxReadL-1] = '\0';
+        if (!tab || strcmp(tab->nomeTema, r.tema) != 0) tab = tabelloneDelTema(r.tema);
+        if (!tab) { fclose(f); return -1; }
+        pthread_mutex_lock(&tab->lock);
+        struct NodoPunteggio* n = nodoDaDisco(tab, r.nick, r.punteggio, (time_t)r.finito, r.lsn);
+        if (n) {
+            // il record più recente di un nick sostituisce la sua riga salvata
+            struct NodoPunteggio* prec = salvatoCerca(tab, n->nick);
+            if (prec) {
+                classificaAggiorna(tab, prec, n->punteggio, n->finito);
+                prec->lsn = n->lsn;
+                classificaLibera(n);
+            } else {
+                classificaInserisci(tab, n);
+                salvatoSostituisci(tab, n);
+            }
+        }
+        pthread_mutex_unlock(&tab->lock);
+        (*ripetuti)++;
+    }
+    fclose(f);
+    if (ftruncate(walFd, buono) < 0) return -1;     // via l'eventuale record a metà
+    return 0;
+}
+
+static int persistenzaCarica(void) {
+    crcInit();
+    if (mkdir(dirPersistenza, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "[ERR] cartella di persistenza '%s': %s\n", dirPersistenza, strerror(errno));
+        return -1;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint64_t taglio;
+    size_t righe, ripetuti;
+    if (snapshotCarica(&taglio, &righe) < 0) {
+        fprintf(stderr, "[ERR] snapshot illeggibile in '%s'\n", dirPersistenza);
+        return -1;
+    }
+    if (taglio > walLsn) walLsn = taglio;
+    if (walCarica(taglio, &ripetuti) < 0) {
+        fprintf(stderr, "[ERR] log dei risultati in '%s': %s\n", dirPersistenza, strerror(errno));
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    walRipetuti = ripetuti;
+
+    printf("[persistenza] %zu risultati dallo snapshot + %zu dal log in %.1f ms\n", righe, ripetuti,
+           (double)(t1.tv_sec - t0.tv_sec) * 1e3 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e6);
+    return 0;
+}
+
+// Accoda il risultato completato n (chiamata con tab->lock acquisito)
+static void walRegistra(struct Tabellone* tab, struct NodoPunteggio* n) {
+    struct RecordWal r;
+    memset(&r, 0, sizeof(r));
+    r.finito    = (int64_t)n->finito;
+    r.punteggio = n->punteggio;
+    memcpy(r.tema, tab->nomeTema, MaxReadL);
+    memcpy(r.nick, n->nick, MaxUsernameL);
+
+    pthread_mutex_lock(&mtx_wal);
+    if (walNum == walCap) {
+        size_t cap = walCap ? walCap * 2 : 256;
+        struct RecordWal* nc = (struct RecordWal*)realloc(walCoda, cap * sizeof(*nc));
+        if (!nc) { pthread_mutex_unlock(&mtx_wal); return; }     // resta solo in memoria
+        walCoda = nc; walCap = cap;
+    }
+    r.lsn = ++walLsn;                               // ordine del log = ordine degli lsn
+    walCoda[walNum++] = r;
+    pthread_cond_signal(&cond_wal);
+    pthread_mutex_unlock(&mtx_wal);
+
+    n->lsn = r.lsn;
+}
+
+// Scrive lo snapshot delle righe con lsn <= taglio e svuota il log.
+// Le righe si copiano sotto il lock di ciascun tabellone, si scrivono dopo.
+static int snapshotScrivi(uint64_t taglio, size_t* totale) {
+    char path[PATH_MAX], tmp[PATH_MAX];
+    percorsoPersistenza(path, sizeof(path), FILE_SNAP);
+    percorsoPersistenza(tmp,  sizeof(tmp),  FILE_SNAP ".tmp");
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+
+    pthread_mutex_lock(&mtx_tabelloni);
+    struct Tabellone* primo = elencoTabelloni;      // si aggiungono solo in testa
+    uint32_t blocchi = 0;
+    for (struct Tabellone* t = primo; t; t = t->succ) blocchi++;
+    pthread_mutex_unlock(&mtx_tabelloni);
+
+    struct IntestSnapshot in;
+    memset(&in, 0, sizeof(in));
+    memcpy(in.magia, MAGIA_SNAP, sizeof(in.magia));
+    in.taglio     = taglio;
+    in.numBlocchi = blocchi;
+    int esito = scriviTutto(fd, &in, sizeof(in));
+
+    struct RigaSnapshot* righe = NULL;
+    size_t cap = 0;
+    *totale = 0;
+    for (struct Tabellone* t = primo; t && esito == 0; t = t->succ) {
+        size_t num = 0;
+        pthread_mutex_lock(&t->lock);
+        if (cap < t->lunghezza) {
+            // senza spazio per tutte le righe lo snapshot sarebbe parziale,
+            // e il log che lo completa verrebbe comunque svuotato: si rinuncia
+            struct RigaSnapshot* nr = (struct RigaSnapshot*)realloc(righe, t->lunghezza * sizeof(*nr));
+            if (!nr) { pthread_mutex_unlock(&t->lock); errno = ENOMEM; esito = -1; break; }
+            righe = nr; cap = t->lunghezza;
+        }
+        for (struct NodoPunteggio* n = classificaPrimo(t); n; n = n->liv[0].avanti) {
+            if (!n->lsn || n->lsn > taglio) continue;
+            memset(&righe[num], 0, sizeof(righe[num]));
+            memcpy(righe[num].nick, n->nick, MaxUsernameL);
+            righe[num].finito    = (int64_t)n->finito;
+            righe[num].punteggio = n->punteggio;
+            num++;
+        }
+        pthread_mutex_unlock(&t->lock);
+
+        struct BloccoSnapshot b;
+        memset(&b, 0, sizeof(b));
+        memcpy(b.tema, t->nomeTema, MaxReadL);
+        b.righe = num;
+        *totale += num;
+        esito = scriviTutto(fd, &b, sizeof(b));
+        if (esito == 0 && num) esito = scriviTutto(fd, righe, num * sizeof(*righe));
+    }
+    free(righe);
+
+    if (esito == 0) esito = fsync(fd);
+    close(fd);
+    if (esito == 0) esito = rename(tmp, path);
+    if (esito == 0) {
+        int dfd = open(dirPersistenza, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd >= 0) { fsync(dfd); close(dfd); }
+        // tutto ciò che il log contiene ha lsn <= taglio: ora è nello snapshot
+        if (ftruncate(walFd, 0) < 0) esito = -1;
+    }
+    if (esito < 0) unlink(tmp);
+    return esito;
+}
+
+// Thread del log: scritture a lotti, un fdatasync per lotto, snapshot periodici
+static void* threadWal(void* arg) {
+    (void)arg;
+    struct RecordWal* lotto = NULL;
+    size_t capLotto = 0;
+    uint64_t scritto = walLsn;                      // ultimo lsn su disco (avvio: tutto il log)
+    size_t dalloSnap = walRipetuti, righeSnap = 0;
+    time_t ultimoSnap = time(NULL);
+
+    pthread_mutex_lock(&mtx_wal);
+    while (1) {
+        while (walNum == 0 && !walChiusura) {
+            struct timespec scad;
+            clock_gettime(CLOCK_REALTIME, &scad);
+            scad.tv_sec += SNAP_SEC;
+            if (pthread_cond_timedwait(&cond_wal, &mtx_wal, &scad) == ETIMEDOUT) break;
+        }
+
+        // prende tutto il lotto e libera subito la coda per i thread di gioco
+        struct RecordWal* tmp = walCoda; walCoda = lotto; lotto = tmp;
+        size_t capTmp = walCap; walCap = capLotto; capLotto = capTmp;
+        size_t num = walNum;
+        walNum = 0;
+        int fine = walChiusura;
+        pthread_mutex_unlock(&mtx_wal);
+
+        if (num) {
+            for (size_t k = 0; k < num; k++) lotto[k].crc = crcRecord(&lotto[k]);
+            if (scriviTutto(walFd, lotto, num * sizeof(*lotto)) < 0 || fdatasync(walFd) < 0)
+                perror("[persistenza] scrittura log");
+            scritto = lotto[num - 1].lsn;
+            dalloSnap += num;
+        }
+
+        int pieno = dalloSnap >= SNAP_OGNI && dalloSnap >= righeSnap / 4;
+        if (dalloSnap && (pieno || time(NULL) - ultimoSnap >= SNAP_SEC || fine)) {
+            if (snapshotScrivi(scritto, &righeSnap) < 0) perror("[persistenza] snapshot");
+            else dalloSnap = 0;
+            ultimoSnap = time(NULL);
+        }
+
+        pthread_mutex_lock(&mtx_wal);
+        if (fine && walNum == 0) break;
+    }
+    walRipetuti = dalloSnap;                        // 0 se lo snapshot finale è riuscito
+    pthread_mutex_unlock(&mtx_wal);
+    free(lotto);
+    return NULL;
+}
+
+// Riavvio a caldo: il vecchio processo ha già scritto tutto; si riapre solo
+// il log in append (walLsn arriva dall'intestazione del passaggio)
+static int persistenzaRiprendi(void) {
+    crcInit();
+    uint64_t lsn = walLsn;
+    size_t ripetuti;
+    if (walCarica(UINT64_MAX, &ripetuti) < 0) {     // nessun record da ripetere
+        fprintf(stderr, "[ERR] log dei risultati in '%s': %s\n", dirPersistenza, strerror(errno));
+        return -1;
+    }
+    if (lsn > walLsn) walLsn = lsn;
+    return 0;
+}
+
+static void persistenzaAvvia(void) {
+    pthread_create(&t_wal, NULL, threadWal, NULL);
+}
+
+// Svuota la coda sul disco e ferma il thread del log (spegnimento)
+static void persistenzaChiudi(void) {
+    if (!dirPersistenza) return;
+    pthread_mutex_lock(&mtx_wal);
+    walChiusura = 1;
+    pthread_cond_signal(&cond_wal);
+    pthread_mutex_unlock(&mtx_wal);
+    pthread_join(t_wal, NULL);
+}
+
+// ============================================================================
+// Riavvio a caldo: passaggio di socket e stato a un nuovo processo
+// ----------------------------------------------------------------------------
+// 'R' + Invio (solo reactor): i loop si fermano alla fine del lotto di eventi
+// in corso, il logger svuota la coda su disco, poi si lancia argv[0] con
+// "-H fd" (il binario appena installato) e gli si passano su un socketpair
+// SOCK_SEQPACKET i socket di ascolto, le connessioni (SCM_RIGHTS), i
+// tabelloni e lo stato di protocollo di ogni sessione. Il nuovo processo
+// ricostruisce tutto prima di avviare i propri loop e conferma con un byte:
+// da lì serve lui, e il vecchio chiude le proprie copie dei descrittori
+// (senza shutdown, le connessioni restano aperte) e resta solo in attesa
+// dell'uscita del nuovo, che così mantiene il terminale della dashboard.
+// Se il nuovo processo non parte o non conferma entro PASSA_ATTESA secondi,
+// il vecchio riprende a servire come se nulla fosse.
+// Le connessioni in arrivo durante il passaggio attendono nella coda di
+// listen: nessun socket di ascolto viene chiuso.
+// ============================================================================
+#define PASSA_ATTESA 10                 // secondi per la conferma del nuovo processo
+#define PASSA_BLOCCO (32 * 1024)        // byte per messaggio sul canale
+#define MAGIA_PASSA  "QZPASS1"
+
+// Invia un blocco logico in messaggi da PASSA_BLOCCO; i descrittori
+// viaggiano con il primo messaggio
+static int passaInvia(int ch, const void* buf, size_t len, const int* fds, int numFd) {
+    const char* p = (const char*)buf;
+    do {
+        size_t parte = (len > PASSA_BLOCCO) ? PASSA_BLOCCO : len;
+        struct iovec iov = { .iov_base = (void*)p, .iov_len = parte };
+        struct msghdr m = { .msg_iov = &iov, .msg_iovlen = 1 };
+        union { struct cmsghdr h; char spazio[CMSG_SPACE(sizeof(int) * 64)]; } ctl;
+        if (numFd > 0) {
+            if (numFd > 64) { errno = EINVAL; return -1; }
+            memset(&ctl, 0, sizeof(ctl));
+            m.msg_control    = ctl.spazio;
+            m.msg_controllen = CMSG_SPACE(sizeof(int) * numFd);
+            struct cmsghdr* c = CMSG_FIRSTHDR(&m);
+            c->cmsg_level = SOL_SOCKET;
+            c->cmsg_type  = SCM_RIGHTS;
+            c->cmsg_len   = CMSG_LEN(sizeof(int) * numFd);
+            memcpy(CMSG_DATA(c), fds, sizeof(int) * numFd);
+        }
+        ssize_t w;
+        do w = sendmsg(ch, &m, MSG_NOSIGNAL); while (w < 0 && errno == EINTR);
+        if (w != (ssize_t)parte) return -1;
+        p += parte; len -= parte;
+        numFd = 0;
+    } while (len > 0);
+    return 0;
+}
+
+// Riceve un blocco di esattamente len byte; *numFd: in ingresso il massimo
+// di descrittori attesi, in uscita quelli ricevuti (tutti O_CLOEXEC)
+static int passaRicevi(int ch, void* buf, size_t len, int* fds, int* numFd) {
+    char* p = (char*)buf;
+    int max = numFd ? *numFd : 0;
+    if (numFd) *numFd = 0;
+    do {
+        size_t parte = (len > PASSA_BLOCCO) ? PASSA_BLOCCO : len;
+        struct iovec iov = { .iov_base = p, .iov_len = parte };
+        union { struct cmsghdr h; char spazio[CMSG_SPACE(sizeof(int) * 64)]; } ctl;
+        struct msghdr m = { .msg_iov = &iov, .msg_iovlen = 1,
+                            .msg_control = ctl.spazio, .msg_controllen = sizeof(ctl.spazio) };
+        ssize_t r;
+        do r = recvmsg(ch, &m, MSG_CMSG_CLOEXEC); while (r < 0 && errno == EINTR);
+        if (r != (ssize_t)parte || (m.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) return -1;
+
+        for (struct cmsghdr* c = CMSG_FIRSTHDR(&m); c; c = CMSG_NXTHDR(&m, c)) {
+            if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+            int n = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            int arrivati[64];
+            memcpy(arrivati, CMSG_DATA(c), sizeof(int) * n);
+            for (int k = 0; k < n; k++) {
+                if (numFd && *numFd < max) fds[(*numFd)++] = arrivati[k];
+                else close(arrivati[k]);                // non attesi: non devono restare aperti
+            }
+        }
+        p += parte; len -= parte;
+    } while (len > 0);
+    return 0;
+}
+
+// Vecchio processo, loop fermi: intestazione, tabelloni, sessioni
+static int passaggioInvia(int ch) {
+    uint32_t numSessioni = 0, numTab = 0;
+    for (int i = 0; i < numSlot; i++) if (sessioniSlot[i]) numSessioni++;
+
+    pthread_mutex_lock(&mtx_tabelloni);
+    struct Tabellone* primo = elencoTabelloni;
+    for (struct Tabellone* t = primo; t; t = t->succ) numTab++;
+    pthread_mutex_unlock(&mtx_tabelloni);
+
+    struct IntestPassaggio in;
+    memset(&in, 0, sizeof(in));
+    memcpy(in.magia, MAGIA_PASSA, sizeof(in.magia));
+    pthread_mutex_lock(&mtx_wal);
+    in.walLsn = walLsn;
+    pthread_mutex_unlock(&mtx_wal);
+    in.numAscolto   = (uint32_t)numLoop;
+    in.numTabelloni = numTab;
+    in.numSessioni  = numSessioni;
+    int ascolto[64];
+    for (int i = 0; i < numLoop && i < 64; i++) ascolto[i] = reattori[i].sd_ascolto;
+    if (numLoop > 64 || passaInvia(ch, &in, sizeof(in), ascolto, numLoop) < 0) return -1;
+
+    // righe a lotti, in ordine di classifica (la dashboard può leggere: lock)
+    struct RigaPassata lotto[1024];
+    for (struct Tabellone* t = primo; t; t = t->succ) {
+        pthread_mutex_lock(&t->lock);
+        struct BloccoSnapshot b;
+        memset(&b, 0, sizeof(b));
+        memcpy(b.tema, t->nomeTema, MaxReadL);
+        b.righe = t->lunghezza;
+        int esito = passaInvia(ch, &b, sizeof(b), NULL, 0);
+        size_t num = 0;
+        for (struct NodoPunteggio* n = t->testa->liv[0].avanti; n && esito == 0; n = n->liv[0].avanti) {
+            memset(&lotto[num], 0, sizeof(lotto[num]));
+            memcpy(lotto[num].nick, n->nick, MaxUsernameL);
+            lotto[num].finito    = (int64_t)n->finito;
+            lotto[num].lsn       = n->lsn;
+            lotto[num].punteggio = n->punteggio;
+            if (++num == 1024 || !n->liv[0].avanti) {
+                esito = passaInvia(ch, lotto, num * sizeof(lotto[0]), NULL, 0);
+                num = 0;
+            }
+        }
+        pthread_mutex_unlock(&t->lock);
+        if (esito < 0) return -1;
+    }
+
+    for (int i = 0; i < numSlot; i++) {
+        struct Sessione* s = sessioniSlot[i];
+        if (!s) continue;
+        if (s->stanza) stanzaEsci(s);               // le stanze non passano: FR_STANZA_FINE vuoto
+
+        struct SessionePassata sp;
+        memset(&sp, 0, sizeof(sp));
+        sp.fase     = (uint32_t)s->fase;
+        sp.versione = (uint32_t)s->versione;
+        memcpy(sp.nick, s->nick_attuale, MaxUsernameL);
+        if (s->fase == FASE_RISPOSTA) {
+            memcpy(sp.tema, s->cat->temi[s->temaIdx].nome, MaxReadL);
+            sp.domanda = (uint32_t)s->domanda;
+            memcpy(sp.estratte, s->estratte, sizeof(sp.estratte));
+        }
+        sp.rng     = s->rng;
+        sp.numVoci = (uint32_t)s->numVoci;
+        sp.inLen   = (uint32_t)(s->inLen + s->riservaLen);
+        sp.outLen  = s->outLen - s->outOff;
+        sp.iscritto = s->cursori != NULL;
+
+        // due blocchi: il record fisso (con il socket) e la parte variabile
+        size_t dim = s->numVoci * sizeof(struct VocePassata) + sp.inLen + sp.outLen;
+        char* blocco = (char*)malloc(dim ? dim : 1);
+        if (!blocco) return -1;
+        struct VocePassata* vp = (struct VocePassata*)blocco;
+        for (int k = 0; k < s->numVoci; k++) {
+            struct VoceGiocatore* v = &s->voci[k];
+            memset(&vp[k], 0, sizeof(vp[k]));
+            memcpy(vp[k].tema, v->tab->nomeTema, MaxReadL);
+            pthread_mutex_lock(&v->tab->lock);
+            vp[k].rango = classificaRango(v->tab, v->nodo);
+            pthread_mutex_unlock(&v->tab->lock);
+            vp[k].finito      = (int64_t)v->finito;
+            vp[k].punteggio   = v->punteggio;
+            vp[k].rangoArrivo = v->rangoArrivo;
         }
-        pthread_mutex_unlock(&mtx_players);
+        char* coda = (char*)(vp + s->numVoci);
+        memcpy(coda, s->in, s->inLen);
+        memcpy(coda + s->inLen, s->riserva, s->riservaLen);
+        memcpy(coda + sp.inLen, s->out + s->outOff, sp.outLen);
+
+        int esito = passaInvia(ch, &sp, sizeof(sp), &s->conn_sd, 1);
+        if (esito == 0 && dim) esito = passaInvia(ch, blocco, dim, NULL, 0);
+        free(blocco);
+        if (esito < 0) return -1;
+    }
+    return 0;
+}
+
+// Nuovo processo, prima di tutto il resto: intestazione e socket di ascolto
+static int passaggioIntestazione(void) {
+    struct IntestPassaggio in;
+    int fds[64], num = 64;
+    if (passaRicevi(fdPassaggio, &in, sizeof(in), fds, &num) < 0 ||
+        memcmp(in.magia, MAGIA_PASSA, sizeof(in.magia)) != 0 || num != (int)in.numAscolto || num == 0) {
+        fprintf(stderr, "[ERR] riavvio a caldo: intestazione non valida\n");
+        for (int i = 0; i < num; i++) close(fds[i]);
+        return -1;
+    }
+    ascoltoEreditati = (int*)malloc(num * sizeof(int));
+    if (!ascoltoEreditati) return -1;
+    memcpy(ascoltoEreditati, fds, num * sizeof(int));
+    numEreditati  = num;
+    passaTabelloni = in.numTabelloni;
+    passaSessioni  = in.numSessioni;
+    walLsn         = in.walLsn;                 // il log su disco è già completo
+    return 0;
+}
+
+// Tabellone ricostruito e i suoi nodi in ordine di classifica
+struct TabPassato {
+    struct Tabellone*      tab;
+    struct NodoPunteggio** nodi;
+    uint64_t               num;
+};
+
+static struct NodoPunteggio* passaNodo(struct TabPassato* tp, uint32_t numTp,
+                                       const char* tema, uint64_t rango, struct Tabellone** tab) {
+    for (uint32_t i = 0; i < numTp; i++) {
+        if (strcmp(tp[i].tab->nomeTema, tema) != 0) continue;
+        if (rango == 0 || rango > tp[i].num) return NULL;
+        *tab = tp[i].tab;
+        return tp[i].nodi[rango - 1];
+    }
+    return NULL;
+}
 
-        // rispondo col verdetto (0/1) in uint16_t rete
-        netNum = htons(ok);
-        send(conn_sd, &netNum, sizeof(netNum), MSG_NOSIGNAL);
-    } while (!ntohs(netNum));
+// Una sessione ricevuta: slot, stato di protocollo, voci, buffer.
+// Ritorna -1 solo per errori del canale (la sessione non ricostruibile si chiude).
+static int passaSessione(struct TabPassato* tp, uint32_t numTp, int indice) {
+    struct SessionePassata sp;
+    int conn_sd = -1, num = 1;
+    if (passaRicevi(fdPassaggio, &sp, sizeof(sp), &conn_sd, &num) < 0 || num != 1) return -1;
+    if (sp.inLen > DIM_INGRESSO + USCITA_MAX) return -1;      // buffer più riserva
+    size_t dim = sp.numVoci * sizeof(struct VocePassata) + sp.inLen + sp.outLen;
+    char* resto = (char*)malloc(dim ? dim : 1);
+    if (!resto || (dim && passaRicevi(fdPassaggio, resto, dim, NULL, NULL) < 0)) {
+        free(resto);
+        close(conn_sd);
+        return -1;
+    }
+    sp.nick[MaxUsernameL-1] = '\0';
+    sp.tema[MaxReadL-1]     = '\0';
 
-    // segna “online” (temaCorr NULL finché non entra in un quiz)
-    pthread_mutex_lock(&mtx_players);
-    gioc->temaCorr = NULL;
-    pthread_mutex_unlock(&mtx_players);
+    // loop non ancora avviati: il pool del loop si può usare da qui
+    struct Reattore* r = &reattori[indice % numLoop];
+    int slot = prendiSlot();
+    struct Sessione* s = (slot >= 0) ? (struct Sessione*)poolPrendi(&r->pool->sessioni) : NULL;
+    if (!s) {
+        fprintf(stderr, "[riavvio] slot esauriti: connessione di '%s' chiusa\n", sp.nick);
+        if (slot >= 0) reattoreLiberaSlot(r, slot, 0);
+        close(conn_sd);
+        free(resto);
+        return 0;
+    }
+    sessioneInit(s, conn_sd, slot, r);
+    s->versione = (int)sp.versione;
+    s->rng      = sp.rng;
 
-    // --- (3) invio elenco nomi tema -----------------------------------
-    for (int i = 0; i < numTemi; i++) {
-        send(conn_sd, temiQuiz[i].nome, MaxReadL, MSG_NOSIGNAL);
+    int valida = 1;
+    if (sp.fase != FASE_LOGIN) {
+        memcpy(s->nick_attuale, sp.nick, MaxUsernameL);
+        memcpy(s->gioc->nome,   sp.nick, MaxUsernameL);
+        valida = (registroInserisci(s) == NULL);
     }
 
-    // refresh "Utenti online"
-    pthread_mutex_lock(&mtx_score);
-    flag_stampa = 1; 
-    pthread_cond_signal(&cond_score);
-    while (flag_stampa) pthread_cond_wait(&cond_score, &mtx_score);
-    pthread_mutex_unlock(&mtx_score);
+    // voci: i nodi sono già nei tabelloni ricostruiti
+    const struct VocePassata* vp = (const struct VocePassata*)resto;
+    if (valida && sp.numVoci) {
+        s->voci = (struct VoceGiocatore*)malloc(sp.numVoci * sizeof(*s->voci));
+        if (!s->voci) valida = 0;
+        else s->capVoci = (int)sp.numVoci;
+    }
+    for (uint32_t k = 0; valida && k < sp.numVoci; k++) {
+        char tema[MaxReadL];
+        memcpy(tema, vp[k].tema, MaxReadL);
+        tema[MaxReadL-1] = '\0';
+        struct Tabellone* tab = NULL;
+        struct NodoPunteggio* n = passaNodo(tp, numTp, tema, vp[k].rango, &tab);
+        if (!n) { valida = 0; break; }
+        s->voci[s->numVoci++] = (struct VoceGiocatore){
+            .tab = tab, .nodo = n, .punteggio = vp[k].punteggio,
+            .finito = (time_t)vp[k].finito, .rangoArrivo = vp[k].rangoArrivo };
+    }
 
-    // --- (4) ciclo di gioco -------------------------------------------
-    while (1) {
-        // ricevo comando: 0=end 
-        // 1=showscore
-        // >=3 selezione tema
-        ret = recv(conn_sd, &netNum, sizeof(netNum), MSG_WAITALL);
-        if (verificaRicezione(ret, sizeof(netNum)) != 0) goto fine;
-        int cmd = ntohs(netNum);
-
-        // Fine sessione: esci dal loop.
-        if (cmd == 0) {
-            break;
-        }
-        if (cmd == 1) {
-            inviaClassifica(conn_sd);
-            continue;
+    // quiz in corso: il tema si ritrova per nome nel catalogo del nuovo processo
+    s->fase = (enum FaseSessione)sp.fase;
+    if (valida && s->fase == FASE_RISPOSTA) {
+        s->cat = (s->numVoci > 0) ? catalogoPerTema(s->voci[s->numVoci - 1].tab, &s->temaIdx) : NULL;
+        valida = s->cat && sp.domanda < NumQuest &&
+                 strcmp(s->cat->temi[s->temaIdx].nome, sp.tema) == 0;
+        for (int q = 0; valida && q < NumQuest; q++)
+            valida = sp.estratte[q] < s->cat->temi[s->temaIdx].numDomande;
+        if (valida) {
+            s->domanda = (int)sp.domanda;
+            memcpy(s->estratte, sp.estratte, sizeof(s->estratte));
+            s->nodo = s->voci[s->numVoci - 1].nodo;
+            atomic_store(&s->gioc->temaCorr, s->voci[s->numVoci - 1].tab->nomeTema);
         }
+    }
 
-        // selezione tema: protocollo usa offset +2 per i comandi, quindi:
-        //   cmd = (idTema + 2) + 1  => idTema = cmd - 3
-        int temaIdx = cmd - 3;
-
-        // marca lo stato: “sto svolgendo <tema>”
-        pthread_mutex_lock(&mtx_players);
-        gioc->temaCorr = temiQuiz[temaIdx].nome;
-        pthread_mutex_unlock(&mtx_players);
-
-        // inserisce il giocatore nella classifica del tema (in testa)
-        pthread_mutex_lock(&tabelloni[temaIdx].lock);
-        struct NodoPunteggio* nodo = (struct NodoPunteggio*)malloc(sizeof(*nodo));
-        nodo->punteggio = 0;
-        nodo->finito    = 0;                        // ancora non terminato
-        strncpy(nodo->nick, gioc->nome, MaxUsernameL);
-        nodo->nick[MaxUsernameL-1] = '\0';
-        nodo->prev      = NULL;
-        nodo->nxt       = tabelloni[temaIdx].head;  // nuova testa
-        if (tabelloni[temaIdx].head) tabelloni[temaIdx].head->prev = nodo;
-        tabelloni[temaIdx].head = nodo;
-        pthread_mutex_unlock(&tabelloni[temaIdx].lock);
-
-        // refresh
-        pthread_mutex_lock(&mtx_score);
-        flag_stampa = 1; pthread_cond_signal(&cond_score);
-        while (flag_stampa) pthread_cond_wait(&cond_score, &mtx_score);
-        pthread_mutex_unlock(&mtx_score);
-
-        // loop domande NumQuest
-        for (int q = 0; q < NumQuest; q++) {
-            // invio testo domanda (buffer a lunghezza fissa MaxReadQuestL)
-            send(conn_sd, temiQuiz[temaIdx].quiz[q].domanda, MaxReadQuestL, MSG_NOSIGNAL);
-
-            // ricevo risposta (buffer a lunghezza fissa MaxReadL)
-            ret = recv(conn_sd, buffer, MaxReadL, MSG_WAITALL);
-            if (verificaRicezione(ret, MaxReadL) != 0) goto fine;
-
-            // comandi inline: show-score / end
-            if (strcmp(buffer, ShowScore) == 0) { inviaClassifica(conn_sd); q--; continue; }
-            if (strcmp(buffer, EndQuiz)   == 0) { goto fine; }
-
-            // confronto risposta: normalizzazione più robusta (vedi sopra normalizza)
-            char attesa[MaxReadL];  char ricevuta[MaxReadL];
-            normalizza(temiQuiz[temaIdx].quiz[q].risposta, attesa,   sizeof(attesa));
-            normalizza(buffer,                              ricevuta, sizeof(ricevuta));
-
-            int esito = strcmp(ricevuta, attesa);       // 0 = corretta
+    const char* coda = (const char*)(vp + sp.numVoci);
+    s->inLen = (sp.inLen > DIM_INGRESSO) ? DIM_INGRESSO : sp.inLen;
+    memcpy(s->in, coda, s->inLen);
+    if (sp.inLen > s->inLen && sessioneRiserva(s, coda + s->inLen, sp.inLen - s->inLen) < 0) valida = 0;
+    if (valida && sp.outLen && sessioneInvia(s, coda + sp.inLen, sp.outLen) < 0) valida = 0;
+    s->outNuovi = 0;
+    free(resto);
 
-            if (esito == 0) {
-                // +1 punto e “bubble up” nella classifica
-                // con tie-break sul tempo quando necessario
-                pthread_mutex_lock(&tabelloni[temaIdx].lock);
-                nodo->punteggio++;
-
-                while (nodo->nxt &&
-                       (nodo->punteggio > nodo->nxt->punteggio ||
-                        (nodo->punteggio == nodo->nxt->punteggio &&
-                         nodo->finito && nodo->nxt->finito && nodo->finito < nodo->nxt->finito))) {
-
-                    struct NodoPunteggio* prev = nodo->prev;
-                    struct NodoPunteggio* next = nodo->nxt;
-
-                    if (prev) prev->nxt = next;
-                    else      tabelloni[temaIdx].head = next;
-                    next->prev = prev;
-
-                    nodo->nxt  = next->nxt;
-                    nodo->prev = next;
-                    if (next->nxt) next->nxt->prev = nodo;
-                    next->nxt = nodo;
-                }
-                pthread_mutex_unlock(&tabelloni[temaIdx].lock);
-            }
+    impostaConnessione(conn_sd);
+    pthread_mutex_lock(&mtx_conns);
+    conn_sd_list[slot] = conn_sd;
+    pthread_mutex_unlock(&mtx_conns);
+    sessioniSlot[slot] = s;
+
+    if (!valida || reattoreRegistra(r, s) < 0) {
+        fprintf(stderr, "[riavvio] stato di '%s' non ricostruibile: connessione chiusa\n", s->nick_attuale);
+        reattoreChiudi(s);
+        return 0;
+    }
+    // diretta: i lotti non consegnati sono rimasti al vecchio processo,
+    // si riparte da una nuova istantanea
+    if (sp.iscritto && direttaAvvia(s) < 0) direttaRichiesta(s, 0);
+    sessioneRiarma(s);
+    // frame arrivati durante il passaggio (il fronte di EPOLLIN è già passato)
+    if (reattoreLeggi(s) < 0 || sessioneScarica(s) < 0) reattoreChiudi(s);
+    return 0;
+}
+
+// Nuovo processo, loop creati ma non avviati: tabelloni, sessioni, conferma
+static int passaggioStato(void) {
+    struct TabPassato* tp = (struct TabPassato*)calloc(passaTabelloni ? passaTabelloni : 1, sizeof(*tp));
+    if (!tp) return -1;
+    int esito = 0;
+    size_t righe = 0;
+    struct RigaPassata lotto[1024];
 
-            // refresh sezione Classifiche dopo ogni risposta
-            pthread_mutex_lock(&mtx_score);
-            flag_stampa = 1; pthread_cond_signal(&cond_score);
-            while (flag_stampa) pthread_cond_wait(&cond_score, &mtx_score);
-            pthread_mutex_unlock(&mtx_score);
+    uint32_t numTp = 0;
+    for (; numTp < passaTabelloni && esito == 0; numTp++) {
+        struct BloccoSnapshot b;
+        if (passaRicevi(fdPassaggio, &b, sizeof(b), NULL, NULL) < 0) { esito = -1; break; }
+        b.tema[MaxReadL-1] = '\0';
+        struct TabPassato* t = &tp[numTp];
+        t->tab  = tabelloneDelTema(b.tema);
+        t->nodi = (struct NodoPunteggio**)malloc((b.righe ? b.righe : 1) * sizeof(*t->nodi));
+        if (!t->tab || !t->nodi) { esito = -1; break; }
 
-            // invio esito (0 = corretta, 1 = errata)
-            netNum = htons(esito);
-            send(conn_sd, &netNum, sizeof(netNum), MSG_NOSIGNAL);
+        struct CodaSkip coda;
+        pthread_mutex_lock(&t->tab->lock);
+        classificaAccodaInizio(t->tab, &coda);
+        for (uint64_t letti = 0; letti < b.righe && esito == 0; ) {
+            size_t chiedi = (b.righe - letti > 1024) ? 1024 : (size_t)(b.righe - letti);
+            if (passaRicevi(fdPassaggio, lotto, chiedi * sizeof(lotto[0]), NULL, NULL) < 0) { esito = -1; break; }
+            for (size_t k = 0; k < chiedi; k++) {
+                lotto[k].nick[MaxUsernameL-1] = '\0';
+                struct NodoPunteggio* n = classificaNuovoNodo(t->tab, lotto[k].nick);
+                if (!n) { esito = -1; break; }
+                n->punteggio = lotto[k].punteggio;
+                n->finito    = (time_t)lotto[k].finito;
+                n->lsn       = lotto[k].lsn;
+                classificaAccoda(t->tab, &coda, n);
+                if (n->lsn) salvatoSostituisci(t->tab, n);
+                t->nodi[t->num++] = n;
+            }
+            letti += chiedi;
         }
+        pthread_mutex_unlock(&t->tab->lock);
+        righe += t->num;
+    }
+
+    uint32_t sessioni = 0;
+    for (; esito == 0 && sessioni < passaSessioni; sessioni++)
+        esito = passaSessione(tp, numTp, (int)sessioni);
+
+    for (uint32_t i = 0; i < numTp; i++) free(tp[i].nodi);
+    free(tp);
+    if (esito < 0) {
+        fprintf(stderr, "[ERR] riavvio a caldo: stato incompleto dal vecchio processo\n");
+        return -1;
+    }
+
+    // conferma: da qui il vecchio processo rilascia i propri descrittori
+    char ok = 1;
+    if (send(fdPassaggio, &ok, 1, MSG_NOSIGNAL) != 1) return -1;
+    close(fdPassaggio);
+    fdPassaggio = -1;
+    printf("[riavvio] ricevute %u connessioni e %zu righe di classifica\n", sessioni, righe);
+    return 0;
+}
 
-        // quiz terminato: timestamp di fine, riordina per tie-break (parità di punteggio)
-        pthread_mutex_lock(&tabelloni[temaIdx].lock);
-        nodo->finito = time(NULL);                  // istante di fine
-        while (nodo->nxt &&
-               nodo->punteggio == nodo->nxt->punteggio &&
-               nodo->finito && nodo->nxt->finito &&
-               nodo->finito < nodo->nxt->finito) {
+// Riattiva i loop del vecchio processo dopo un passaggio fallito
+static void riavvioAnnulla(void) {
+    uint64_t v;
+    while (read(svegliaLoop, &v, sizeof(v)) > 0) ;
+    atomic_store(&riavvio, 0);
+    if (dirPersistenza) {
+        walChiusura = 0;
+        persistenzaAvvia();
+    }
+    if (modoAnello) anelloRiprendi();
+    for (int i = 0; i < numLoop; i++)
+        pthread_create(&reattori[i].tid, NULL, threadReattore, &reattori[i]);
+    pthread_rwlock_unlock(&rw_passaggio);
+    printf("[riavvio] passaggio non riuscito: il server continua con il processo attuale\n");
+    fflush(stdout);
+    segnalaStato();
+}
 
-            struct NodoPunteggio* prev = nodo->prev;
-            struct NodoPunteggio* next = nodo->nxt;
+static void riavvioCaldo(void) {
+    if (!modoReactor) {
+        printf("[riavvio] il riavvio a caldo richiede la modalità reactor\n");
+        fflush(stdout);
+        return;
+    }
 
-            if (prev) prev->nxt = next;
-            else      tabelloni[temaIdx].head = next;
-            next->prev = prev;
+    // 1) ferma i loop alla fine del lotto di eventi in corso
+    atomic_store(&riavvio, 1);
+    uint64_t uno = 1;
+    if (write(svegliaLoop, &uno, sizeof(uno)) < 0) perror("eventfd");
+    for (int i = 0; i < numLoop; i++) pthread_join(reattori[i].tid, NULL);
 
-            nodo->nxt  = next->nxt;
-            nodo->prev = next;
-            if (next->nxt) next->nxt->prev = nodo;
-            next->nxt = nodo;
-        }
-        pthread_mutex_unlock(&tabelloni[temaIdx].lock);
+    // 1b) diretta, stanze, ricarica di qa/ e statistiche fermi tra due giri
+    pthread_rwlock_wrlock(&rw_passaggio);
 
-        // esco dal tema corrente
-        pthread_mutex_lock(&mtx_players);
-        gioc->temaCorr = NULL;
-        pthread_mutex_unlock(&mtx_players);
+    // 2) risultati già completati su disco: il nuovo processo riapre il log
+    persistenzaChiudi();
 
-        // refresh stato finale dopo il tema
-        pthread_mutex_lock(&mtx_score);
-        flag_stampa = 1; pthread_cond_signal(&cond_score);
-        while (flag_stampa) pthread_cond_wait(&cond_score, &mtx_score);
-        pthread_mutex_unlock(&mtx_score);
+    // 3) nuovo processo con l'altro capo del canale
+    int ch[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, ch) < 0) {
+        perror("socketpair");
+        riavvioAnnulla();
+        return;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        char numero[16];
+        snprintf(numero, sizeof(numero), "%d", ch[1]);
+        char** argvNuovo = (char**)calloc(argcAvvio + 3, sizeof(char*));
+        int n = 0;
+        for (int i = 0; argvNuovo && i < argcAvvio; i++) {
+            if (strcmp(argvAvvio[i], "-H") == 0) { i++; continue; }     // canale del riavvio precedente
+            if (strncmp(argvAvvio[i], "-H", 2) == 0) continue;
+            argvNuovo[n++] = argvAvvio[i];
+        }
+        if (argvNuovo && fcntl(ch[1], F_SETFD, 0) == 0) {
+            argvNuovo[n++] = "-H";
+            argvNuovo[n++] = numero;
+            execvp(argvNuovo[0], argvNuovo);
+        }
+        perror("[riavvio] exec");
+        _exit(127);
+    }
+    close(ch[1]);
+    if (pid < 0) {
+        perror("fork");
+        close(ch[0]);
+        riavvioAnnulla();
+        return;
     }
 
-fine:
-    // Cleanup finale: libero slot online e cancello il nick da tutte le classifiche.
-    pthread_mutex_lock(&mtx_players);
-    gioc->nome[0]  = '\0';
-    gioc->temaCorr = NULL;
-    pthread_mutex_unlock(&mtx_players);
+    // 4) stato al nuovo processo e attesa della conferma
+    struct timeval tv = { .tv_sec = PASSA_ATTESA };
+    setsockopt(ch[0], SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(ch[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char ok = 0;
+    int esito = passaggioInvia(ch[0]);
+    if (esito == 0 && recv(ch[0], &ok, 1, 0) != 1) esito = -1;
+    close(ch[0]);
+    if (esito < 0) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        riavvioAnnulla();
+        return;
+    }
 
-    rimuovi_dalle_classifiche(nick_attuale);
+    // 5) serve il nuovo processo: via le copie dei descrittori, nessuno shutdown
+    for (int i = 0; i < numLoop; i++) close(reattori[i].sd_ascolto);
+    pthread_mutex_lock(&mtx_conns);
+    for (int i = 0; i < numSlot; i++) {
+        if (conn_sd_list[i] >= 0) close(conn_sd_list[i]);
+        conn_sd_list[i] = -1;
+    }
+    pthread_mutex_unlock(&mtx_conns);
 
-    // refresh schermo
-    pthread_mutex_lock(&mtx_score);
-    flag_stampa = 1; pthread_cond_signal(&cond_score);
-    while (flag_stampa) pthread_cond_wait(&cond_score, &mtx_score);
-    pthread_mutex_unlock(&mtx_score);
+    int stato = 0;
+    while (waitpid(pid, &stato, 0) < 0 && errno == EINTR) ;
+    _exit(WIFEXITED(stato) ? WEXITSTATUS(stato) : 1);
 }
 
 // ============================================================================
-// verificaRicezione
+// Statistiche: istogrammi di latenza per fase + contatori
+// ----------------------------------------------------------------------------
+// Sul percorso di gioco: una clock_gettime (vDSO) all'inizio della fase e una
+// alla fine, poi un incremento nella StatThread del thread corrente, creata
+// al primo uso e mai liberata (i thread del server vivono quanto il processo).
+// Il thread del socket accetta una connessione alla volta, legge la richiesta
+// ("json" o niente = testo, 100 ms di attesa al massimo), somma le StatThread
+// e risponde senza fermare nessuno: i valori sono coerenti per singolo campo.
 // ============================================================================
-static int verificaRicezione(int ret, int len) {
-    if (ret == 0)             return 1;         // peer chiuso
-    if (ret < 0 || ret < len) return -1;        // errore/parziale
-    return 0;                                   // OK
+static const char* nomiFasi[NUM_FASI] = {
+    "accetta", "login", "tema", "risposta", "classifica", "invio", "stampa", "coda"
+};
+
+static const char* nomiContatori[NUM_CONTATORI] = {
+    "connessioni", "login_rifiutati", "risposte_giuste", "risposte_errate", "segnalazioni_stato",
+    "oggetti_pool", "slab", "sessioni_scadute", "messe_in_coda", "rifiutate_coda_piena"
+};
+
+static uint64_t statOra(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 }
 
-// ============================================================================
-// inviaClassifica / inviaPunteggiRicorsivo
-// ============================================================================
-static void inviaPunteggiRicorsivo(struct NodoPunteggio* n, int conn_sd, int* cont) {
-    if (!n) {
-        uint16_t net = htons(*cont);
-        send(conn_sd, &net, sizeof(net), MSG_NOSIGNAL);         // invio numero giocatori
-        return;
+// Incremento da parte dell'unico scrittore: nessun lock né RMW atomico
+static inline void statIncrementa(_Atomic uint64_t* c, uint64_t v) {
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+static struct StatThread* statDelThread(void) {
+    if (statLocale) return statLocale;
+    struct StatThread* st = (struct StatThread*)calloc(1, sizeof(*st));
+    if (!st) return NULL;
+    pthread_mutex_lock(&mtx_stat);
+    st->succ = elencoStat;
+    elencoStat = st;
+    pthread_mutex_unlock(&mtx_stat);
+    return statLocale = st;
+}
+
+static size_t istoIndice(uint64_t ns) {
+    if (ns < ISTO_SUB) ns = ISTO_SUB;
+    int ott = 63 - __builtin_clzll(ns);                     // >= log2(ISTO_SUB) = 4
+    if (ott >= ISTO_OTTAVE) return ISTO_OTTAVE * ISTO_SUB - 1;
+    return (size_t)ott * ISTO_SUB + (size_t)((ns >> (ott - 4)) & (ISTO_SUB - 1));
+}
+
+// Limite superiore (ns) del sotto-intervallo idx
+static uint64_t istoValore(size_t idx) {
+    size_t ott = idx / ISTO_SUB, sub = idx % ISTO_SUB;
+    return (uint64_t)(ISTO_SUB + sub + 1) << (ott - 4);
+}
+
+static void statRegistra(enum FaseStat fase, uint64_t inizio) {
+    struct StatThread* st = statDelThread();
+    if (!st) return;
+    uint64_t ns = statOra() - inizio;
+    struct IstoLatenza* h = &st->fasi[fase];
+    statIncrementa(&h->conta[istoIndice(ns)], 1);
+    statIncrementa(&h->totale, 1);
+    statIncrementa(&h->somma, ns);
+    if (ns > atomic_load_explicit(&h->max, memory_order_relaxed))
+        atomic_store_explicit(&h->max, ns, memory_order_relaxed);
+}
+
+static void statConta(enum ContatoreStat c) {
+    struct StatThread* st = statDelThread();
+    if (st) statIncrementa(&st->contatori[c], 1);
+}
+
+// Somma di tutte le StatThread (copia non atomica: basta la coerenza per campo)
+struct StatTotali {
+    uint64_t conta[NUM_FASI][ISTO_OTTAVE * ISTO_SUB];
+    uint64_t totale[NUM_FASI], somma[NUM_FASI], max[NUM_FASI];
+    uint64_t contatori[NUM_CONTATORI];
+};
+
+static void statSomma(struct StatTotali* t) {
+    memset(t, 0, sizeof(*t));
+    pthread_mutex_lock(&mtx_stat);
+    struct StatThread* primo = elencoStat;                  // si aggiungono solo in testa
+    pthread_mutex_unlock(&mtx_stat);
+
+    for (struct StatThread* st = primo; st; st = st->succ) {
+        for (int f = 0; f < NUM_FASI; f++) {
+            const struct IstoLatenza* h = &st->fasi[f];
+            if (!atomic_load_explicit(&h->totale, memory_order_relaxed)) continue;
+            for (size_t i = 0; i < ISTO_OTTAVE * ISTO_SUB; i++)
+                t->conta[f][i] += atomic_load_explicit(&h->conta[i], memory_order_relaxed);
+            t->totale[f] += atomic_load_explicit(&h->totale, memory_order_relaxed);
+            t->somma[f]  += atomic_load_explicit(&h->somma,  memory_order_relaxed);
+            uint64_t m = atomic_load_explicit(&h->max, memory_order_relaxed);
+            if (m > t->max[f]) t->max[f] = m;
+        }
+        for (int c = 0; c < NUM_CONTATORI; c++)
+            t->contatori[c] += atomic_load_explicit(&st->contatori[c], memory_order_relaxed);
     }
-    (*cont)++;
-    inviaPunteggiRicorsivo(n->nxt, conn_sd, cont);              // invio dal peggiore al migliore
-    send(conn_sd, n->nick, MaxReadL, MSG_NOSIGNAL);
-    uint16_t net = htons(n->punteggio);
-    send(conn_sd, &net, sizeof(net), MSG_NOSIGNAL);
 }
 
-static void inviaClassifica(int conn_sd) {
-    for (int i = 0; i < numTemi; i++) {
-        send(conn_sd, tabelloni[i].nomeTema, MaxReadL, MSG_NOSIGNAL);
-        int cont = 0;
-        pthread_mutex_lock(&tabelloni[i].lock);
-        inviaPunteggiRicorsivo(tabelloni[i].head, conn_sd, &cont);
-        pthread_mutex_unlock(&tabelloni[i].lock);
+static uint64_t statPercentile(const struct StatTotali* t, int f, double q) {
+    uint64_t tot = 0;
+    for (size_t i = 0; i < ISTO_OTTAVE * ISTO_SUB; i++) tot += t->conta[f][i];   // coerente con conta[]
+    if (!tot) return 0;
+    uint64_t soglia = (uint64_t)(q * (double)tot);
+    if (soglia >= tot) soglia = tot - 1;
+    uint64_t visti = 0;
+    for (size_t i = 0; i < ISTO_OTTAVE * ISTO_SUB; i++) {
+        visti += t->conta[f][i];
+        if (visti > soglia) {
+            uint64_t v = istoValore(i);
+            return v < t->max[f] ? v : t->max[f];
+        }
     }
+    return t->max[f];
 }
 
-// ============================================================================
-// rimuovi_dalle_classifiche
-// ============================================================================
-static void rimuovi_dalle_classifiche(const char* nick) {
-    if (!nick || !nick[0]) return;
-    for (int t = 0; t < numTemi; ++t) {
-        pthread_mutex_lock(&tabelloni[t].lock);
-        struct NodoPunteggio* n = tabelloni[t].head;
-        while (n) {
-            struct NodoPunteggio* next = n->nxt;
-            if (strcmp(n->nick, nick) == 0) {
-                if (n->prev) n->prev->nxt = n->nxt; else tabelloni[t].head = n->nxt;
-                if (n->nxt)  n->nxt->prev = n->prev;
-                free(n);
+static void statScrivi(FILE* o, int json) {
+    struct StatTotali* t = (struct StatTotali*)malloc(sizeof(*t));
+    if (!t) return;
+    statSomma(t);
+    double uptime = (double)(statOra() - statAvvio) / 1e9;
+    static const double quantili[] = { 0.50, 0.90, 0.99, 0.999 };
+    size_t inAttesa, picco;
+    unsigned int attive;
+    uint64_t durata;
+    ammissioneStato(&inAttesa, &picco, &attive, &durata);
+
+    if (json) {
+        fprintf(o, "{\"uptime_s\":%.3f,\"fasi\":{", uptime);
+        for (int f = 0; f < NUM_FASI; f++) {
+            fprintf(o, "%s\"%s\":{\"conteggio\":%llu,\"media_us\":%.3f", f ? "," : "", nomiFasi[f],
+                    (unsigned long long)t->totale[f],
+                    t->totale[f] ? (double)t->somma[f] / (double)t->totale[f] / 1e3 : 0.0);
+            fprintf(o, ",\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,\"p999_us\":%.3f,\"max_us\":%.3f}",
+                    statPercentile(t, f, quantili[0]) / 1e3, statPercentile(t, f, quantili[1]) / 1e3,
+                    statPercentile(t, f, quantili[2]) / 1e3, statPercentile(t, f, quantili[3]) / 1e3,
+                    t->max[f] / 1e3);
+        }
+        fprintf(o, "},\"contatori\":{");
+        for (int c = 0; c < NUM_CONTATORI; c++)
+            fprintf(o, "%s\"%s\":%llu", c ? "," : "", nomiContatori[c], (unsigned long long)t->contatori[c]);
+        fprintf(o, ",\"risposte_inviate\":%llu,\"syscall_invio\":%llu}",
+                (unsigned long long)atomic_load(&statRisposte), (unsigned long long)atomic_load(&statSyscall));
+        fprintf(o, ",\"ammissione\":{\"sessioni_attive\":%u,\"capienza\":%d,\"in_coda\":%zu,"
+                   "\"coda_max\":%d,\"picco_coda\":%zu,\"durata_media_ms\":%.1f}}\n",
+                attive, numSlot, inAttesa, codaMax, picco, durata / 1e6);
+    } else {
+        fprintf(o, "uptime: %.1f s\n", uptime);
+        fprintf(o, "%-11s %10s %10s %10s %10s %10s %10s %10s\n",
+                "fase (us)", "conteggio", "media", "p50", "p90", "p99", "p999", "max");
+        for (int f = 0; f < NUM_FASI; f++) {
+            fprintf(o, "%-11s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", nomiFasi[f],
+                    (unsigned long long)t->totale[f],
+                    t->totale[f] ? (double)t->somma[f] / (double)t->totale[f] / 1e3 : 0.0,
+                    statPercentile(t, f, quantili[0]) / 1e3, statPercentile(t, f, quantili[1]) / 1e3,
+                    statPercentile(t, f, quantili[2]) / 1e3, statPercentile(t, f, quantili[3]) / 1e3,
+                    t->max[f] / 1e3);
+        }
+        for (int c = 0; c < NUM_CONTATORI; c++)
+            fprintf(o, "%-20s %llu\n", nomiContatori[c], (unsigned long long)t->contatori[c]);
+        fprintf(o, "%-20s %llu\n%-20s %llu\n",
+                "risposte_inviate", (unsigned long long)atomic_load(&statRisposte),
+                "syscall_invio",    (unsigned long long)atomic_load(&statSyscall));
+        fprintf(o, "%-20s %u/%d\n%-20s %zu/%d (picco %zu)\n%-20s %.1f ms\n",
+                "sessioni_attive", attive, numSlot, "in_coda", inAttesa, codaMax, picco,
+                "durata_media", durata / 1e6);
+    }
+    free(t);
+}
+
+static void* threadStatistiche(void* arg) {
+    int sd = (int)(intptr_t)arg;
+    while (!atomic_load(&server_shutdown)) {
+        int c = accept4(sd, NULL, NULL, SOCK_CLOEXEC);
+        if (c < 0) { if (errno == EINTR) continue; break; }
+
+        // un lettore fermo non deve bloccare il servizio agli altri:
+        // oltre STAT_INVIO_MS senza progressi la connessione si chiude
+        struct timeval tv = { .tv_sec = 0, .tv_usec = STAT_INVIO_MS * 1000 };
+        setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        // richiesta facoltativa: "json" (altrimenti testo)
+        char req[16] = "";
+        struct pollfd pfd = { .fd = c, .events = POLLIN };
+        if (poll(&pfd, 1, 100) > 0) {
+            ssize_t n = recv(c, req, sizeof(req) - 1, MSG_DONTWAIT);
+            req[n > 0 ? n : 0] = '\0';
+        }
+
+        char*  testo = NULL;
+        size_t len = 0;
+        FILE*  o = open_memstream(&testo, &len);
+        if (o) {
+            pthread_rwlock_rdlock(&rw_passaggio);
+            statScrivi(o, strncmp(req, "json", 4) == 0);
+            pthread_rwlock_unlock(&rw_passaggio);
+            fclose(o);
+            for (size_t off = 0; off < len; ) {
+                ssize_t w = send(c, testo + off, len - off, MSG_NOSIGNAL);
+                if (w < 0) { if (errno == EINTR) continue; break; }   // EAGAIN: timeout
+                off += (size_t)w;
             }
-            n = next;
+            free(testo);
         }
-        pthread_mutex_unlock(&tabelloni[t].lock);
+        close(c);
+    }
+    close(sd);
+    return NULL;
+}
+
+static int statAvvia(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(percorsoStat) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "[ERR] percorso del socket statistiche troppo lungo\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, percorsoStat);
+
+    int sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sd < 0) { perror("socket statistiche"); return -1; }
+    unlink(percorsoStat);                                   // residuo di un'esecuzione precedente
+    if (bind(sd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(sd, 8) < 0) {
+        perror("socket statistiche"); close(sd); return -1;
     }
+
+    pthread_t t;
+    if (pthread_create(&t, NULL, threadStatistiche, (void*)(intptr_t)sd) != 0) { close(sd); return -1; }
+    pthread_detach(t);
+    return 0;
 }
 
 // ============================================================================
 // I/O file: costruisciIndice / caricaDomande
 // ----------------------------------------------------------------------------
-// Scansione 'qa/' per contare i file .txt, allocare gli array e popolare i nomi.
-// Lettura domande a coppie di righe:
+// Una scansione di 'qa/': i file che terminano in .txt, in ordine di nome
+// (lo stesso indice tema a ogni caricamento e nel pacchetto).
+// Lettura domande a coppie di righe (tutte quelle del file, almeno NumQuest):
 //    riga dispari  -> Domanda (terminante in '?')
-//    riga pari     -> Risposta
+//    riga pari     -> Risposta, con soglia opzionale " ~N" (0..SOGLIA_MAX)
 // CR/LF safe, trim di coda/spazi e tolleranza a linee vuote accidentali.
+// La risposta si salva anche normalizzata: il confronto non la rielabora più.
 // ============================================================================
-static int costruisciIndice(void) {
+static int confrontaTemi(const void* a, const void* b) {
+    return strcmp(((const struct TemaQuiz*)a)->nome, ((const struct TemaQuiz*)b)->nome);
+}
+
+static int costruisciIndice(struct Catalogo* c) {
     DIR* dir = opendir(QA_FOLDER);
     if (!dir) return -1;
     struct dirent* ent;
-
-    // 1) conteggio file .txt
-    while ((ent = readdir(dir))) {
-        if (strstr(ent->d_name, ".txt")) numTemi++;
-    }
-    closedir(dir);
-    if (numTemi <= 0) return -1;
-
-    // 2) allocazioni
-    temiQuiz  = (struct TemaQuiz*)  malloc(numTemi * sizeof(*temiQuiz));
-    tabelloni = (struct Tabellone*) malloc(numTemi * sizeof(*tabelloni));
-    if (!temiQuiz || !tabelloni) return -1;
-
-    // 3) popolamento nomi tema e init tabelloni
-    dir = opendir(QA_FOLDER);
-    int idx = 0;
-    while ((ent = readdir(dir))) {
-        char* pos;
-        if ((pos = strstr(ent->d_name, ".txt"))) {
-            *pos = '\0';                                        // rimuovo estensione
-            strncpy(temiQuiz[idx].nome, ent->d_name, MaxReadL);
-            temiQuiz[idx].nome[MaxReadL-1] = '\0';
-            tabelloni[idx].nomeTema = temiQuiz[idx].nome;       // puntatore condiviso
-            tabelloni[idx].head     = NULL;
-            idx++;
+    int cap = 0;
+    while ((ent = readdir(dir)) && c->numTemi < PROTO_OCCUPATO - 1) {     // il preambolo è un uint16_t
+        size_t len = strlen(ent->d_name);
+        if (len <= 4 || strcmp(ent->d_name + len - 4, ".txt") != 0) continue;
+        if (c->numTemi == cap) {
+            cap = cap ? cap * 2 : 64;
+            struct TemaQuiz* nt = (struct TemaQuiz*)realloc(c->temi, cap * sizeof(*nt));
+            if (!nt) { closedir(dir); return -1; }
+            c->temi = nt;
         }
+        struct TemaQuiz* t = &c->temi[c->numTemi++];
+        memset(t, 0, sizeof(*t));
+        len -= 4;                                               // senza estensione
+        if (len >= MaxReadL) len = MaxReadL - 1;
+        memcpy(t->nome, ent->d_name, len);
     }
     closedir(dir);
-    return 0;
+    if (c->numTemi <= 0) return -1;
+
+    qsort(c->temi, c->numTemi, sizeof(*c->temi), confrontaTemi);
+    c->tabelloni = (struct Tabellone**)calloc(c->numTemi, sizeof(*c->tabelloni));
+    return c->tabelloni ? 0 : -1;
 }
 
 // helper trim (CR, spazi, TAB, LF)
@@ -602,124 +5323,698 @@ static void trim_line(char* s){
     while (L>0 && (s[L-1]=='\r'||s[L-1]==' '||s[L-1]=='\t')) s[--L]='\0';
 }
 
-static int caricaDomande(const char* percorso, struct CoppiaQ* quiz) {
+// Copia una stringa (con '\0') in coda all'arena del tema; ritorna l'offset
+static int64_t arenaAggiungi(struct TemaQuiz* tema, const char* str) {
+    size_t len = strlen(str) + 1;
+    if (tema->arenaLen + len > UINT32_MAX) return -1;       // offset a 32 bit
+    if (tema->arenaLen + len > tema->arenaCap) {
+        size_t cap = tema->arenaCap ? tema->arenaCap : 4096;
+        while (cap < tema->arenaLen + len) cap *= 2;
+        char* nuova = (char*)realloc(tema->arena, cap);
+        if (!nuova) return -1;
+        tema->arena = nuova; tema->arenaCap = cap;
+    }
+    memcpy(tema->arena + tema->arenaLen, str, len);
+    tema->arenaLen += len;
+    return (int64_t)(tema->arenaLen - len);
+}
+
+// Soglia di edit di default: nessuna tolleranza sulle parole brevi,
+// dove un solo carattere cambia spesso la risposta
+static uint8_t sogliaDaLunghezza(size_t len) {
+    if (len <= 4) return 0;
+    if (len <= 8) return 1;
+    return 2;
+}
+
+// Prossima riga non vuota (trim compreso); 0 a fine file
+static int leggiRigaPiena(FILE* f, char** riga, size_t* cap) {
+    do {
+        if (getline(riga, cap, f) < 0) return 0;
+        trim_line(*riga);
+    } while ((*riga)[0] == '\0');
+    return 1;
+}
+
+static int caricaDomande(const char* percorso, struct TemaQuiz* tema) {
     FILE* f = fopen(percorso, "r");
     if (!f) return -1;
 
-    char domanda[MaxReadQuestL + MaxReadL];
-    char risposta[MaxReadL + 32];
+    char*  riga = NULL;
+    size_t cap  = 0;
+    uint32_t capQuiz = 0;
+    int    esito = 0;
 
-    for (int i = 0; i < NumQuest; i++) {
-        // Leggi DOMANDA (salta eventuali righe vuote)
-        do {
-            if (!fgets(domanda, sizeof(domanda), f)) { fclose(f); return -1; }
-            trim_line(domanda);
-        } while (domanda[0] == '\0');
+    tema->quiz = NULL;
+    tema->numDomande = 0;
+    tema->arena = NULL;
+    tema->arenaLen = tema->arenaCap = 0;
 
+    // Leggi DOMANDA (salta eventuali righe vuote)
+    while (leggiRigaPiena(f, &riga, &cap)) {
         // Se manca il '?' finale non è un problema: la domanda viene usata “as is”
         // (ma UI domande lo prevede nei file).
+        int64_t offD = arenaAggiungi(tema, riga);
 
-        // Leggi RISPOSTA (salta eventuali righe vuote)
-        do {
-            if (!fgets(risposta, sizeof(risposta), f)) { fclose(f); return -1; }
-            trim_line(risposta);
-        } while (risposta[0] == '\0');
+        if (offD < 0) { esito = -1; break; }
+
+        // Leggi RISPOSTA (salta eventuali righe vuote); una domanda finale
+        // senza risposta si scarta, come il resto del file la tollera
+        if (!leggiRigaPiena(f, &riga, &cap)) {
+            fprintf(stderr, "[qa] %s: ultima domanda senza risposta, ignorata\n", percorso);
+            tema->arenaLen = (size_t)offD;
+            break;
+        }
+
+        // soglia esplicita " ~N" in coda
+        int soglia = -1;
+        size_t L = strlen(riga);
+        if (L >= 3 && riga[L-3] == ' ' && riga[L-2] == '~' && riga[L-1] >= '0' && riga[L-1] <= '0' + SOGLIA_MAX) {
+            soglia = riga[L-1] - '0';
+            riga[L-3] = '\0';
+            trim_line(riga);
+        }
 
-        // Copie protette nelle strutture
-        strncpy(quiz[i].domanda,  domanda,  MaxReadQuestL);
-        quiz[i].domanda[MaxReadQuestL-1] = '\0';
-        strncpy(quiz[i].risposta, risposta, MaxReadL);
-        quiz[i].risposta[MaxReadL-1] = '\0';
+        int64_t offR = arenaAggiungi(tema, riga);
+        normalizza(riga, riga, strlen(riga) + 1);             // sul posto
+        int64_t offA = (offR < 0) ? -1 : arenaAggiungi(tema, riga);
+        if (offA < 0) { esito = -1; break; }
+        size_t lenA = strlen(riga);
+        if (lenA > UINT16_MAX) { esito = -1; break; }
+        // i client v1 inviano al massimo MaxReadL-1 byte: oltre, la
+        // risposta resta raggiungibile solo dal protocollo v2
+        if (lenA > MaxReadL - 1)
+            fprintf(stderr, "[qa] %s: risposta \"%s\" oltre %d caratteri, irraggiungibile dai client v1\n",
+                    percorso, tema->arena + offR, MaxReadL - 1);
+
+        if (tema->numDomande == capQuiz) {
+            capQuiz = capQuiz ? capQuiz * 2 : 16;
+            struct CoppiaQ* nq = (struct CoppiaQ*)realloc(tema->quiz, capQuiz * sizeof(*nq));
+            if (!nq) { esito = -1; break; }
+            tema->quiz = nq;
+        }
+        struct CoppiaQ* q = &tema->quiz[tema->numDomande];
+        q->domanda   = (uint32_t)offD;
+        q->risposta  = (uint32_t)offR;
+        q->attesa    = (uint32_t)offA;
+        q->lenAttesa = (uint16_t)lenA;
+        q->soglia    = (soglia >= 0) ? (uint8_t)soglia : sogliaDaLunghezza(lenA);
+        tema->numDomande++;
     }
 
+    free(riga);
     fclose(f);
+    if (tema->numDomande < NumQuest) esito = -1;            // banco troppo piccolo
+    return esito;
+}
+
+// ============================================================================
+// Pacchetto domande precompilato: pacchettoScrivi / pacchettoMappa
+// ----------------------------------------------------------------------------
+// "./server -C qa.pack" carica qa/ come sempre (stesso parser, risposte già
+// normalizzate e soglie calcolate) e scrive il catalogo in un solo file,
+// nel formato di IntestPacchetto: prima in <file>.tmp, poi fsync e rename,
+// così un server che lo sta osservando non vede mai un pacchetto a metà.
+// "./server -P qa.pack" lo mappa in sola lettura: i temi puntano nella
+// mappatura, senza parsing né copie delle stringhe, e le pagine stanno
+// nella page cache, condivise tra tutti i processi che servono lo stesso
+// pacchetto (anche vecchio e nuovo durante un riavvio a caldo).
+// All'apertura si verificano intestazione, crc degli offset e confini di
+// ogni tema e domanda (un offset sbagliato diventerebbe una lettura fuori
+// mappatura), senza toccare le pagine delle stringhe: si caricano al primo
+// invio e l'avvio non dipende dalla dimensione dei testi.
+// ============================================================================
+#define MAGIA_PACCHETTO    "QZPACK1"
+#define PACCHETTO_VERSIONE 1
+
+_Static_assert(sizeof(struct IntestPacchetto) % 8 == 0 && sizeof(struct TemaPacchetto) % 8 == 0,
+               "sezioni del pacchetto non allineate");
+
+// Scrive len byte e li aggiunge al crc (se crc != NULL)
+static int pacchettoBlocco(FILE* f, const void* buf, size_t len, uint32_t* crc) {
+    if (len && fwrite(buf, 1, len, f) != len) return -1;
+    if (crc) *crc = crcAggiorna(*crc, buf, len);
     return 0;
 }
 
+// Compila il catalogo c nel pacchetto percorso; 0 o -1 (errno impostato)
+static int pacchettoScrivi(const struct Catalogo* c, const char* percorso) {
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", percorso) >= (int)sizeof(tmp)) { errno = ENAMETOOLONG; return -1; }
+    FILE* f = fopen(tmp, "wb");
+    if (!f) return -1;
+
+    struct IntestPacchetto in;
+    memset(&in, 0, sizeof(in));
+    memcpy(in.magia, MAGIA_PACCHETTO, sizeof(in.magia));
+    in.versione  = PACCHETTO_VERSIONE;
+    in.numTemi   = (uint32_t)c->numTemi;
+    in.dimCoppia = sizeof(struct CoppiaQ);
+    for (int i = 0; i < c->numTemi; i++) {
+        in.numDomande  += c->temi[i].numDomande;
+        in.lenStringhe += c->temi[i].arenaLen;
+    }
+    in.dimensione = sizeof(in) + in.numTemi * sizeof(struct TemaPacchetto)
+                  + in.numDomande * sizeof(struct CoppiaQ) + in.lenStringhe;
+
+    int esito = fwrite(&in, sizeof(in), 1, f) == 1 ? 0 : -1;   // crc definitivo alla fine
+    uint32_t crc = 0;
+    uint64_t prima = 0, arena = 0;
+    for (int i = 0; esito == 0 && i < c->numTemi; i++) {
+        const struct TemaQuiz* t = &c->temi[i];
+        struct TemaPacchetto tp;
+        memset(&tp, 0, sizeof(tp));
+        memcpy(tp.nome, t->nome, MaxReadL);
+        tp.primaDomanda = prima;
+        tp.arena        = arena;
+        tp.numDomande   = t->numDomande;
+        tp.lenArena     = (uint32_t)t->arenaLen;
+        prima += t->numDomande;
+        arena += t->arenaLen;
+        esito = pacchettoBlocco(f, &tp, sizeof(tp), &crc);
+    }
+    for (int i = 0; esito == 0 && i < c->numTemi; i++)
+        esito = pacchettoBlocco(f, c->temi[i].quiz, c->temi[i].numDomande * sizeof(struct CoppiaQ), &crc);
+    for (int i = 0; esito == 0 && i < c->numTemi; i++)
+        esito = pacchettoBlocco(f, c->temi[i].arena, c->temi[i].arenaLen, NULL);
+
+    in.crc = crc;
+    if (esito == 0 && (fseek(f, 0, SEEK_SET) < 0 || fwrite(&in, sizeof(in), 1, f) != 1)) esito = -1;
+    if (esito == 0 && (fflush(f) != 0 || fsync(fileno(f)) < 0)) esito = -1;
+    int errore = errno;
+    if (fclose(f) != 0 && esito == 0) { esito = -1; errore = errno; }
+    if (esito == 0 && rename(tmp, percorso) < 0) { esito = -1; errore = errno; }
+    if (esito < 0) { unlink(tmp); errno = errore; }
+    return esito;
+}
+
+// Catalogo servito dal pacchetto mappato (NULL, con il motivo su stderr)
+static struct Catalogo* pacchettoMappa(const char* percorso, uint64_t generazione) {
+    const char* motivo = NULL;
+    struct Catalogo* c = NULL;
+    void* mappa = MAP_FAILED;
+    size_t dim = 0;
+    struct stat st;
+    int fd = open(percorso, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) < 0) { motivo = strerror(errno); goto errore; }
+    dim = (size_t)st.st_size;
+    if (dim < sizeof(struct IntestPacchetto)) { motivo = "file troppo corto"; goto errore; }
+    mappa = mmap(NULL, dim, PROT_READ, MAP_SHARED, fd, 0);
+    if (mappa == MAP_FAILED) { motivo = strerror(errno); goto errore; }
+    close(fd);
+    fd = -1;
+
+    const struct IntestPacchetto* in = (const struct IntestPacchetto*)mappa;
+    if (memcmp(in->magia, MAGIA_PACCHETTO, sizeof(in->magia)) != 0) { motivo = "non è un pacchetto di domande"; goto errore; }
+    if (in->versione != PACCHETTO_VERSIONE || in->dimCoppia != sizeof(struct CoppiaQ)) {
+        motivo = "versione diversa: va ricostruito con -C"; goto errore;
+    }
+    if (in->numTemi == 0 || in->numTemi >= PROTO_OCCUPATO ||
+        in->numDomande > dim / sizeof(struct CoppiaQ) || in->lenStringhe > dim ||
+        in->dimensione != dim ||
+        dim != sizeof(*in) + in->numTemi * sizeof(struct TemaPacchetto)
+             + in->numDomande * sizeof(struct CoppiaQ) + in->lenStringhe) {
+        motivo = "dimensioni incoerenti (file troncato?)"; goto errore;
+    }
+    if (crcAggiorna(0, (const char*)mappa + sizeof(*in), dim - sizeof(*in) - in->lenStringhe) != in->crc) {
+        motivo = "crc errato"; goto errore;
+    }
+
+    const struct TemaPacchetto* tp = (const struct TemaPacchetto*)(in + 1);
+    const struct CoppiaQ* domande  = (const struct CoppiaQ*)(tp + in->numTemi);
+    const char* stringhe           = (const char*)(domande + in->numDomande);
+
+    if (!(c = (struct Catalogo*)calloc(1, sizeof(*c)))) { motivo = "memoria esaurita"; goto errore; }
+    c->mappa       = mappa;
+    c->lenMappa    = dim;
+    c->generazione = generazione;
+    atomic_init(&c->rif, 1);
+    atomic_init(&c->rifDomande, 1);
+    c->temi      = (struct TemaQuiz*)calloc(in->numTemi, sizeof(*c->temi));
+    c->tabelloni = (struct Tabellone**)calloc(in->numTemi, sizeof(*c->tabelloni));
+    if (!c->temi || !c->tabelloni) { motivo = "memoria esaurita"; goto errore; }
+    c->numTemi   = (int)in->numTemi;
+    for (uint32_t i = 0; i < in->numTemi; i++) {
+        struct TemaQuiz* t = &c->temi[i];
+        if (tp[i].numDomande < NumQuest || tp[i].primaDomanda > in->numDomande ||
+            tp[i].numDomande > in->numDomande - tp[i].primaDomanda ||
+            tp[i].lenArena == 0 || tp[i].arena > in->lenStringhe ||
+            tp[i].lenArena > in->lenStringhe - tp[i].arena || memchr(tp[i].nome, '\0', MaxReadL) == NULL) {
+            motivo = "indice dei temi non valido"; goto errore;
+        }
+        memcpy(t->nome, tp[i].nome, MaxReadL);
+        t->quiz       = (struct CoppiaQ*)(domande + tp[i].primaDomanda);
+        t->numDomande = tp[i].numDomande;
+        t->arena      = (char*)(stringhe + tp[i].arena);
+        t->arenaLen   = tp[i].lenArena;
+        // ogni testo deve terminare dentro l'arena del tema
+        if (t->arena[t->arenaLen - 1] != '\0') { motivo = "stringhe non terminate"; goto errore; }
+        for (uint32_t k = 0; k < t->numDomande; k++) {
+            const struct CoppiaQ* q = &t->quiz[k];
+            if (q->domanda >= t->arenaLen || q->risposta >= t->arenaLen || q->attesa >= t->arenaLen ||
+                q->soglia > SOGLIA_MAX || q->lenAttesa >= t->arenaLen - q->attesa ||
+                t->arena[q->attesa + q->lenAttesa] != '\0') {
+                motivo = "domanda fuori dall'arena del tema"; goto errore;
+            }
+        }
+    }
+    return c;
+
+errore:
+    fprintf(stderr, "[ERR] pacchetto '%s': %s\n", percorso, motivo);
+    if (fd >= 0) close(fd);
+    if (c) catalogoLibera(c);                   // mappatura compresa
+    else if (mappa != MAP_FAILED) munmap(mappa, dim);
+    return NULL;
+}
+
 // ============================================================================
-// Stampa Stato: tre sezioni + prompt shutdown
+// Catalogo: caricamento, pubblicazione e ricarica a caldo
+// ----------------------------------------------------------------------------
+// catalogoCarica costruisce un catalogo completo senza toccare quello in uso;
+// catalogoPubblica lo rende corrente con un solo scambio di puntatore.
+// Le sessioni aperte restano sul catalogo acquisito alla connessione: il
+// vecchio catalogo viene liberato quando l'ultima di esse si chiude.
 // ============================================================================
-static void stampaSezioneTemi(void) {
-    printf("== Test disponibili (%d) ==\n", numTemi);
-    for (int i = 0; i < numTemi; i++) {
-        printf("  %2d) %s\n", i + 1, temiQuiz[i].nome);
+
+// Tabellone persistente del tema (creato alla prima apparizione del nome)
+// Raddoppia i bucket dell'indice per nome quando i tabelloni li superano
+// (con decine di migliaia di temi la scansione dell'elenco a ogni
+// caricamento del catalogo diventerebbe quadratica)
+static void indiceTabelloniCresci(void) {
+    uint32_t n = mascheraTabelloni ? (mascheraTabelloni + 1) * 2 : 64;
+    struct Tabellone** b = (struct Tabellone**)calloc(n, sizeof(*b));
+    if (!b) return;                             // resta l'indice precedente
+    for (struct Tabellone* t = elencoTabelloni; t; t = t->succ) {
+        uint32_t i = hashNick(t->nomeTema) & (n - 1);
+        t->succHash = b[i];
+        b[i] = t;
     }
-    StampaNumPiu();
+    free(indiceTabelloni);
+    indiceTabelloni   = b;
+    mascheraTabelloni = n - 1;
 }
 
-static void stampaSezioneOnline(void) {
-    int online = 0;
-    for (int i = 0; i < MAX_THREAD; i++) if (giocatori[i].nome[0] != '\0') online++;
+static struct Tabellone* tabelloneDelTema(const char* nome) {
+    pthread_mutex_lock(&mtx_tabelloni);
+    if ((uint32_t)numTabelloni >= mascheraTabelloni) indiceTabelloniCresci();
+    uint32_t h = hashNick(nome);
+    struct Tabellone* t = NULL;
+    if (indiceTabelloni) {
+        for (t = indiceTabelloni[h & mascheraTabelloni]; t; t = t->succHash)
+            if (strcmp(t->nomeTema, nome) == 0) break;
+    } else {
+        for (t = elencoTabelloni; t; t = t->succ)
+            if (strcmp(t->nomeTema, nome) == 0) break;
+    }
 
-    printf("== Utenti online (%d) ==\n", online);
-    for (int i = 0; i < MAX_THREAD; i++) {
-        if (giocatori[i].nome[0] == '\0') continue;
+    if (!t && (t = (struct Tabellone*)calloc(1, sizeof(*t)))) {
+        strncpy(t->nomeTema, nome, MaxReadL - 1);
+        t->id = numTabelloni++;
+        classificaInit(t);
+        pthread_mutex_init(&t->lock, NULL);
+        t->succ = elencoTabelloni;
+        elencoTabelloni = t;
+        if (indiceTabelloni) {
+            uint32_t i = h & mascheraTabelloni;
+            t->succHash = indiceTabelloni[i];
+            indiceTabelloni[i] = t;
+        }
+    }
+    pthread_mutex_unlock(&mtx_tabelloni);
+    return t;
+}
 
-        printf("- %s", giocatori[i].nome);
-        if (giocatori[i].temaCorr) printf("  [sta facendo: %s]\n", giocatori[i].temaCorr);
-        else                       printf("\n");
+// Banco e arene dei temi; nomi e tabelloni restano per l'elenco
+static void catalogoLiberaDomande(struct Catalogo* c) {
+    if (c->mappa) munmap(c->mappa, c->lenMappa);   // quiz e arene stanno nel pacchetto
+    else if (c->temi) {
+        for (int i = 0; i < c->numTemi; i++) {
+            free(c->temi[i].quiz);
+            free(c->temi[i].arena);
+        }
+    }
+    c->mappa = NULL;
+    if (c->temi)
+        for (int i = 0; i < c->numTemi; i++) {
+            c->temi[i].quiz  = NULL;
+            c->temi[i].arena = NULL;
+        }
+}
 
-        // Per ogni tema, se trovo un nodo di classifica di questo utente, lo mostro:
-        for (int t = 0; t < numTemi; t++) {
-            pthread_mutex_lock(&tabelloni[t].lock);
-            struct NodoPunteggio* n = tabelloni[t].head;
-            while (n) {
-                if (strcmp(n->nick, giocatori[i].nome) == 0) {
-                    printf("    • %s  -> %u/%d%s\n",
-                           tabelloni[t].nomeTema, n->punteggio, NumQuest,
-                           (n->finito ? "" : " (in corso)"));
-                    break;                      // trovato un record per questo tema
-                }
-                n = n->nxt;
+static void catalogoLibera(struct Catalogo* c) {
+    if (!c) return;
+    catalogoLiberaDomande(c);
+    free(c->temi);
+    free(c->tabelloni);
+    free(c);
+}
+
+// Temi e domande da qa/ (NULL in caso di errore, messaggio su stderr)
+static struct Catalogo* catalogoDaQA(uint64_t generazione) {
+    struct Catalogo* c = (struct Catalogo*)calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->generazione = generazione;
+    atomic_init(&c->rif, 1);                            // riferimento "corrente"
+    atomic_init(&c->rifDomande, 1);
+
+    // --- 1) Costruzione indice temi -----------------------------------
+    if (costruisciIndice(c) < 0) {
+        fprintf(stderr, "[ERR] impossibile costruire indice temi da '%s'\n", QA_FOLDER);
+        catalogoLibera(c);
+        return NULL;
+    }
+
+    // --- 2) Caricamento domande da file -------------------------------
+    char path[MaxReadQuestL + sizeof(QA_FOLDER)];
+    for (int i = 0; i < c->numTemi; i++) {
+
+        // path "qa/<nome>.txt"
+        snprintf(path, sizeof(path), "%s%s.txt", QA_FOLDER, c->temi[i].nome);
+
+        if (caricaDomande(path, &c->temi[i]) < 0) {
+            fprintf(stderr, "[ERR] lettura domande fallita: %s\n", path);
+            catalogoLibera(c);
+            return NULL;
+        }
+
+    }
+    return c;
+}
+
+// Carica qa/ (o il pacchetto del flag -P) in un nuovo catalogo
+// (NULL in caso di errore, messaggio su stderr)
+static struct Catalogo* catalogoCarica(uint64_t generazione) {
+    struct Catalogo* c = percorsoPacchetto ? pacchettoMappa(percorsoPacchetto, generazione)
+                                           : catalogoDaQA(generazione);
+    if (!c) return NULL;
+
+    // --- 3) Tabelloni (conservati tra ricariche) ----------------------
+    for (int i = 0; i < c->numTemi; i++) {
+        c->tabelloni[i] = tabelloneDelTema(c->temi[i].nome);
+        if (!c->tabelloni[i]) { catalogoLibera(c); return NULL; }
+    }
+    return c;
+}
+
+static struct Catalogo* catalogoAcquisisci(void) {
+    pthread_rwlock_rdlock(&rw_catalogo);
+    struct Catalogo* c = catalogoCorr;
+    atomic_fetch_add(&c->rif, 1);
+    pthread_rwlock_unlock(&rw_catalogo);
+    return c;
+}
+
+static void catalogoRilascia(struct Catalogo* c) {
+    if (c && atomic_fetch_sub(&c->rif, 1) == 1) catalogoLibera(c);
+}
+
+// Catalogo corrente per una partita sul tema di tab (anche domande):
+// NULL se il tema non c'è più, altrimenti *idx è il suo indice
+static struct Catalogo* catalogoPerTema(const struct Tabellone* tab, int* idx) {
+    pthread_rwlock_rdlock(&rw_catalogo);
+    struct Catalogo* c = catalogoCorr;
+    *idx = -1;
+    for (int i = 0; i < c->numTemi; i++) if (c->tabelloni[i] == tab) { *idx = i; break; }
+    if (*idx >= 0) {
+        atomic_fetch_add(&c->rif, 1);
+        atomic_fetch_add(&c->rifDomande, 1);
+    }
+    pthread_rwlock_unlock(&rw_catalogo);
+    return (*idx >= 0) ? c : NULL;
+}
+
+// Fine partita: l'ultima su un catalogo sostituito ne libera le domande
+static void catalogoRilasciaDomande(struct Catalogo* c) {
+    if (!c) return;
+    if (atomic_fetch_sub(&c->rifDomande, 1) == 1) catalogoLiberaDomande(c);
+    catalogoRilascia(c);
+}
+
+// Rende corrente c (che porta già il proprio riferimento "corrente")
+static void catalogoPubblica(struct Catalogo* c) {
+    pthread_rwlock_wrlock(&rw_catalogo);
+    struct Catalogo* vecchio = catalogoCorr;
+    catalogoCorr = c;
+    pthread_rwlock_unlock(&rw_catalogo);
+
+    catalogoRilasciaDomande(vecchio);
+    segnalaStato();
+}
+
+// 1 se tra gli eventi letti ce n'è uno sul file 'nome' (NULL = qualsiasi)
+static int eventiRiguardano(const char* eventi, ssize_t n, const char* nome) {
+    if (!nome) return 1;
+    for (ssize_t off = 0; off < n; ) {
+        const struct inotify_event* ev = (const struct inotify_event*)(eventi + off);
+        if (ev->len && strcmp(ev->name, nome) == 0) return 1;
+        off += sizeof(*ev) + ev->len;
+    }
+    return 0;
+}
+
+// Thread di ricarica: attende modifiche in qa/ (o al pacchetto del flag -P)
+// e pubblica un nuovo catalogo. Gli eventi ravvicinati (editor, copie
+// multiple) vengono accorpati.
+static void* osservatoreQA(void* arg) {
+    (void)arg;
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0) { perror("inotify_init1"); return NULL; }
+
+    // il pacchetto si osserva dalla sua cartella: pacchettoScrivi lo
+    // sostituisce con rename(), che un watch sul file stesso perderebbe
+    char cartella[PATH_MAX] = QA_FOLDER;
+    const char* nome = NULL;
+    const char* sorgente = "qa/";
+    uint32_t maschera = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+    if (percorsoPacchetto) {
+        const char* barra = strrchr(percorsoPacchetto, '/');
+        if (barra) snprintf(cartella, sizeof(cartella), "%.*s",
+                            (int)(barra - percorsoPacchetto + 1), percorsoPacchetto);
+        else       snprintf(cartella, sizeof(cartella), ".");
+        nome      = barra ? barra + 1 : percorsoPacchetto;
+        sorgente  = percorsoPacchetto;
+        maschera  = IN_CLOSE_WRITE | IN_MOVED_TO;
+    }
+    if (inotify_add_watch(fd, cartella, maschera) < 0) {
+        perror("inotify_add_watch"); close(fd); return NULL;
+    }
+
+    char eventi[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    uint64_t generazione = 1;
+    while (!atomic_load(&server_shutdown)) {
+        ssize_t n = read(fd, eventi, sizeof(eventi));
+        if (n <= 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (!eventiRiguardano(eventi, n, nome)) continue;
+
+        // accorpa la raffica: aspetta 200 ms di quiete
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        while (poll(&pfd, 1, 200) > 0) {
+            if (read(fd, eventi, sizeof(eventi)) <= 0) break;
+        }
+
+        pthread_rwlock_rdlock(&rw_passaggio);       // nessun tabellone nuovo durante un passaggio
+        struct Catalogo* c = catalogoCarica(generazione + 1);
+        pthread_mutex_lock(&mtx_ricarica);
+        if (c) {
+            generazione++;
+            snprintf(esitoRicarica, sizeof(esitoRicarica),
+                     "catalogo ricaricato da %s (versione %llu, %d temi)", sorgente,
+                     (unsigned long long)generazione, c->numTemi);
+        } else {
+            snprintf(esitoRicarica, sizeof(esitoRicarica),
+                     "ricarica di %s fallita: resta in uso la versione %llu", sorgente,
+                     (unsigned long long)generazione);
+        }
+        pthread_mutex_unlock(&mtx_ricarica);
+
+        if (c) catalogoPubblica(c);
+        else   segnalaStato();
+        pthread_rwlock_unlock(&rw_passaggio);
+    }
+    close(fd);
+    return NULL;
+}
+
+// ============================================================================
+// Stampa Stato: tre sezioni + prompt shutdown
+// ============================================================================
+// Come StampaNumPiu(), ma sullo stream della schermata in composizione
+static void stampaPiu(FILE* o) {
+    for (size_t i = 0; i < NumPiu; i++) fputc('+', o);
+    fputc('\n', o);
+}
+
+static void stampaSezioneTemi(FILE* o, const struct Catalogo* c) {
+    fprintf(o, "== Test disponibili (%d) ==\n", c->numTemi);
+    for (int i = 0; i < c->numTemi; i++) {
+        fprintf(o, "  %2d) %s\n", i + 1, c->temi[i].nome);
+    }
+
+    pthread_mutex_lock(&mtx_ricarica);
+    if (esitoRicarica[0]) fprintf(o, "  (%s)\n", esitoRicarica);
+    pthread_mutex_unlock(&mtx_ricarica);
+    stampaPiu(o);
+}
+
+static void stampaSezioneOnline(FILE* o) {
+    // istantanea degli utenti online dal registro (una striscia alla volta):
+    // per ciascuno nick, tema in corso e riepilogo dei temi giocati.
+    struct VistaOnline { char nome[MaxUsernameL]; char* temaCorr; int primaVoce, numVoci; } *vista = NULL;
+    struct VoceGiocatore* voci = NULL;
+    int online = 0, cap = 0, totVoci = 0, capVoci = 0;
+    for (int k = 0; k < REG_STRISCE; k++) {
+        pthread_mutex_lock(&registro.strisce[k].lock);
+        for (struct Sessione* x = registro.strisce[k].primo; x; x = x->regSucc) {
+            if (online == cap) {
+                cap = cap ? cap * 2 : 64;
+                struct VistaOnline* nv = (struct VistaOnline*)realloc(vista, cap * sizeof(*vista));
+                if (!nv) break;
+                vista = nv;
+            }
+            pthread_mutex_lock(&x->mtxVoci);
+            if (totVoci + x->numVoci > capVoci) {
+                int nc = capVoci ? capVoci : 64;
+                while (nc < totVoci + x->numVoci) nc *= 2;
+                struct VoceGiocatore* nv = (struct VoceGiocatore*)realloc(voci, nc * sizeof(*voci));
+                if (!nv) { pthread_mutex_unlock(&x->mtxVoci); break; }
+                voci = nv; capVoci = nc;
             }
-            pthread_mutex_unlock(&tabelloni[t].lock);
+            memcpy(&voci[totVoci], x->voci, x->numVoci * sizeof(*voci));
+            vista[online].primaVoce = totVoci;
+            vista[online].numVoci   = x->numVoci;
+            totVoci += x->numVoci;
+            pthread_mutex_unlock(&x->mtxVoci);
+
+            memcpy(vista[online].nome, x->nick_attuale, MaxUsernameL);
+            vista[online].temaCorr = atomic_load(&x->gioc->temaCorr);
+            online++;
+        }
+        pthread_mutex_unlock(&registro.strisce[k].lock);
+    }
+
+    fprintf(o, "== Utenti online (%d) ==\n", online);
+    size_t inAttesa, picco;
+    unsigned int attive;
+    uint64_t durata;
+    ammissioneStato(&inAttesa, &picco, &attive, &durata);
+    if (inAttesa) fprintf(o, "(in coda per un posto: %zu, picco %zu)\n", inAttesa, picco);
+    for (int i = 0; i < online; i++) {
+        fprintf(o, "- %s", vista[i].nome);
+        if (vista[i].temaCorr) fprintf(o, "  [sta facendo: %s]\n", vista[i].temaCorr);
+        else                   fprintf(o, "\n");
+
+        // Temi giocati da questo utente, dal riepilogo della sessione
+        for (int v = 0; v < vista[i].numVoci; v++) {
+            struct VoceGiocatore* g = &voci[vista[i].primaVoce + v];
+            if (g->finito)
+                fprintf(o, "    • %s  -> %u/%d  (%u° all'arrivo)\n",
+                        g->tab->nomeTema, g->punteggio, NumQuest, g->rangoArrivo);
+            else
+                fprintf(o, "    • %s  -> %u/%d (in corso)\n",
+                        g->tab->nomeTema, g->punteggio, NumQuest);
         }
     }
-    StampaNumPiu();
+    free(vista);
+    free(voci);
+    stampaPiu(o);
 }
 
-static void stampaSezioneClassifiche(void) {
-    printf("== Classifiche per test ==\n");
-    for (int t = 0; t < numTemi; t++) {
-        printf("[%s]\n", tabelloni[t].nomeTema);
-        pthread_mutex_lock(&tabelloni[t].lock);
+// Copia di un record di classifica per la stampa fuori dal lock
+struct VocePunteggio {
+    unsigned int punteggio;
+    time_t       finito;
+    char         nick[MaxUsernameL];
+};
+
+static void stampaSezioneClassifiche(FILE* o, const struct Catalogo* c) {
+    struct VocePunteggio* voci = NULL;
+    int cap = 0;
+
+    fprintf(o, "== Classifiche per test ==\n");
+    for (int t = 0; t < c->numTemi; t++) {
+        struct Tabellone* tab = c->tabelloni[t];
+
+        // istantanea delle prime DASH_RIGHE posizioni: lock tenuto solo per la copia
+        int num = 0;
+        pthread_mutex_lock(&tab->lock);
+        unsigned int totale = tab->lunghezza;
+        for (struct NodoPunteggio* n = classificaPrimo(tab); n && num < DASH_RIGHE; n = n->liv[0].avanti) {
+            if (num == cap) {
+                cap = cap ? cap * 2 : 64;
+                struct VocePunteggio* nv = (struct VocePunteggio*)realloc(voci, cap * sizeof(*voci));
+                if (!nv) break;
+                voci = nv;
+            }
+            voci[num].punteggio = n->punteggio;
+            voci[num].finito    = n->finito;
+            memcpy(voci[num].nick, n->nick, MaxUsernameL);
+            num++;
+        }
+        pthread_mutex_unlock(&tab->lock);
 
-        struct NodoPunteggio* n = tabelloni[t].head;
-        int pos = 1;
-        while (n) {
-            if (n->finito) {
+        fprintf(o, "[%s]\n", tab->nomeTema);
+        for (int pos = 1; pos <= num; pos++) {
+            struct VocePunteggio* v = &voci[pos - 1];
+            if (v->finito) {
                 // formatta orario locale “Ora:Minuto:Secondo”
                 struct tm tmv;
                 char when[32];
-                localtime_r(&n->finito, &tmv);
+                localtime_r(&v->finito, &tmv);
                 strftime(when, sizeof(when), "%H:%M:%S", &tmv);
-                printf("  %2d) %-16s  %u/%d  (finito: %s)\n",
-                       pos, n->nick, n->punteggio, NumQuest, when);
+                fprintf(o, "  %2d) %-16s  %u/%d  (finito: %s)\n",
+                        pos, v->nick, v->punteggio, NumQuest, when);
             } else {
-                printf("  %2d) %-16s  %u/%d  (in corso)\n",
-                       pos, n->nick, n->punteggio, NumQuest);
+                fprintf(o, "  %2d) %-16s  %u/%d  (in corso)\n",
+                        pos, v->nick, v->punteggio, NumQuest);
             }
-            n = n->nxt; pos++;
         }
-
-        pthread_mutex_unlock(&tabelloni[t].lock);
-        printf("\n");
+        if (totale > (unsigned int)num) fprintf(o, "  ... e altri %u\n", totale - (unsigned int)num);
+        fprintf(o, "\n");
     }
-    StampaNumPiu();
+    free(voci);
+    stampaPiu(o);
 }
 
+// Compone l'intera schermata in memoria e la scrive con un'unica write:
+// niente fork di "clear" (sequenza ANSI equivalente) e nessun lock durante l'I/O.
 static void stampaStato(void) {
-    system("clear");
-    printf("Trivia Quiz – Stato Server\n");
-    StampaNumPiu();
+    uint64_t t0 = statOra();
+    char*  schermo = NULL;
+    size_t len = 0;
+    FILE*  o = open_memstream(&schermo, &len);
+    if (!o) return;
 
-    stampaSezioneTemi();
-    stampaSezioneOnline();
-    stampaSezioneClassifiche();
+    fputs("\x1b[H\x1b[2J\x1b[3J", o);             // come "clear"
+    fprintf(o, "Trivia Quiz – Stato Server\n");
+    unsigned long long risposte = atomic_load_explicit(&statRisposte, memory_order_relaxed);
+    unsigned long long chiamate = atomic_load_explicit(&statSyscall,  memory_order_relaxed);
+    fprintf(o, "Invii: %llu risposte, %llu syscall (%.2f per risposta)\n",
+            risposte, chiamate, risposte ? (double)chiamate / (double)risposte : 0.0);
+    stampaPiu(o);
+
+    struct Catalogo* c = catalogoAcquisisci();
+    stampaSezioneTemi(o, c);
+    stampaSezioneOnline(o);
+    stampaSezioneClassifiche(o, c);
+    catalogoRilascia(c);
 
     // Prompt per spegnimento controllato
-    printf("\nShut down del server: premi 'Q' e INVIO\n");
+    fprintf(o, "\nShut down del server: premi 'Q' e INVIO\n");
+    if (modoReactor) fprintf(o, "Riavvio a caldo (nuovo binario, stesse connessioni): premi 'R' e INVIO\n");
+    fclose(o);
+
     fflush(stdout);
+    for (size_t off = 0; off < len; ) {
+        ssize_t w = write(STDOUT_FILENO, schermo + off, len - off);
+        if (w < 0) { if (errno == EINTR) continue; break; }
+        off += (size_t)w;
+    }
+    free(schermo);
+    statRegistra(STAT_STAMPA, t0);
 }
 
 // ============================================================================
@@ -729,16 +6024,21 @@ static void* consoleWatcher(void* _) {
     (void)_;
     int ch;
     while ((ch = getchar()) != EOF) {
+        if (ch == 'r' || ch == 'R') { riavvioCaldo(); continue; }
         if (ch == 'q' || ch == 'Q') {
             atomic_store(&server_shutdown, 1);
 
             // chiude listening: interrompe gli accept pending
-            shutdown(sd_ascolto, SHUT_RDWR);
-            close(sd_ascolto);
+            if (modoReactor) {
+                for (int i = 0; i < numLoop; i++) close(reattori[i].sd_ascolto);
+            } else {
+                shutdown(sd_ascolto, SHUT_RDWR);
+                close(sd_ascolto);
+            }
 
             // chiude "gentilmente" tutte le connessioni attive
             pthread_mutex_lock(&mtx_conns);
-            for (int i = 0; i < MAX_THREAD; i++) {
+            for (int i = 0; i < numSlot; i++) {
                 if (conn_sd_list[i] >= 0) {
                     shutdown(conn_sd_list[i], SHUT_RDWR);
                     close(conn_sd_list[i]);
@@ -750,6 +6050,10 @@ static void* consoleWatcher(void* _) {
             printf("\n[Server] Shutdown richiesto. Sto terminando...\n\n");
             fflush(stdout);
 
+            // ultimi risultati su disco prima di uscire
+            persistenzaChiudi();
+            if (percorsoStat) unlink(percorsoStat);
+
             // Piccola attesa per permettere ai client di ricevere EOF
             usleep(200 * 1000);                              // 200 ms
             _exit(0);
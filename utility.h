@@ -29,6 +29,8 @@
 // Messaggi
 #define EndQuiz "Fine Quiz"
 #define ShowScore "Mostra Punteggio"
+#define LiveScore "Classifica Live"
+#define RoomPlay "Stanza"
 
 // Indirizzo
 #define IPADDR "127.0.0.1"